@@ -0,0 +1,86 @@
+// lib/cobs_frame/cobs_frame.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "crc32.h"
+
+// Framing for binary records on a byte stream (serial): the record plus its
+// CRC-32 (little-endian) is COBS-encoded, which removes every zero byte,
+// and a single 0x00 ends the frame. A reader that joins mid-stream or loses
+// bytes resynchronizes at the next zero.
+#define COBS_FRAME_DELIM 0x00
+// Encoded size of a record of n bytes, delimiter included.
+#define COBS_FRAME_MAX(n) ((n) + 4 + ((n) + 4) / 254 + 2)
+
+class CobsEncoder {
+ public:
+  explicit CobsEncoder(uint8_t *out) : out_(out), codePos_(0), pos_(1), code_(1) {}
+
+  void put(uint8_t b) {
+    if (b == 0) {
+      close();
+      return;
+    }
+    out_[pos_++] = b;
+    if (++code_ == 0xFF) close();
+  }
+
+  void put(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) put(data[i]);
+  }
+
+  // Closes the last block and returns the encoded length.
+  size_t finish() {
+    out_[codePos_] = code_;
+    return pos_;
+  }
+
+ private:
+  void close() {
+    out_[codePos_] = code_;
+    codePos_ = pos_++;
+    code_ = 1;
+  }
+
+  uint8_t *out_;
+  size_t codePos_;
+  size_t pos_;
+  uint8_t code_;
+};
+
+// Returns the frame length, or 0 if COBS_FRAME_MAX(len) exceeds cap.
+static inline size_t cobsFrameEncode(const uint8_t *rec, size_t len, uint8_t *out, size_t cap) {
+  if (COBS_FRAME_MAX(len) > cap) return 0;
+  uint32_t crc = crc32(rec, len);
+  uint8_t tail[4] = {(uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24)};
+  CobsEncoder enc(out);
+  enc.put(rec, len);
+  enc.put(tail, sizeof(tail));
+  size_t n = enc.finish();
+  out[n++] = COBS_FRAME_DELIM;
+  return n;
+}
+
+enum CobsFrameResult : uint8_t { COBS_FRAME_OK, COBS_FRAME_BAD_ENCODING, COBS_FRAME_TOO_LONG, COBS_FRAME_BAD_CRC };
+
+// Decodes one frame without its delimiter into out; on COBS_FRAME_OK the
+// record (CRC stripped) is out[0..recLen).
+static inline CobsFrameResult cobsFrameDecode(const uint8_t *in, size_t len, uint8_t *out, size_t cap,
+                                              size_t &recLen) {
+  size_t i = 0, o = 0;
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len) return COBS_FRAME_BAD_ENCODING;
+    if (o + code > cap) return COBS_FRAME_TOO_LONG;
+    for (uint8_t k = 1; k < code; k++) {
+      if (in[i] == 0) return COBS_FRAME_BAD_ENCODING;
+      out[o++] = in[i++];
+    }
+    if (code < 0xFF && i < len) out[o++] = 0;
+  }
+  if (o < 4) return COBS_FRAME_BAD_ENCODING;
+  recLen = o - 4;
+  uint32_t crc = (uint32_t)out[recLen] | (uint32_t)out[recLen + 1] << 8 | (uint32_t)out[recLen + 2] << 16 |
+                 (uint32_t)out[recLen + 3] << 24;
+  return crc32(out, recLen) == crc ? COBS_FRAME_OK : COBS_FRAME_BAD_CRC;
+}
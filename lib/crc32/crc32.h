@@ -0,0 +1,22 @@
+// lib/crc32/crc32.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, as zlib): reflected polynomial 0xEDB88320, initial
+// value and final xor 0xFFFFFFFF. Nibble table: 64 bytes of flash, two
+// lookups per byte. Pass the previous result as crc to continue a running
+// checksum over several buffers.
+static inline uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0) {
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
@@ -0,0 +1,230 @@
+// lib/fingerprint/fingerprint.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// 64-bit frame fingerprints. Each hash family is a policy with a static
+// hash(data, len); Fingerprint<Hash> applies one to the part of a MeshCore
+// frame selected by FpRange, so both are fixed at compile time:
+//
+//   typedef Fingerprint<XxHash64> Fp;
+//   uint64_t fp = Fp::of(frame, len, FP_NO_PATH);
+
+static inline uint64_t fpRead64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);  // little-endian hosts and the ESP32
+  return v;
+}
+
+static inline uint32_t fpRead32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline uint64_t fpRotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// One byte per step; the sniffer's original fingerprint.
+struct Fnv1a64 {
+  static const char *name() { return "fnv1a"; }
+  static uint64_t hash(const uint8_t *data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+      h ^= data[i];
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+};
+
+// XXH64, seed 0.
+struct XxHash64 {
+  static const char *name() { return "xxh64"; }
+  static uint64_t hash(const uint8_t *p, size_t len) {
+    const uint64_t P1 = 0x9E3779B185EBCA87ULL, P2 = 0xC2B2AE3D27D4EB4FULL, P3 = 0x165667B19E3779F9ULL,
+                   P4 = 0x85EBCA77C2B2AE63ULL, P5 = 0x27D4EB2F165667C5ULL;
+    const uint8_t *end = p + len;
+    uint64_t h;
+    if (len >= 32) {
+      uint64_t v1 = P1 + P2, v2 = P2, v3 = 0, v4 = 0 - P1;
+      do {
+        v1 = fpRotl(v1 + fpRead64(p) * P2, 31) * P1;
+        v2 = fpRotl(v2 + fpRead64(p + 8) * P2, 31) * P1;
+        v3 = fpRotl(v3 + fpRead64(p + 16) * P2, 31) * P1;
+        v4 = fpRotl(v4 + fpRead64(p + 24) * P2, 31) * P1;
+        p += 32;
+      } while (p + 32 <= end);
+      h = fpRotl(v1, 1) + fpRotl(v2, 7) + fpRotl(v3, 12) + fpRotl(v4, 18);
+      const uint64_t v[4] = {v1, v2, v3, v4};
+      for (int i = 0; i < 4; i++) h = (h ^ (fpRotl(v[i] * P2, 31) * P1)) * P1 + P4;
+    } else {
+      h = P5;
+    }
+    h += len;
+    for (; p + 8 <= end; p += 8) h = fpRotl(h ^ (fpRotl(fpRead64(p) * P2, 31) * P1), 27) * P1 + P4;
+    if (p + 4 <= end) {
+      h = fpRotl(h ^ (fpRead32(p) * P1), 23) * P2 + P3;
+      p += 4;
+    }
+    for (; p < end; p++) h = fpRotl(h ^ (*p * P5), 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+  }
+};
+
+// wyhash (final4 construction), seed 0, default secret. The 64x64->128
+// multiply is done in 32-bit halves: the ESP32 has no 128-bit type.
+struct WyHash {
+  static const char *name() { return "wyhash"; }
+
+  static void mum(uint64_t &a, uint64_t &b) {
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    a = lo;
+    b = hi;
+  }
+
+  static uint64_t mix(uint64_t a, uint64_t b) {
+    mum(a, b);
+    return a ^ b;
+  }
+
+  static uint64_t hash(const uint8_t *p, size_t len) {
+    static const uint64_t s[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL,
+                                  0x4d5a2da51de1aa47ULL};
+    uint64_t seed = mix(s[0], s[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+      if (len >= 4) {
+        a = ((uint64_t)fpRead32(p) << 32) | fpRead32(p + ((len >> 3) << 2));
+        b = ((uint64_t)fpRead32(p + len - 4) << 32) | fpRead32(p + len - 4 - ((len >> 3) << 2));
+      } else if (len > 0) {
+        a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+        b = 0;
+      } else {
+        a = b = 0;
+      }
+    } else {
+      size_t i = len;
+      if (i > 48) {
+        uint64_t see1 = seed, see2 = seed;
+        do {
+          seed = mix(fpRead64(p) ^ s[1], fpRead64(p + 8) ^ seed);
+          see1 = mix(fpRead64(p + 16) ^ s[2], fpRead64(p + 24) ^ see1);
+          see2 = mix(fpRead64(p + 32) ^ s[3], fpRead64(p + 40) ^ see2);
+          p += 48;
+          i -= 48;
+        } while (i > 48);
+        seed ^= see1 ^ see2;
+      }
+      while (i > 16) {
+        seed = mix(fpRead64(p) ^ s[1], fpRead64(p + 8) ^ seed);
+        i -= 16;
+        p += 16;
+      }
+      a = fpRead64(p + i - 16);
+      b = fpRead64(p + i - 8);
+    }
+    a ^= s[1];
+    b ^= seed;
+    mum(a, b);
+    return mix(a ^ s[0] ^ len, b ^ s[1]);
+  }
+};
+
+// SipHash-2-4 under a fixed key: keyed, so collisions cannot be crafted by
+// someone who does not know it. Change FP_SIPHASH_K0/K1 per deployment.
+#ifndef FP_SIPHASH_K0
+#define FP_SIPHASH_K0 0x0706050403020100ULL
+#endif
+#ifndef FP_SIPHASH_K1
+#define FP_SIPHASH_K1 0x0F0E0D0C0B0A0908ULL
+#endif
+struct SipHash24 {
+  static const char *name() { return "siphash"; }
+
+  static void round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+    v0 += v1; v1 = fpRotl(v1, 13); v1 ^= v0; v0 = fpRotl(v0, 32);
+    v2 += v3; v3 = fpRotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = fpRotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = fpRotl(v1, 17); v1 ^= v2; v2 = fpRotl(v2, 32);
+  }
+
+  static uint64_t hash(const uint8_t *p, size_t len) {
+    uint64_t v0 = 0x736f6d6570736575ULL ^ FP_SIPHASH_K0, v1 = 0x646f72616e646f6dULL ^ FP_SIPHASH_K1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ FP_SIPHASH_K0, v3 = 0x7465646279746573ULL ^ FP_SIPHASH_K1;
+    const uint8_t *end = p + (len & ~(size_t)7);
+    for (; p < end; p += 8) {
+      uint64_t m = fpRead64(p);
+      v3 ^= m;
+      round(v0, v1, v2, v3);
+      round(v0, v1, v2, v3);
+      v0 ^= m;
+    }
+    uint64_t b = (uint64_t)len << 56;
+    for (size_t i = 0; i < (len & 7); i++) b |= (uint64_t)p[i] << (8 * i);
+    v3 ^= b;
+    round(v0, v1, v2, v3);
+    round(v0, v1, v2, v3);
+    v0 ^= b;
+    v2 ^= 0xFF;
+    for (int i = 0; i < 4; i++) round(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+};
+
+// What part of the frame is fingerprinted.
+//   FP_PREFIX20  first 20 bytes, the original behaviour
+//   FP_FULL      the whole frame
+//   FP_NO_PATH   the whole frame minus path_len and the path, which
+//                repeaters rewrite, so every hop of one packet matches
+enum FpRange : uint8_t { FP_PREFIX20, FP_FULL, FP_NO_PATH, FP_RANGE_COUNT };
+static const char *const FP_RANGE_NAMES[FP_RANGE_COUNT] = {"prefix20", "full", "nopath"};
+
+// Copies the MeshCore frame without its path into out (at least len
+// bytes): header, transport codes for the transport route types, payload.
+// A frame too short to parse is copied whole.
+static inline size_t fpStripPath(const uint8_t *frame, size_t len, uint8_t *out) {
+  if (len < 2) {
+    memcpy(out, frame, len);
+    return len;
+  }
+  uint8_t route = frame[0] & 0x03;
+  size_t pathAt = (route == 0x00 || route == 0x03) ? 5 : 1;
+  if (pathAt >= len || pathAt + 1 + frame[pathAt] > len) {
+    memcpy(out, frame, len);
+    return len;
+  }
+  size_t payloadAt = pathAt + 1 + frame[pathAt];
+  memcpy(out, frame, pathAt);
+  memcpy(out + pathAt, frame + payloadAt, len - payloadAt);
+  return pathAt + len - payloadAt;
+}
+
+template <class Hash>
+struct Fingerprint {
+  static uint64_t of(const uint8_t *frame, size_t len, FpRange range) {
+    switch (range) {
+      case FP_PREFIX20:
+        return Hash::hash(frame, len < 20 ? len : 20);
+      case FP_NO_PATH: {
+        uint8_t covered[256];
+        if (len > sizeof(covered)) len = sizeof(covered);
+        return Hash::hash(covered, fpStripPath(frame, len, covered));
+      }
+      default:
+        return Hash::hash(frame, len);
+    }
+  }
+};
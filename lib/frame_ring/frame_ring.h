@@ -0,0 +1,95 @@
+// lib/frame_ring/frame_ring.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Slots and indices are padded to this so the radio and uplink cores never
+// share a cache line they both write.
+#ifndef FRAME_RING_ALIGN
+#define FRAME_RING_ALIGN 64
+#endif
+
+// One received frame as captured by the RX task.
+struct alignas(FRAME_RING_ALIGN) RxFrame {
+  uint8_t data[255];
+  int16_t len;
+  int16_t reportedLen;
+  int16_t state;         // RadioLib status code from readData()
+  float rssi;
+  float snr;
+  int64_t captureUs;     // esp_timer time latched in the DIO1 ISR
+  uint8_t hash[32];      // SHA-256 of data[0..len), filled on the radio core
+};
+
+// Fixed-capacity, lock-free single-producer/single-consumer ring of
+// preallocated frame slots. The producer fills a slot in place:
+//
+//   RxFrame *slot = ring.acquire();   // nullptr when full
+//   ... readData(slot->data, ...) ...
+//   ring.commit();
+//
+// and the consumer reads it in place:
+//
+//   const RxFrame *f = ring.peek();   // nullptr when empty
+//   ... process(*f) ...
+//   ring.release();
+//
+// Exactly one thread may call acquire/commit and exactly one other thread
+// may call peek/release. N must be a power of two.
+template <size_t N>
+class FrameRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "FrameRing size must be a power of two");
+
+ public:
+  static constexpr size_t capacity() { return N; }
+
+  // Producer: the next free slot, or nullptr (and one overflow counted)
+  // when the consumer has fallen a full ring behind.
+  RxFrame *acquire() {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= N) {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &slots_[head & (N - 1)];
+  }
+
+  // Producer: publish the slot returned by the last acquire().
+  void commit() {
+    uint32_t head = head_.load(std::memory_order_relaxed) + 1;
+    head_.store(head, std::memory_order_release);
+    uint32_t depth = head - tail_.load(std::memory_order_relaxed);
+    if (depth > highWater_.load(std::memory_order_relaxed)) {
+      highWater_.store(depth, std::memory_order_relaxed);
+    }
+  }
+
+  // Consumer: the oldest committed slot, or nullptr when empty.
+  const RxFrame *peek() const {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) return nullptr;
+    return &slots_[tail & (N - 1)];
+  }
+
+  // Consumer: hand the slot returned by peek() back to the producer.
+  void release() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+  uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+  uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+ private:
+  RxFrame slots_[N];
+  // Producer-owned.
+  alignas(FRAME_RING_ALIGN) std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> highWater_{0};
+  std::atomic<uint32_t> overflows_{0};
+  // Consumer-owned.
+  alignas(FRAME_RING_ALIGN) std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,34 @@
+// lib/hex_codec/hex_codec.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Upper-case hex digits of every byte value, two characters per entry, so
+// encoding is one table load and a two-byte copy per input byte.
+static const char HEX_PAIRS[513] =
+    "000102030405060708090A0B0C0D0E0F"
+    "101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F"
+    "303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F"
+    "505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F"
+    "707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F"
+    "909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Writes 2 * len characters (no terminator) and returns the end of them.
+static inline char *hexEncode(const uint8_t *data, size_t len, char *out) {
+  for (size_t i = 0; i < len; i++) {
+    memcpy(out, &HEX_PAIRS[data[i] * 2], 2);
+    out += 2;
+  }
+  return out;
+}
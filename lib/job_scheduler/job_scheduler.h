@@ -0,0 +1,98 @@
+// lib/job_scheduler/job_scheduler.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// What JobScheduler measures for a job; begin() zeroes it. Kept apart
+// from Job, and without default member initializers, so a Job table stays
+// an aggregate under C++11 (arduino-esp32 2.x builds with -std=gnu++11).
+struct JobStats {
+  int64_t readyUs;     // when the next run becomes due
+  uint32_t runs;
+  uint32_t misses;     // finished more than one period after readyUs
+  uint32_t overruns;   // ran longer than sliceUs
+  uint32_t maxRunUs;
+};
+
+// One periodic housekeeping job. `run` gets the time its slice ends and
+// should return by then; jobs that can split their work (e.g. draining a
+// serial buffer) check it, jobs that cannot are simply measured against it.
+struct Job {
+  const char *name;
+  uint32_t periodUs;
+  uint32_t sliceUs;
+  void (*run)(int64_t sliceEndUs);
+  bool (*urgent)();        // optional: run before the period elapses when true
+
+  JobStats stats;          // filled in by JobScheduler
+};
+
+// Cooperative earliest-deadline-first scheduler for low-priority work.
+// It is meant to run in a task below the radio tasks, so the receive path
+// always preempts it; what it adds is that no job starts before its
+// period, none runs twice while another is overdue, and every late finish
+// or blown slice is counted.
+class JobScheduler {
+ public:
+  JobScheduler(Job *jobs, size_t count, int64_t (*nowUs)()) : jobs_(jobs), count_(count), nowUs_(nowUs) {}
+
+  void begin() {
+    int64_t now = nowUs_();
+    for (size_t i = 0; i < count_; i++) {
+      JobStats &st = jobs_[i].stats;
+      st.readyUs = now;
+      st.runs = st.misses = st.overruns = st.maxRunUs = 0;
+    }
+  }
+
+  // Runs every job that is due, earliest deadline first, and returns the
+  // microseconds until the next one is.
+  int64_t runDue() {
+    for (;;) {
+      int64_t now = nowUs_();
+      Job *next = nullptr;
+      for (size_t i = 0; i < count_; i++) {
+        Job &j = jobs_[i];
+        bool due = now >= j.stats.readyUs || (j.urgent && j.urgent());
+        if (due && (!next || deadline(j) < deadline(*next))) next = &j;
+      }
+      if (!next) break;
+      runOne(*next, now);
+    }
+    int64_t now = nowUs_();
+    int64_t wait = INT64_MAX;
+    for (size_t i = 0; i < count_; i++) {
+      int64_t left = jobs_[i].stats.readyUs - now;
+      if (left < wait) wait = left;
+    }
+    return wait > 0 ? wait : 0;
+  }
+
+  size_t size() const { return count_; }
+  const Job &job(size_t i) const { return jobs_[i]; }
+
+ private:
+  // Each run is due at readyUs and must finish within one period of it.
+  static int64_t deadline(const Job &j) { return j.stats.readyUs + j.periodUs; }
+
+  void runOne(Job &j, int64_t startUs) {
+    JobStats &st = j.stats;
+    bool early = startUs < st.readyUs;
+    int64_t due = deadline(j);
+    j.run(startUs + j.sliceUs);
+    int64_t endUs = nowUs_();
+    uint32_t took = (uint32_t)(endUs - startUs);
+    st.runs++;
+    if (took > st.maxRunUs) st.maxRunUs = took;
+    if (took > j.sliceUs) st.overruns++;
+    if (!early && endUs > due) st.misses++;
+    // Stay on the period grid, but do not replay periods that were missed
+    // outright; an urgent run restarts the period.
+    st.readyUs = early ? startUs + j.periodUs : st.readyUs + j.periodUs;
+    if (st.readyUs <= startUs) st.readyUs = startUs + j.periodUs;
+  }
+
+  Job *jobs_;
+  size_t count_;
+  int64_t (*nowUs_)();
+};
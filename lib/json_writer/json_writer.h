@@ -0,0 +1,126 @@
+// lib/json_writer/json_writer.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "hex_codec.h"
+
+// Appends JSON text into a caller-owned fixed buffer: no heap, no String
+// temporaries. Keys and punctuation are passed as string literals so their
+// length is known at compile time:
+//
+//   JsonWriter w(buf, sizeof(buf));
+//   w.raw("{\"ts\":").u64(ts).raw(",\"rssi\":").fixed(rssi, 1).raw("}");
+//
+// Values are written verbatim (no escaping), matching the String-built
+// records this replaces. Once the buffer would overflow every further call
+// is ignored and ok() turns false; the contents are then incomplete.
+class JsonWriter {
+ public:
+  JsonWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) { reset(); }
+
+  void reset() {
+    len_ = 0;
+    ok_ = cap_ > 0;
+    if (ok_) buf_[0] = '\0';
+  }
+
+  template <size_t N>
+  JsonWriter &raw(const char (&lit)[N]) {
+    return append(lit, N - 1);
+  }
+
+  JsonWriter &text(const char *s, size_t n) { return append(s, n); }
+  JsonWriter &text(const char *s) { return append(s, strlen(s)); }
+
+  JsonWriter &u64(uint64_t v) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+      tmp[sizeof(tmp) - 1 - n++] = (char)('0' + v % 10);
+      v /= 10;
+    } while (v);
+    return append(tmp + sizeof(tmp) - n, n);
+  }
+
+  JsonWriter &i64(int64_t v) {
+    if (v < 0) {
+      append("-", 1);
+      return u64(0 - (uint64_t)v);
+    }
+    return u64((uint64_t)v);
+  }
+
+  JsonWriter &boolean(bool v) { return v ? raw("true") : raw("false"); }
+
+  // Same digits as Arduino's String(value, prec) / dtostrf(), including
+  // its rounding and its "-0.0" for small negatives, so records stay
+  // byte-identical to the String-built ones.
+  JsonWriter &fixed(double v, unsigned prec) {
+    if (v != v) return raw("nan");
+    if (v > 1.7976931348623157e308 || v < -1.7976931348623157e308) return raw("inf");
+    if (v < 0.0) {
+      append("-", 1);
+      v = -v;
+    }
+    double rounding = 2.0;
+    for (unsigned i = 0; i < prec; i++) rounding *= 10.0;
+    v += 1.0 / rounding;
+
+    double tenpow = 1.0;
+    int digits = 1;
+    while (v >= 10.0 * tenpow) {
+      tenpow *= 10.0;
+      digits++;
+    }
+    v /= tenpow;
+
+    char tmp[64];
+    size_t n = 0;
+    digits += prec;
+    while (digits-- > 0 && n < sizeof(tmp) - 1) {
+      int digit = (int)v;
+      if (digit > 9) digit = 9;
+      tmp[n++] = (char)('0' + digit);
+      if (digits == (int)prec && prec > 0) tmp[n++] = '.';
+      v -= digit;
+      v *= 10.0;
+    }
+    return append(tmp, n);
+  }
+
+  // Upper-case hex, two characters per byte.
+  JsonWriter &hex(const uint8_t *data, size_t len) {
+    if (!reserve(len * 2)) return *this;
+    hexEncode(data, len, buf_ + len_);
+    len_ += len * 2;
+    buf_[len_] = '\0';
+    return *this;
+  }
+
+  bool ok() const { return ok_; }
+  size_t size() const { return len_; }
+  const char *c_str() const { return buf_; }
+
+ private:
+  bool reserve(size_t n) {
+    if (!ok_ || len_ + n >= cap_) {
+      ok_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  JsonWriter &append(const char *s, size_t n) {
+    if (!reserve(n)) return *this;
+    memcpy(buf_ + len_, s, n);
+    len_ += n;
+    buf_[len_] = '\0';
+    return *this;
+  }
+
+  char *buf_;
+  size_t cap_;
+  size_t len_;
+  bool ok_;
+};
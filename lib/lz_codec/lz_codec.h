@@ -0,0 +1,169 @@
+// lib/lz_codec/lz_codec.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Small LZ77 codec with a preset dictionary, for uplink batches.
+//
+// A compressed message is:
+//   dictId   1 byte   which preset dictionary the stream refers into
+//   rawLen   varint   decompressed size
+//   stream   LZ4-style sequences
+//
+// A sequence is a token (high nibble literal count, low nibble match
+// length - 4; 15 means "more length bytes follow", each adding up to 255),
+// the literals, then a 2-byte little-endian match offset. The last
+// sequence stops after its literals. Offsets may reach back past the start
+// of the message into the dictionary, which is what makes short messages
+// compress: record keys and common frame layouts are already "seen".
+//
+// All state lives in the object (no heap); MaxInput bounds both the input
+// to compress and the output of decompress.
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 10
+#define LZ_HEADER_MAX 4
+// Worst-case compressed size of n bytes, header included.
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16 + LZ_HEADER_MAX)
+
+template <size_t MaxInput>
+class LzCodec {
+ public:
+  LzCodec(const uint8_t *dict, size_t dictLen, uint8_t dictId)
+      : dict_(dict), dictLen_(dictLen < kDictMax ? dictLen : kDictMax), dictId_(dictId) {}
+
+  uint8_t dictId() const { return dictId_; }
+
+  // Returns the compressed size, or 0 if len exceeds MaxInput or the
+  // result would not fit in cap.
+  size_t compress(const uint8_t *in, size_t len, uint8_t *out, size_t cap) {
+    if (len > MaxInput || cap < LZ_HEADER_MAX + 1) return 0;
+    memcpy(work_, dict_, dictLen_);
+    memcpy(work_ + dictLen_, in, len);
+    for (size_t i = 0; i < (size_t)1 << LZ_HASH_BITS; i++) table_[i] = kEmpty;
+    for (size_t i = 0; i + LZ_MIN_MATCH <= dictLen_; i++) table_[hash(work_ + i)] = (uint16_t)i;
+
+    uint8_t *op = out, *oend = out + cap;
+    *op++ = dictId_;
+    op = putVarint(op, (uint32_t)len);
+
+    size_t end = dictLen_ + len;
+    size_t anchor = dictLen_, ip = dictLen_;
+    while (ip + LZ_MIN_MATCH <= end) {
+      uint32_t h = hash(work_ + ip);
+      size_t ref = table_[h];
+      table_[h] = (uint16_t)ip;
+      if (ref == kEmpty || ip - ref > 0xFFFF || memcmp(work_ + ref, work_ + ip, LZ_MIN_MATCH) != 0) {
+        ip++;
+        continue;
+      }
+      size_t matchLen = LZ_MIN_MATCH;
+      while (ip + matchLen < end && work_[ref + matchLen] == work_[ip + matchLen]) matchLen++;
+      op = putSequence(op, oend, work_ + anchor, ip - anchor, matchLen, ip - ref);
+      if (!op) return 0;
+      for (size_t i = ip + 1; i < ip + matchLen && i + LZ_MIN_MATCH <= end; i++) {
+        table_[hash(work_ + i)] = (uint16_t)i;
+      }
+      ip += matchLen;
+      anchor = ip;
+    }
+    op = putSequence(op, oend, work_ + anchor, end - anchor, 0, 0);
+    return op ? (size_t)(op - out) : 0;
+  }
+
+  // Returns the decompressed bytes (valid until the next call) and sets
+  // outLen, or nullptr if the message is corrupt, larger than MaxInput or
+  // made with another dictionary.
+  const uint8_t *decompress(const uint8_t *in, size_t len, size_t &outLen) {
+    const uint8_t *ip = in, *iend = in + len;
+    if (len < 2 || *ip++ != dictId_) return nullptr;
+    uint32_t rawLen = 0;
+    for (int shift = 0;; shift += 7) {
+      if (ip >= iend || shift > 28) return nullptr;
+      uint8_t b = *ip++;
+      rawLen |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) break;
+    }
+    if (rawLen > MaxInput) return nullptr;
+    memcpy(work_, dict_, dictLen_);
+    size_t op = dictLen_, oend = dictLen_ + rawLen;
+    for (;;) {
+      if (ip >= iend) return nullptr;
+      uint8_t token = *ip++;
+      size_t lit = token >> 4;
+      if (lit == 15 && !getLength(ip, iend, lit)) return nullptr;
+      if (lit > (size_t)(iend - ip) || op + lit > oend) return nullptr;
+      memcpy(work_ + op, ip, lit);
+      ip += lit;
+      op += lit;
+      if (op == oend && ip == iend) break;
+      if (iend - ip < 2) return nullptr;
+      size_t offset = ip[0] | (size_t)ip[1] << 8;
+      ip += 2;
+      size_t matchLen = token & 0x0F;
+      if (matchLen == 15 && !getLength(ip, iend, matchLen)) return nullptr;
+      matchLen += LZ_MIN_MATCH;
+      if (offset == 0 || offset > op || op + matchLen > oend) return nullptr;
+      for (size_t i = 0; i < matchLen; i++, op++) work_[op] = work_[op - offset];  // may overlap
+    }
+    outLen = rawLen;
+    return work_ + dictLen_;
+  }
+
+ private:
+  static const size_t kDictMax = 4096;
+  static const uint16_t kEmpty = 0xFFFF;
+
+  static uint32_t hash(const uint8_t *p) {
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+  }
+
+  static uint8_t *putVarint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+      *p++ = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+  }
+
+  static uint8_t *putLength(uint8_t *op, size_t n) {
+    for (; n >= 255; n -= 255) *op++ = 255;
+    *op++ = (uint8_t)n;
+    return op;
+  }
+
+  static bool getLength(const uint8_t *&ip, const uint8_t *iend, size_t &n) {
+    uint8_t b;
+    do {
+      if (ip >= iend) return false;
+      b = *ip++;
+      n += b;
+    } while (b == 255);
+    return true;
+  }
+
+  // matchLen 0 writes the final, literal-only sequence.
+  static uint8_t *putSequence(uint8_t *op, uint8_t *oend, const uint8_t *lit, size_t litLen, size_t matchLen,
+                              size_t offset) {
+    size_t need = 1 + litLen + litLen / 255 + 1 + (matchLen ? 2 + matchLen / 255 + 1 : 0);
+    if ((size_t)(oend - op) < need) return nullptr;
+    size_t m = matchLen ? matchLen - LZ_MIN_MATCH : 0;
+    *op++ = (uint8_t)((litLen < 15 ? litLen : 15) << 4 | (m < 15 ? m : 15));
+    if (litLen >= 15) op = putLength(op, litLen - 15);
+    memcpy(op, lit, litLen);
+    op += litLen;
+    if (!matchLen) return op;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    if (m >= 15) op = putLength(op, m - 15);
+    return op;
+  }
+
+  const uint8_t *dict_;
+  size_t dictLen_;
+  uint8_t dictId_;
+  uint8_t work_[kDictMax + MaxInput];
+  uint16_t table_[(size_t)1 << LZ_HASH_BITS];
+};
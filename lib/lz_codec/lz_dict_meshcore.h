@@ -0,0 +1,34 @@
+// lib/lz_codec/lz_dict_meshcore.h
+#pragma once
+#include <stdint.h>
+
+// Preset dictionary for observer uplink batches (dictionary id 1).
+// Seeded from the JSON packet record layout; retrain on a capture with
+// "tools/lz_codec/lz_tool train" and bump the id, since a stream is only
+// readable with the dictionary it was compressed against. Matches are
+// cheapest close to the end, so the most common strings go last.
+#define LZ_DICT_MESHCORE_ID 1
+
+static const char LZ_DICT_MESHCORE[] =
+    ",\"crc\":false"
+    ",\"gps\":{\"lat\":"
+    ",\"lon\":"
+    "0000000000000000"
+    "FFFFFFFFFFFFFFFF"
+    "{\"observerId\":\""
+    "\",\"observerName\":\""
+    "\",\"ts\":"
+    "\n{\"sid\":"
+    ",{\"sid\":"
+    ",\"seq\":"
+    ",\"ts\":"
+    ",\"tsUs\":"
+    ",\"ptype\":"
+    ",\"crc\":true,\"rssi\":-"
+    ",\"snr\":"
+    ",\"snr\":-"
+    ",\"reported_len\":"
+    ",\"len\":"
+    ",\"payloadHex\":\""
+    "\",\"frameHash\":\""
+    "\",\"rxUs\":17";
@@ -0,0 +1,527 @@
+// lib/mqtt5_client/mqtt5_client.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Minimal MQTT 5 publisher with the PubSubClient calls the observer uses
+// (setServer, setBufferSize, connect, connected, publish, loop, disconnect,
+// state), so it can stand in for PubSubClient behind a build flag.
+//
+// What MQTT 5 buys the uplink:
+//  - topic aliases: the first PUBLISH on a topic carries the topic and an
+//    alias, later ones only the 2-byte alias, up to the broker's Topic
+//    Alias Maximum (aliases reset with every connection);
+//  - a user property (e.g. schema=1) on every PUBLISH, so consumers can
+//    tell record schema versions apart without touching the payload.
+//
+// QoS 0 publish, plus QoS 1 through publishQos1() for records that must
+// not be lost (spool replays); nextPubAck() hands out each PUBACK with its
+// packet identifier and reason code, so the caller can match them to what
+// it sent and tell a rejection from a delivery. No subscriptions.
+// Transport is anything with the Arduino Client calls (connect,
+// connected, available, read, write, stop): WiFiClientSecure on the
+// observer, an in-process broker stand-in on a host. Clock supplies milliseconds through a static ms(), and a static
+// idle() that gives up the CPU for about a tick while a read waits for
+// bytes (vTaskDelay(1) on the observer, so the wait does not starve other
+// tasks on the core).
+#define MQTT5_TOPIC_ALIASES   8
+#define MQTT5_TOPIC_MAX       96
+#define MQTT5_USER_PROP_MAX   16
+#define MQTT5_KEEPALIVE_S     15
+#define MQTT5_SOCKET_TIMEOUT_S 15
+// PUBACKs held for nextPubAck(); older ones are dropped when it is full.
+#define MQTT5_PUBACK_QUEUE    32
+// Worst-case PUBLISH property bytes: length, topic alias, one user property.
+#define MQTT5_PUBLISH_PROPS_MAX (2 + 3 + 1 + 2 * (2 + MQTT5_USER_PROP_MAX))
+
+// state() values, numbered like PubSubClient's; positive values are the
+// CONNACK reason code.
+#define MQTT5_CONNECTION_TIMEOUT -4
+#define MQTT5_CONNECTION_LOST    -3
+#define MQTT5_CONNECT_FAILED     -2
+#define MQTT5_DISCONNECTED       -1
+#define MQTT5_CONNECTED           0
+
+enum Mqtt5PacketType : uint8_t {
+  MQTT5_CONNECT = 0x10,
+  MQTT5_CONNACK = 0x20,
+  MQTT5_PUBLISH = 0x30,
+  MQTT5_PUBACK = 0x40,
+  MQTT5_PINGREQ = 0xC0,
+  MQTT5_PINGRESP = 0xD0,
+  MQTT5_DISCONNECT = 0xE0,
+};
+
+enum Mqtt5Property : uint8_t {
+  MQTT5_PROP_SERVER_KEEPALIVE = 0x13,
+  MQTT5_PROP_RECEIVE_MAX = 0x21,
+  MQTT5_PROP_TOPIC_ALIAS_MAX = 0x22,
+  MQTT5_PROP_TOPIC_ALIAS = 0x23,
+  MQTT5_PROP_MAX_QOS = 0x24,
+  MQTT5_PROP_RETAIN_AVAILABLE = 0x25,
+  MQTT5_PROP_USER = 0x26,
+  MQTT5_PROP_MAX_PACKET = 0x27,
+};
+
+// Writes an MQTT variable byte integer, returns its length.
+static inline size_t mqtt5PutVarint(uint8_t *p, uint32_t v) {
+  size_t n = 0;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    p[n++] = v ? (uint8_t)(b | 0x80) : b;
+  } while (v);
+  return n;
+}
+
+static inline size_t mqtt5VarintLen(uint32_t v) {
+  return v < 128 ? 1 : v < 16384 ? 2 : v < 2097152 ? 3 : 4;
+}
+
+// Reads a variable byte integer from [p, end); returns bytes used, 0 on error.
+static inline size_t mqtt5GetVarint(const uint8_t *p, const uint8_t *end, uint32_t &v) {
+  v = 0;
+  for (size_t i = 0; i < 4 && p + i < end; i++) {
+    v |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+    if (!(p[i] & 0x80)) return i + 1;
+  }
+  return 0;
+}
+
+// Size of a property value by identifier (MQTT 5 section 2.2.2.2):
+// >0 fixed bytes, -1 varint, -2 length-prefixed string or binary, -3 string
+// pair, 0 unknown.
+static inline int mqtt5PropertySize(uint8_t id) {
+  switch (id) {
+    case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+      return 1;
+    case 0x13: case 0x21: case 0x22: case 0x23:
+      return 2;
+    case 0x02: case 0x11: case 0x18: case 0x27:
+      return 4;
+    case 0x0B:
+      return -1;
+    case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+      return -2;
+    case 0x26:
+      return -3;
+    default:
+      return 0;
+  }
+}
+
+// Walks a property block, calling fn(id, value, valueLen) for each
+// property. Returns false if the block is malformed.
+template <class Fn>
+static inline bool mqtt5ForEachProperty(const uint8_t *p, const uint8_t *end, Fn fn) {
+  while (p < end) {
+    uint8_t id = *p++;
+    int size = mqtt5PropertySize(id);
+    size_t n;
+    if (size > 0) {
+      n = (size_t)size;
+    } else if (size == -1) {
+      uint32_t v;
+      n = mqtt5GetVarint(p, end, v);
+      if (!n) return false;
+    } else if (size == -2 || size == -3) {
+      n = 0;
+      for (int s = 0; s < (size == -3 ? 2 : 1); s++) {
+        if (end - p < (ptrdiff_t)(n + 2)) return false;
+        n += 2 + ((size_t)p[n] << 8 | p[n + 1]);
+      }
+    } else {
+      return false;
+    }
+    if ((size_t)(end - p) < n) return false;
+    fn(id, p, n);
+    p += n;
+  }
+  return true;
+}
+
+struct Mqtt5PubAck {
+  uint16_t packetId;
+  uint8_t reason;  // 0x00 when the PUBACK carries no reason code
+};
+
+// Success and No matching subscribers both mean the broker took the
+// message; 0x80 and up are failures (quota, not authorized, ...).
+static inline bool mqtt5PubAckOk(uint8_t reason) {
+  return reason == 0x00 || reason == 0x10;
+}
+
+// Value of a 1, 2 or 4-byte integer property; valueLen is its width.
+static inline uint32_t mqtt5PropertyUint(const uint8_t *v, size_t valueLen) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < valueLen && i < 4; i++) value = value << 8 | v[i];
+  return value;
+}
+
+template <class Transport, class Clock, size_t BufferSize = 2048>
+class Mqtt5Client {
+ public:
+  explicit Mqtt5Client(Transport &transport) : t_(transport) { userKey_[0] = userValue_[0] = '\0'; }
+
+  Mqtt5Client &setServer(const char *host, uint16_t port) {
+    host_ = host;
+    port_ = port;
+    return *this;
+  }
+
+  // The buffer is fixed at compile time; true if it is at least size.
+  bool setBufferSize(uint16_t size) { return size <= BufferSize; }
+  uint16_t getBufferSize() const { return BufferSize; }
+
+  Mqtt5Client &setKeepAlive(uint16_t seconds) {
+    keepAliveS_ = seconds;
+    return *this;
+  }
+
+  Mqtt5Client &setSocketTimeout(uint16_t seconds) {
+    socketTimeoutS_ = seconds;
+    return *this;
+  }
+
+  // Sent with every PUBLISH; an empty key turns it off. Key and value are
+  // cut to MQTT5_USER_PROP_MAX bytes.
+  void setUserProperty(const char *key, const char *value) {
+    copyCapped(userKey_, key);
+    copyCapped(userValue_, value);
+  }
+
+  uint16_t topicAliasMax() const { return aliasMax_; }
+  uint32_t bytesSent() const { return bytesSent_; }
+  // QoS 1 PUBLISHes the broker accepts unacknowledged (Receive Maximum).
+  uint16_t receiveMax() const { return receiveMax_; }
+  // Highest QoS the broker accepts (Maximum QoS), capped at the 1 this
+  // client speaks; with 0, publishQos1() sends nothing.
+  uint8_t maxQos() const { return maxQos_; }
+  // PUBACKs received since construction, across connections, whatever
+  // their reason code.
+  uint32_t pubAcks() const { return pubAcks_; }
+
+  // The oldest PUBACK not yet handed out, in arrival order. A reconnect
+  // does not clear them; packet identifiers keep counting across
+  // connections, so a late one never matches a newer publish.
+  bool nextPubAck(Mqtt5PubAck &ack) {
+    if (ackHead_ == ackTail_) return false;
+    ack = acks_[ackHead_++ % MQTT5_PUBACK_QUEUE];
+    return true;
+  }
+
+  bool connect(const char *id) { return connect(id, nullptr, nullptr); }
+
+  bool connect(const char *id, const char *user, const char *pass) {
+    if (connected()) return true;
+    if (!host_ || !t_.connect(host_, port_)) {
+      state_ = MQTT5_CONNECT_FAILED;
+      return false;
+    }
+    size_t idLen = strlen(id), userLen = user ? strlen(user) : 0, passLen = pass ? strlen(pass) : 0;
+    // Variable header: protocol name, level 5, flags, keep alive, no properties.
+    size_t body = 7 + 1 + 2 + 1 + 2 + idLen + (user ? 2 + userLen : 0) + (pass ? 2 + passLen : 0);
+    if (1 + mqtt5VarintLen(body) + body > BufferSize) {
+      t_.stop();
+      state_ = MQTT5_CONNECT_FAILED;
+      return false;
+    }
+    uint8_t *p = buf_;
+    *p++ = MQTT5_CONNECT;
+    p += mqtt5PutVarint(p, body);
+    static const uint8_t proto[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 5};
+    memcpy(p, proto, sizeof(proto));
+    p += sizeof(proto);
+    *p++ = (uint8_t)((user ? 0x80 : 0) | (pass ? 0x40 : 0) | 0x02);  // clean start
+    *p++ = (uint8_t)(keepAliveS_ >> 8);
+    *p++ = (uint8_t)keepAliveS_;
+    *p++ = 0;
+    p = putString(p, id, idLen);
+    if (user) p = putString(p, user, userLen);
+    if (pass) p = putString(p, pass, passLen);
+    if (!send(buf_, p - buf_)) {
+      t_.stop();
+      state_ = MQTT5_CONNECTION_LOST;
+      return false;
+    }
+
+    uint8_t type;
+    size_t len;
+    if (!readPacket(type, len)) {
+      t_.stop();
+      state_ = MQTT5_CONNECTION_TIMEOUT;
+      return false;
+    }
+    if ((type & 0xF0) != MQTT5_CONNACK || len < 2) {
+      t_.stop();
+      state_ = MQTT5_CONNECT_FAILED;
+      return false;
+    }
+    if (buf_[1] != 0) {
+      t_.stop();
+      state_ = buf_[1];
+      return false;
+    }
+    aliasMax_ = 0;
+    aliasCount_ = 0;
+    maxPacket_ = BufferSize;
+    retainAvailable_ = true;
+    receiveMax_ = 65535;
+    maxQos_ = 1;
+    uint32_t propLen;
+    size_t n = len > 2 ? mqtt5GetVarint(buf_ + 2, buf_ + len, propLen) : 0;
+    if (n && 2 + n + propLen <= len) {
+      // Each integer property is read at its own width: a 1-byte one may
+      // be the last byte of the packet.
+      mqtt5ForEachProperty(buf_ + 2 + n, buf_ + 2 + n + propLen, [this](uint8_t pid, const uint8_t *v, size_t vlen) {
+        uint32_t value = mqtt5PropertyUint(v, vlen);
+        if (pid == MQTT5_PROP_TOPIC_ALIAS_MAX) aliasMax_ = value < MQTT5_TOPIC_ALIASES ? value : MQTT5_TOPIC_ALIASES;
+        else if (pid == MQTT5_PROP_SERVER_KEEPALIVE) keepAliveS_ = (uint16_t)value;
+        else if (pid == MQTT5_PROP_RECEIVE_MAX) receiveMax_ = value ? (uint16_t)value : 1;
+        else if (pid == MQTT5_PROP_MAX_QOS) maxQos_ = value ? 1 : 0;
+        else if (pid == MQTT5_PROP_RETAIN_AVAILABLE) retainAvailable_ = value != 0;
+        else if (pid == MQTT5_PROP_MAX_PACKET && value < maxPacket_) maxPacket_ = value;
+      });
+    }
+    lastInMs_ = lastOutMs_ = Clock::ms();
+    pingOutstanding_ = false;
+    state_ = MQTT5_CONNECTED;
+    return true;
+  }
+
+  void disconnect() {
+    if (state_ == MQTT5_CONNECTED) {
+      const uint8_t pkt[] = {MQTT5_DISCONNECT, 0x00};
+      send(pkt, sizeof(pkt));
+    }
+    t_.stop();
+    state_ = MQTT5_DISCONNECTED;
+  }
+
+  bool connected() {
+    if (state_ != MQTT5_CONNECTED) return false;
+    if (!t_.connected()) {
+      t_.stop();
+      state_ = MQTT5_CONNECTION_LOST;
+      return false;
+    }
+    return true;
+  }
+
+  int state() const { return state_; }
+
+  bool publish(const char *topic, const char *payload) {
+    return publish(topic, (const uint8_t *)payload, strlen(payload), false);
+  }
+
+  bool publish(const char *topic, const char *payload, bool retained) {
+    return publish(topic, (const uint8_t *)payload, strlen(payload), retained);
+  }
+
+  bool publish(const char *topic, const uint8_t *payload, unsigned int len) {
+    return publish(topic, payload, len, false);
+  }
+
+  bool publish(const char *topic, const uint8_t *payload, unsigned int len, bool retained) {
+    return sendPublish(topic, payload, len, retained, 0);
+  }
+
+  // QoS 1 publish; returns the packet identifier, 0 if it was not sent
+  // (also when the broker's maxQos() is 0, which would make it a protocol
+  // error). The record has arrived once nextPubAck() returns a PUBACK for
+  // that identifier with mqtt5PubAckOk() reason; one that is rejected or
+  // still unacknowledged when the connection drops must be sent again.
+  uint16_t publishQos1(const char *topic, const uint8_t *payload, unsigned int len) {
+    if (!maxQos_) return 0;
+    if (++packetId_ == 0) packetId_ = 1;
+    return sendPublish(topic, payload, len, false, packetId_) ? packetId_ : 0;
+  }
+
+  // Keeps the connection alive and handles what the broker sends; false
+  // once the connection is gone.
+  bool loop() {
+    if (!connected()) return false;
+    uint32_t now = Clock::ms();
+    uint32_t keepAliveMs = (uint32_t)keepAliveS_ * 1000;
+    if (keepAliveMs && (now - lastInMs_ > keepAliveMs || now - lastOutMs_ > keepAliveMs)) {
+      if (pingOutstanding_) {
+        t_.stop();
+        state_ = MQTT5_CONNECTION_TIMEOUT;
+        return false;
+      }
+      const uint8_t ping[] = {MQTT5_PINGREQ, 0x00};
+      send(ping, sizeof(ping));
+      lastInMs_ = now;
+      pingOutstanding_ = true;
+    }
+    // Handle everything that has arrived, so a run of PUBACKs does not
+    // take one loop() call each.
+    while (t_.available()) {
+      uint8_t type;
+      size_t len;
+      if (!readPacket(type, len)) {
+        t_.stop();
+        state_ = MQTT5_CONNECTION_TIMEOUT;
+        return false;
+      }
+      lastInMs_ = Clock::ms();
+      switch (type & 0xF0) {
+        case MQTT5_PUBACK:
+          // Packet identifier, then a reason code unless it is Success.
+          if (len >= 2) {
+            if (ackTail_ - ackHead_ == MQTT5_PUBACK_QUEUE) ackHead_++;
+            Mqtt5PubAck &a = acks_[ackTail_++ % MQTT5_PUBACK_QUEUE];
+            a.packetId = (uint16_t)(buf_[0] << 8 | buf_[1]);
+            a.reason = len > 2 ? buf_[2] : 0;
+          }
+          pubAcks_++;
+          break;
+        case MQTT5_PINGRESP:
+          pingOutstanding_ = false;
+          break;
+        case MQTT5_PINGREQ: {
+          const uint8_t pong[] = {MQTT5_PINGRESP, 0x00};
+          send(pong, sizeof(pong));
+          break;
+        }
+        case MQTT5_DISCONNECT:
+          t_.stop();
+          state_ = MQTT5_CONNECTION_LOST;
+          return false;
+        default:
+          break;  // nothing subscribed; anything else is ignored
+      }
+    }
+    return true;
+  }
+
+ private:
+  // Builds and sends one PUBLISH; packetId 0 means QoS 0.
+  bool sendPublish(const char *topic, const uint8_t *payload, unsigned int len, bool retained, uint16_t packetId) {
+    if (!connected()) return false;
+    size_t topicLen = strlen(topic);
+    uint16_t alias = 0;
+    bool sendTopic = true;
+    for (uint8_t i = 0; i < aliasCount_; i++) {
+      if (!strcmp(aliases_[i], topic)) {
+        alias = i + 1;
+        sendTopic = false;
+        break;
+      }
+    }
+    bool newAlias = !alias && aliasCount_ < aliasMax_ && topicLen < MQTT5_TOPIC_MAX;
+    if (newAlias) alias = aliasCount_ + 1;
+
+    size_t keyLen = strlen(userKey_), valueLen = strlen(userValue_);
+    size_t props = (alias ? 3 : 0) + (keyLen ? 1 + 2 + keyLen + 2 + valueLen : 0);
+    size_t body = 2 + (sendTopic ? topicLen : 0) + (packetId ? 2 : 0) + mqtt5VarintLen(props) + props + len;
+    size_t total = 1 + mqtt5VarintLen(body) + body;
+    if (total > BufferSize || total > maxPacket_) return false;
+
+    uint8_t *p = buf_;
+    *p++ = (uint8_t)(MQTT5_PUBLISH | (packetId ? 0x02 : 0) | (retained && retainAvailable_ ? 1 : 0));
+    p += mqtt5PutVarint(p, body);
+    p = putString(p, topic, sendTopic ? topicLen : 0);
+    if (packetId) {
+      *p++ = (uint8_t)(packetId >> 8);
+      *p++ = (uint8_t)packetId;
+    }
+    p += mqtt5PutVarint(p, props);
+    if (alias) {
+      *p++ = MQTT5_PROP_TOPIC_ALIAS;
+      *p++ = (uint8_t)(alias >> 8);
+      *p++ = (uint8_t)alias;
+    }
+    if (keyLen) {
+      *p++ = MQTT5_PROP_USER;
+      p = putString(p, userKey_, keyLen);
+      p = putString(p, userValue_, valueLen);
+    }
+    memcpy(p, payload, len);
+    p += len;
+    if (!send(buf_, p - buf_)) return false;
+    // Only count the alias as known to the broker once it has been sent.
+    if (newAlias) memcpy(aliases_[aliasCount_++], topic, topicLen + 1);
+    return true;
+  }
+
+  static void copyCapped(char *dst, const char *src) {
+    size_t n = src ? strlen(src) : 0;
+    if (n > MQTT5_USER_PROP_MAX) n = MQTT5_USER_PROP_MAX;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+
+  static uint8_t *putString(uint8_t *p, const char *s, size_t n) {
+    *p++ = (uint8_t)(n >> 8);
+    *p++ = (uint8_t)n;
+    memcpy(p, s, n);
+    return p + n;
+  }
+
+  bool send(const uint8_t *data, size_t len) {
+    size_t n = t_.write(data, len);
+    bytesSent_ += n;
+    lastOutMs_ = Clock::ms();
+    return n == len;
+  }
+
+  // Waits for a byte until the socket timeout, counted from start.
+  bool readByte(uint8_t &b, uint32_t start) {
+    while (!t_.available()) {
+      if (!t_.connected() || Clock::ms() - start >= (uint32_t)socketTimeoutS_ * 1000) return false;
+      Clock::idle();
+    }
+    b = (uint8_t)t_.read();
+    return true;
+  }
+
+  // Reads one packet; the body lands in buf_ (cut to BufferSize, the rest
+  // is skipped) and len is the body length as stored. The whole packet has
+  // one socket timeout, so a broker trickling bytes cannot hold the task.
+  bool readPacket(uint8_t &type, size_t &len) {
+    uint32_t start = Clock::ms();
+    if (!readByte(type, start)) return false;
+    uint32_t remaining = 0;
+    for (int i = 0;; i++) {
+      uint8_t b;
+      if (i == 4 || !readByte(b, start)) return false;
+      remaining |= (uint32_t)(b & 0x7F) << (7 * i);
+      if (!(b & 0x80)) break;
+    }
+    len = 0;
+    for (uint32_t i = 0; i < remaining; i++) {
+      uint8_t b;
+      if (!readByte(b, start)) return false;
+      if (len < BufferSize) buf_[len++] = b;
+    }
+    return true;
+  }
+
+  Transport &t_;
+  const char *host_ = nullptr;
+  uint16_t port_ = 0;
+  uint16_t keepAliveS_ = MQTT5_KEEPALIVE_S;
+  uint16_t socketTimeoutS_ = MQTT5_SOCKET_TIMEOUT_S;
+  int state_ = MQTT5_DISCONNECTED;
+  uint32_t lastInMs_ = 0;
+  uint32_t lastOutMs_ = 0;
+  bool pingOutstanding_ = false;
+  bool retainAvailable_ = true;
+  uint32_t maxPacket_ = BufferSize;
+  uint16_t receiveMax_ = 65535;
+  uint8_t maxQos_ = 1;
+  uint16_t packetId_ = 0;
+  uint32_t pubAcks_ = 0;
+  Mqtt5PubAck acks_[MQTT5_PUBACK_QUEUE];
+  uint32_t ackHead_ = 0;
+  uint32_t ackTail_ = 0;
+  uint16_t aliasMax_ = 0;
+  uint8_t aliasCount_ = 0;
+  uint32_t bytesSent_ = 0;
+  char aliases_[MQTT5_TOPIC_ALIASES][MQTT5_TOPIC_MAX];
+  char userKey_[MQTT5_USER_PROP_MAX + 1];
+  char userValue_[MQTT5_USER_PROP_MAX + 1];
+  uint8_t buf_[BufferSize];
+};
@@ -0,0 +1,185 @@
+// lib/obs_record/obs_record.h
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary form of one observed frame, the alternative to the JSON
+// packet record. Observer id, name and position are not repeated per frame;
+// the id is in the topic and the rest is observer metadata.
+//
+// Version 1, one record:
+//   magic        1 byte   OBS_RECORD_MAGIC | version
+//   bodyLen      varint   bytes that follow; a decoder skips fields it
+//                         does not know by jumping over the whole body
+//   flags        1 byte   OBS_FLAG_*
+//   tsUs         varint   capture time, esp_timer microseconds
+//   rxUs         varint   capture time, Unix microseconds (OBS_FLAG_RX_US)
+//   sid          varint   observer session id (OBS_FLAG_SESSION)
+//   seq          varint   record number within the session (OBS_FLAG_SESSION)
+//   rssi         zigzag   0.1 dBm
+//   snr          zigzag   0.01 dB
+//   reportedLen  varint   length the radio reported
+//   len          varint   payload bytes captured
+//   payload      len bytes
+//   hash         32 bytes SHA-256 of the payload, or its first 16 bytes
+//                         (OBS_FLAG_HASH16)
+//
+// Records are self-delimiting, so a PUBLISH may carry several back to back.
+// The SX1262 reports RSSI in 0.5 dB and SNR in 0.25 dB steps, so the fixed
+// point fields are lossless.
+#define OBS_RECORD_MAGIC   0xB0
+#define OBS_RECORD_VERSION 1
+#define OBS_RECORD_HASH_LEN 32
+// Worst case for a 255-byte payload with every varint at full width.
+#define OBS_RECORD_MAX (1 + 3 + 1 + 10 + 10 + 5 + 5 + 3 + 3 + 3 + 2 + 255 + OBS_RECORD_HASH_LEN)
+
+enum : uint8_t {
+  OBS_FLAG_CRC_OK = 0x01,
+  OBS_FLAG_RX_US = 0x02,
+  OBS_FLAG_SESSION = 0x04,
+  OBS_FLAG_HASH16 = 0x08,
+};
+
+struct ObsRecord {
+  uint8_t flags;
+  int64_t tsUs;
+  int64_t rxUs;
+  uint32_t sid;
+  uint32_t seq;
+  int16_t rssiDeci;
+  int16_t snrCenti;
+  uint16_t reportedLen;
+  uint16_t len;
+  const uint8_t *payload;  // decode: points into the input buffer
+  const uint8_t *hash;     // obsRecordHashLen(flags) bytes
+};
+
+static inline size_t obsRecordHashLen(uint8_t flags) {
+  return (flags & OBS_FLAG_HASH16) ? 16 : OBS_RECORD_HASH_LEN;
+}
+
+static inline bool obsRecordIsBinary(uint8_t first) {
+  return (first & 0xF0) == OBS_RECORD_MAGIC;
+}
+
+static inline int16_t obsRecordFixed(float v, float scale) {
+  return (int16_t)lroundf(v * scale);
+}
+
+static inline size_t obsVarintLen(uint64_t v) {
+  size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+static inline uint8_t *obsPutVarint(uint8_t *out, uint64_t v) {
+  while (v >= 0x80) {
+    *out++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *out++ = (uint8_t)v;
+  return out;
+}
+
+static inline uint64_t obsZigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t obsUnzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Returns the encoded size, or 0 if it does not fit in cap.
+static inline size_t obsRecordEncode(const ObsRecord &r, uint8_t *out, size_t cap) {
+  bool hasRx = r.flags & OBS_FLAG_RX_US;
+  bool hasSession = r.flags & OBS_FLAG_SESSION;
+  size_t body = 1 + obsVarintLen((uint64_t)r.tsUs) + (hasRx ? obsVarintLen((uint64_t)r.rxUs) : 0) +
+                (hasSession ? obsVarintLen(r.sid) + obsVarintLen(r.seq) : 0) +
+                obsVarintLen(obsZigzag(r.rssiDeci)) + obsVarintLen(obsZigzag(r.snrCenti)) +
+                obsVarintLen(r.reportedLen) + obsVarintLen(r.len) + r.len + obsRecordHashLen(r.flags);
+  size_t total = 1 + obsVarintLen(body) + body;
+  if (total > cap) return 0;
+
+  uint8_t *p = out;
+  *p++ = OBS_RECORD_MAGIC | OBS_RECORD_VERSION;
+  p = obsPutVarint(p, body);
+  *p++ = r.flags;
+  p = obsPutVarint(p, (uint64_t)r.tsUs);
+  if (hasRx) p = obsPutVarint(p, (uint64_t)r.rxUs);
+  if (hasSession) {
+    p = obsPutVarint(p, r.sid);
+    p = obsPutVarint(p, r.seq);
+  }
+  p = obsPutVarint(p, obsZigzag(r.rssiDeci));
+  p = obsPutVarint(p, obsZigzag(r.snrCenti));
+  p = obsPutVarint(p, r.reportedLen);
+  p = obsPutVarint(p, r.len);
+  for (uint16_t i = 0; i < r.len; i++) *p++ = r.payload[i];
+  for (size_t i = 0; i < obsRecordHashLen(r.flags); i++) *p++ = r.hash[i];
+  return (size_t)(p - out);
+}
+
+class ObsReader {
+ public:
+  ObsReader(const uint8_t *data, size_t len) : p_(data), end_(data + len) {}
+
+  bool varint(uint64_t &v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && p_ < end_; shift += 7) {
+      uint8_t b = *p_++;
+      v |= (uint64_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  bool bytes(const uint8_t *&out, size_t n) {
+    if ((size_t)(end_ - p_) < n) return false;
+    out = p_;
+    p_ += n;
+    return true;
+  }
+
+  const uint8_t *pos() const { return p_; }
+
+ private:
+  const uint8_t *p_;
+  const uint8_t *end_;
+};
+
+// Decodes the record at the start of data. Returns the bytes it spans, or
+// 0 if the input is truncated, malformed or of a newer version.
+static inline size_t obsRecordDecode(const uint8_t *data, size_t len, ObsRecord &r) {
+  if (len < 2 || !obsRecordIsBinary(data[0]) || (data[0] & 0x0F) != OBS_RECORD_VERSION) return 0;
+  ObsReader in(data + 1, len - 1);
+  uint64_t body;
+  if (!in.varint(body) || body > len) return 0;
+  const uint8_t *start;
+  if (!in.bytes(start, (size_t)body)) return 0;
+  size_t total = (size_t)(start + body - data);
+
+  ObsReader f(start, (size_t)body);
+  const uint8_t *flags;
+  uint64_t ts, rx = 0, sid = 0, seq = 0, rssi, snr, reported, n;
+  if (!f.bytes(flags, 1) || !f.varint(ts)) return 0;
+  if ((*flags & OBS_FLAG_RX_US) && !f.varint(rx)) return 0;
+  if ((*flags & OBS_FLAG_SESSION) && (!f.varint(sid) || !f.varint(seq))) return 0;
+  if (!f.varint(rssi) || !f.varint(snr) || !f.varint(reported) || !f.varint(n)) return 0;
+  if (n > 0xFFFF || reported > 0xFFFF) return 0;
+  if (!f.bytes(r.payload, (size_t)n) || !f.bytes(r.hash, obsRecordHashLen(*flags))) return 0;
+
+  r.flags = *flags;
+  r.tsUs = (int64_t)ts;
+  r.rxUs = (int64_t)rx;
+  r.sid = (uint32_t)sid;
+  r.seq = (uint32_t)seq;
+  r.rssiDeci = (int16_t)obsUnzigzag(rssi);
+  r.snrCenti = (int16_t)obsUnzigzag(snr);
+  r.reportedLen = (uint16_t)reported;
+  r.len = (uint16_t)n;
+  return total;
+}
@@ -0,0 +1,142 @@
+// lib/ram_ring/ram_ring.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// FIFO of variable-length records in a caller-supplied byte buffer, so it
+// can live in PSRAM: the observer's first spool tier, which absorbs short
+// uplink outages before anything reaches flash.
+//
+// Records are stored back to back as a 6-byte header (length, arrival ms)
+// plus the bytes, wrapping at the end of the buffer. Reading works like
+// lib/spool: next() returns the record after the read cursor, ack() frees
+// the oldest record handed out, rewind() moves the cursor back to the
+// oldest record. front()/pop() take records off the other end unread, for
+// spilling to the next tier. Not locked; the caller serializes access.
+#define RAM_RING_HEADER 6
+
+class RamRing {
+ public:
+  void begin(uint8_t *buf, size_t size) {
+    buf_ = buf;
+    size_ = buf ? size : 0;
+    head_ = tail_ = used_ = cursor_ = 0;
+    records_ = unacked_ = 0;
+  }
+
+  // False if the record does not fit in the free space.
+  bool push(const uint8_t *data, size_t len, uint32_t nowMs) {
+    if (len > 0xFFFF || used_ + RAM_RING_HEADER + len > size_) return false;
+    uint8_t hdr[RAM_RING_HEADER] = {(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)nowMs, (uint8_t)(nowMs >> 8),
+                                    (uint8_t)(nowMs >> 16), (uint8_t)(nowMs >> 24)};
+    tail_ = copyIn(tail_, hdr, RAM_RING_HEADER);
+    tail_ = copyIn(tail_, data, len);
+    used_ += RAM_RING_HEADER + len;
+    if (used_ > highWater_) highWater_ = used_;
+    records_++;
+    return true;
+  }
+
+  // Next record past the read cursor; false when all have been read.
+  bool next(uint8_t *out, size_t cap, size_t &len) {
+    if (unacked_ == records_) return false;
+    size_t at = cursor_;
+    uint32_t ms;
+    len = readHeader(at, ms);
+    at = advance(at, RAM_RING_HEADER);
+    if (len <= cap) copyOut(at, out, len);
+    else len = 0;  // cannot happen with cap >= the largest record pushed
+    cursor_ = advance(at, recordLen(cursor_) - RAM_RING_HEADER);
+    unacked_++;
+    return true;
+  }
+
+  // The oldest record handed out by next() has been delivered.
+  void ack() {
+    if (!unacked_) return;
+    unacked_--;
+    drop();
+  }
+
+  void rewind() {
+    cursor_ = head_;
+    unacked_ = 0;
+  }
+
+  // The oldest record, whether read or not.
+  bool front(uint8_t *out, size_t cap, size_t &len) const {
+    if (!records_) return false;
+    uint32_t ms;
+    len = readHeader(head_, ms);
+    if (len > cap) return false;
+    copyOut(advance(head_, RAM_RING_HEADER), out, len);
+    return true;
+  }
+
+  // Drops the oldest record; one that was read is forgotten by the cursor.
+  void pop() {
+    if (!records_) return;
+    if (unacked_) unacked_--;
+    else cursor_ = advance(head_, recordLen(head_));
+    drop();
+  }
+
+  uint32_t oldestMs() const {
+    uint32_t ms = 0;
+    if (records_) readHeader(head_, ms);
+    return ms;
+  }
+
+  size_t capacity() const { return size_; }
+  size_t bytes() const { return used_; }
+  size_t highWater() const { return highWater_; }
+  uint32_t records() const { return records_; }
+  uint32_t unacked() const { return unacked_; }
+
+ private:
+  size_t advance(size_t at, size_t n) const { return (at + n) % size_; }
+
+  size_t recordLen(size_t at) const {
+    uint32_t ms;
+    return RAM_RING_HEADER + readHeader(at, ms);
+  }
+
+  size_t readHeader(size_t at, uint32_t &ms) const {
+    uint8_t hdr[RAM_RING_HEADER];
+    copyOut(at, hdr, RAM_RING_HEADER);
+    ms = (uint32_t)hdr[2] | (uint32_t)hdr[3] << 8 | (uint32_t)hdr[4] << 16 | (uint32_t)hdr[5] << 24;
+    return (size_t)hdr[0] | (size_t)hdr[1] << 8;
+  }
+
+  void drop() {
+    size_t n = recordLen(head_);
+    head_ = advance(head_, n);
+    used_ -= n;
+    records_--;
+    if (!records_) head_ = tail_ = cursor_ = 0;
+  }
+
+  size_t copyIn(size_t at, const uint8_t *src, size_t n) {
+    size_t first = n < size_ - at ? n : size_ - at;
+    memcpy(buf_ + at, src, first);
+    memcpy(buf_, src + first, n - first);
+    return advance(at, n);
+  }
+
+  void copyOut(size_t at, uint8_t *dst, size_t n) const {
+    size_t first = n < size_ - at ? n : size_ - at;
+    memcpy(dst, buf_ + at, first);
+    memcpy(dst + first, buf_, n - first);
+  }
+
+  uint8_t *buf_ = nullptr;
+  size_t size_ = 0;
+  size_t head_ = 0;
+  size_t tail_ = 0;
+  size_t used_ = 0;
+  size_t cursor_ = 0;
+  size_t highWater_ = 0;
+  uint32_t records_ = 0;
+  uint32_t unacked_ = 0;
+};
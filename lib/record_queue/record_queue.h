@@ -0,0 +1,107 @@
+// lib/record_queue/record_queue.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+
+// Bounded FIFO of serialized uplink records, shared by the task that builds
+// records and the task that publishes them. Records live in a preallocated
+// pool; the FIFO itself is a short array of slot ids, so the backpressure
+// policies can evict from the middle without moving record bodies.
+//
+// Every call takes an internal lock; pop() copies the record out so the
+// lock is never held across a network write.
+template <size_t N, size_t MaxLen>
+class RecordQueue {
+  static_assert(N > 0 && N <= 255, "RecordQueue holds at most 255 records");
+
+ public:
+  struct Record {
+    int64_t enqueuedUs;
+    uint8_t type;        // MeshCore payload type, used by dropOldestOfType()
+    uint16_t len;
+    char data[MaxLen];
+  };
+
+  RecordQueue() {
+    for (size_t i = 0; i < N; i++) free_[i] = (uint8_t)i;
+  }
+
+  static constexpr size_t capacity() { return N; }
+  static constexpr size_t maxLen() { return MaxLen; }
+
+  // Appends a record; false when the queue is full or the record does not
+  // fit in a slot.
+  bool push(const char *data, size_t len, uint8_t type, int64_t nowUs) {
+    if (len > MaxLen) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == N) return false;
+    uint8_t id = free_[N - 1 - count_];
+    Record &r = slots_[id];
+    memcpy(r.data, data, len);
+    r.len = (uint16_t)len;
+    r.type = type;
+    r.enqueuedUs = nowUs;
+    order_[count_++] = id;
+    if (count_ > highWater_) highWater_ = count_;
+    return true;
+  }
+
+  // Copies the oldest record into `out` and frees its slot.
+  bool pop(Record &out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0) return false;
+    const Record &r = slots_[order_[0]];
+    out.enqueuedUs = r.enqueuedUs;
+    out.type = r.type;
+    out.len = r.len;
+    memcpy(out.data, r.data, r.len);
+    removeAt(0);
+    return true;
+  }
+
+  bool dropOldest() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0) return false;
+    removeAt(0);
+    return true;
+  }
+
+  // Evicts the oldest record whose type bit is set in `typeMask`.
+  bool dropOldestOfType(uint32_t typeMask) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < count_; i++) {
+      if (typeMask & (1UL << (slots_[order_[i]].type & 31))) {
+        removeAt(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+  }
+  bool full() const { return size() == N; }
+  size_t highWater() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return highWater_;
+  }
+
+ private:
+  void removeAt(size_t pos) {
+    uint8_t id = order_[pos];
+    memmove(&order_[pos], &order_[pos + 1], count_ - pos - 1);
+    count_--;
+    free_[N - 1 - count_] = id;
+  }
+
+  Record slots_[N];
+  uint8_t order_[N];   // FIFO of occupied slot ids, oldest first
+  uint8_t free_[N];    // free slot ids live in free_[0 .. N - count_)
+  size_t count_ = 0;
+  size_t highWater_ = 0;
+  mutable std::mutex mutex_;
+};
@@ -0,0 +1,145 @@
+// lib/rf_record/rf_record.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "json_writer.h"
+#include "obs_record.h"
+
+// The sniffer's capture record, shared by the firmware (both output modes)
+// and the host reader, so the JSON a reader rebuilds from a binary capture
+// is exactly the line the sniffer would have printed.
+//
+// Binary layout, carried in a COBS frame (lib/cobs_frame), which supplies
+// the length:
+//   type         1 byte   RF_RECORD_FRAME
+//   flags        1 byte   RF_FLAG_*
+//   ts           varint   millis() when the record was written
+//   state        zigzag   RadioLib readData() result
+//   rssi         zigzag   0.1 dBm
+//   snr          zigzag   0.01 dB
+//   reportedLen  varint
+//   len          varint
+//   fp           8 bytes  fingerprint, little-endian
+//   rearmUs      varint   DIO1 to re-armed (RF_FLAG_REARM)
+//   payload      len bytes
+//
+// Stats frame, every few seconds in binary mode:
+//   type RF_STATS_FRAME | uptimeMs | records | txBytes | queueDrops | baud
+//   (all varints)
+#define RF_RECORD_FRAME 0xA1
+#define RF_STATS_FRAME  0xA2
+#define RF_RECORD_MAX   (2 + 5 + 3 + 3 + 3 + 3 + 2 + 8 + 5 + 255)
+
+enum : uint8_t {
+  RF_FLAG_REARM = 0x01,
+};
+
+struct RfRecord {
+  uint8_t flags;
+  uint32_t ts;
+  int16_t state;
+  int16_t rssiDeci;
+  int16_t snrCenti;
+  uint16_t reportedLen;
+  uint16_t len;
+  uint64_t fp;
+  int32_t rearmUs;
+  const uint8_t *payload;  // decode: points into the input buffer
+};
+
+struct RfStats {
+  uint32_t uptimeMs;
+  uint32_t records;
+  uint32_t txBytes;
+  uint32_t queueDrops;
+  uint32_t baud;
+};
+
+// Returns the encoded size, or 0 if it does not fit in cap.
+static inline size_t rfRecordEncode(const RfRecord &r, uint8_t *out, size_t cap) {
+  if (cap < RF_RECORD_MAX || r.len > 255) return 0;
+  uint8_t *p = out;
+  *p++ = RF_RECORD_FRAME;
+  *p++ = r.flags;
+  p = obsPutVarint(p, r.ts);
+  p = obsPutVarint(p, obsZigzag(r.state));
+  p = obsPutVarint(p, obsZigzag(r.rssiDeci));
+  p = obsPutVarint(p, obsZigzag(r.snrCenti));
+  p = obsPutVarint(p, r.reportedLen);
+  p = obsPutVarint(p, r.len);
+  for (int i = 0; i < 8; i++) *p++ = (uint8_t)(r.fp >> (8 * i));
+  if (r.flags & RF_FLAG_REARM) p = obsPutVarint(p, obsZigzag(r.rearmUs));
+  for (uint16_t i = 0; i < r.len; i++) *p++ = r.payload[i];
+  return (size_t)(p - out);
+}
+
+static inline bool rfRecordDecode(const uint8_t *data, size_t len, RfRecord &r) {
+  if (len < 2 || data[0] != RF_RECORD_FRAME) return false;
+  ObsReader in(data + 2, len - 2);
+  uint64_t ts, state, rssi, snr, reported, n, rearm = 0;
+  const uint8_t *fp;
+  if (!in.varint(ts) || !in.varint(state) || !in.varint(rssi) || !in.varint(snr) || !in.varint(reported) ||
+      !in.varint(n) || !in.bytes(fp, 8)) {
+    return false;
+  }
+  if ((data[1] & RF_FLAG_REARM) && !in.varint(rearm)) return false;
+  if (n > 255 || !in.bytes(r.payload, (size_t)n)) return false;
+  r.flags = data[1];
+  r.ts = (uint32_t)ts;
+  r.state = (int16_t)obsUnzigzag(state);
+  r.rssiDeci = (int16_t)obsUnzigzag(rssi);
+  r.snrCenti = (int16_t)obsUnzigzag(snr);
+  r.reportedLen = (uint16_t)reported;
+  r.len = (uint16_t)n;
+  r.fp = 0;
+  for (int i = 0; i < 8; i++) r.fp |= (uint64_t)fp[i] << (8 * i);
+  r.rearmUs = (int32_t)obsUnzigzag(rearm);
+  return true;
+}
+
+static inline size_t rfStatsEncode(const RfStats &s, uint8_t *out, size_t cap) {
+  if (cap < 1 + 5 * 5) return 0;
+  uint8_t *p = out;
+  *p++ = RF_STATS_FRAME;
+  p = obsPutVarint(p, s.uptimeMs);
+  p = obsPutVarint(p, s.records);
+  p = obsPutVarint(p, s.txBytes);
+  p = obsPutVarint(p, s.queueDrops);
+  p = obsPutVarint(p, s.baud);
+  return (size_t)(p - out);
+}
+
+static inline bool rfStatsDecode(const uint8_t *data, size_t len, RfStats &s) {
+  if (len < 1 || data[0] != RF_STATS_FRAME) return false;
+  ObsReader in(data + 1, len - 1);
+  uint64_t v[5];
+  for (int i = 0; i < 5; i++) {
+    if (!in.varint(v[i])) return false;
+  }
+  s.uptimeMs = (uint32_t)v[0];
+  s.records = (uint32_t)v[1];
+  s.txBytes = (uint32_t)v[2];
+  s.queueDrops = (uint32_t)v[3];
+  s.baud = (uint32_t)v[4];
+  return true;
+}
+
+// The sniffer's "rf" JSON line, CR LF included. Returns its length, or 0
+// if it does not fit in cap.
+static inline size_t rfRecordJson(const RfRecord &r, char *out, size_t cap) {
+  uint8_t fp[8];
+  for (int i = 0; i < 8; i++) fp[i] = (uint8_t)(r.fp >> (56 - 8 * i));
+  JsonWriter w(out, cap);
+  w.raw("{\"type\":\"rf\",\"ts\":").u64(r.ts)
+   .raw(",\"ptype\":").i64(r.len > 0 ? r.payload[0] : -1)
+   .raw(",\"fp\":\"").hex(fp, sizeof(fp)).raw("\"")
+   .raw(",\"state\":").i64(r.state)
+   .raw(",\"crc\":").boolean(r.state == 0)  // RADIOLIB_ERR_NONE
+   .raw(",\"rssi\":").fixed(r.rssiDeci / 10.0f, 1)
+   .raw(",\"snr\":").fixed(r.snrCenti / 100.0f, 2)
+   .raw(",\"reported_len\":").i64(r.reportedLen)
+   .raw(",\"len\":").i64(r.len);
+  if (r.flags & RF_FLAG_REARM) w.raw(",\"rearm_us\":").i64(r.rearmUs);
+  w.raw(",\"hex\":\"").hex(r.payload, r.len).raw("\"}\r\n");
+  return w.ok() ? w.size() : 0;
+}
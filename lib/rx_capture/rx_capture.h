@@ -0,0 +1,50 @@
+// lib/rx_capture/rx_capture.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "frame_ring.h"
+
+// The radio-core step of the observer's receive path, run by the rx task
+// once per DIO1: read the FIFO into the next ring slot, put the radio back
+// into RX, and only then hash the frame and hand it to the proc task.
+// Anything that can wait (hashing here, serializing and publishing in the
+// proc and uplink tasks) runs after startReceive(), so the radio is deaf
+// for the SPI reads and nothing else.
+//
+// Radio is anything with the RadioLib SX126x calls used below (the SX1262
+// on the observer, a fake radio in tools/rx_sim); Hash is called as
+// hash(data, len, out[32]).
+
+// Reads the frame the radio holds into `frame` and re-arms it. A reported
+// length of 0 or less falls back to a full-size read.
+template <class Radio>
+static inline void rxReadFrame(Radio &radio, RxFrame &frame) {
+  frame.reportedLen = (int16_t)radio.getPacketLength();
+  int len = frame.reportedLen;
+  if (len <= 0) len = (int)sizeof(frame.data);
+  if (len > (int)sizeof(frame.data)) len = sizeof(frame.data);
+  frame.len = (int16_t)len;
+  frame.rssi = radio.getRSSI();
+  frame.snr = radio.getSNR();
+  frame.state = (int16_t)radio.readData(frame.data, len);
+  radio.startReceive();
+}
+
+// One capture: the frame lands in a ring slot, or in `scratch` when the
+// ring is full (the FIFO still has to be emptied before the radio can be
+// re-armed; the ring counts the overflow). A slot is hashed and committed
+// after the re-arm. Returns the frame read; it stays valid until the next
+// capture, since the proc task never writes a slot.
+template <size_t N, class Radio, class Hash>
+static inline const RxFrame &rxCapture(Radio &radio, FrameRing<N> &ring, RxFrame &scratch, int64_t captureUs,
+                                       Hash hash) {
+  RxFrame *slot = ring.acquire();
+  RxFrame &frame = slot ? *slot : scratch;
+  frame.captureUs = captureUs;
+  rxReadFrame(radio, frame);
+  if (slot) {
+    hash(frame.data, (size_t)frame.len, frame.hash);
+    ring.commit();
+  }
+  return frame;
+}
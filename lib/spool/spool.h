@@ -0,0 +1,738 @@
+// lib/spool/spool.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crc32.h"
+
+// The observer's flash spool: a ring of fixed-size segment files
+// (<prefix>.<n>). Each segment starts with a 16-byte header
+//   magic "SPS1" | segment number | seq of its first record | crc32
+// followed by binary records
+//   len (u16) | seq (u32) | record bytes | crc32 over len, seq and bytes
+// all little-endian. seq numbers records across segments and reboots.
+//
+// Appends go to the tail segment; when it is full the next one is started,
+// and once the ring holds maxSegments the oldest (head) segment is evicted,
+// so a long outage loses its oldest records a segment at a time instead of
+// the whole backlog. Head and tail are persisted in a meta file, written
+// only when a segment is started or dropped. It goes to two slots in turn,
+// <prefix>.meta and <prefix>.meta1, each with a generation number and a
+// crc32, so a power cut while one is rewritten leaves the other intact.
+// With neither slot valid, begin() rebuilds head and tail from the
+// <prefix>.<n> files it finds. Files right after the tail are taken into
+// the ring; other segment files outside it are removed.
+//
+// Reading back is checkpointed: next() hands out records together with the
+// position just past them, and the caller acks that position once the
+// record is delivered (on publish, or on the PUBACK with QoS 1). rewind()
+// goes back to the last ack, so a flush cut short resumes there instead of
+// at the start of the head segment. The acked offset in the head segment
+// is persisted with head and tail every SPOOL_CHECKPOINT_RECORDS acks and
+// whenever a segment is dropped, so after a reboot at most that many
+// records are sent twice.
+//
+// begin() recovers from a power cut without reading records back: it
+// checks the segment headers and walks the tail segment by record length,
+// verifying only the CRC of its last record. A torn tail is cut off at the
+// last good record. SPIFFS cannot truncate, so the cut is logical: appends
+// continue in a new segment and the reader stops where the CRC fails.
+//
+// The filesystem is mounted once by the caller and the tail handle stays
+// open between records. Records collect in a RAM buffer and reach flash in
+// one write + flush ("commit") once commitBytes are pending or the oldest
+// pending record is commitMs old, so a power cut loses at most that window
+// of spooled records. Fs and File are the Arduino fs::FS and fs::File (or
+// anything with the same open/remove/exists and read/write/seek/flush/
+// size/close calls, plus openNextFile/name to list the prefix's directory).
+//
+// Spools of earlier firmware held text lines (one record per line, JSON as
+// is, binary records hex-encoded): begin() converts the segments of such a
+// ring to binary records, and importText() carries over the single spool
+// file that came before the ring.
+#define SPOOL_COMMIT_BYTES  2048
+#define SPOOL_COMMIT_MS     2000
+#define SPOOL_SEGMENT_BYTES (16 * 1024)
+#define SPOOL_MIN_SEGMENTS  2
+#define SPOOL_PATH_MAX      32
+#define SPOOL_READ_CHUNK    256
+// Flash page size used to estimate write amplification: every commit
+// programs the pages it touches and rewrites one index page.
+#define SPOOL_FLASH_PAGE    256
+#define SPOOL_CHECKPOINT_RECORDS 32
+#define SPOOL_SEGMENT_HEADER  16
+#define SPOOL_RECORD_HEADER   6                          // len, seq
+#define SPOOL_RECORD_OVERHEAD (SPOOL_RECORD_HEADER + 4)  // plus crc32
+#define SPOOL_SEGMENT_MAGIC 0x31535053UL  // "SPS1"
+// "SPL4": generation, head, tail, acked offset, next seq, crc32 over the rest
+#define SPOOL_META_MAGIC    0x53504C34UL
+#define SPOOL_META_WORDS    7
+// Single meta file of earlier firmware, picked up when no slot is valid.
+#define SPOOL_META_MAGIC_V3 0x53504C33UL  // "SPL3": head, tail, acked offset, next seq
+// Text-line spools of earlier firmware; begin() converts their segments.
+#define SPOOL_META_MAGIC_V2 0x53504C32UL  // "SPL2": head, tail, acked offset
+#define SPOOL_META_MAGIC_V1 0x53504C31UL  // "SPL1": head, tail
+
+struct SpoolStats {
+  uint32_t records;      // records accepted
+  uint32_t commits;      // buffer writes to flash
+  uint32_t flashOps;     // open, write, seek, flush, close and remove calls
+  uint32_t segments;     // segments started
+  uint32_t evicted;      // segments dropped unsent because the ring was full
+  uint32_t replayed;     // records read back, counting repeats after a rewind
+  uint32_t acked;        // records acknowledged as delivered
+  uint32_t torn;         // torn tails cut off by begin()
+  uint32_t crcErrors;    // bad segment headers or records; the rest of that segment is skipped
+  uint32_t discarded;    // text lines that could not be read when converting an old spool
+  uint32_t imported;     // records carried over from text spools
+  uint32_t metaRebuilt;  // boots with no valid meta slot that found segments by a directory scan
+  uint32_t orphaned;     // segment files outside the ring, removed by begin()
+  uint64_t recordBytes;  // record bytes accepted, before framing
+  uint64_t flashBytes;   // estimated bytes programmed, see SPOOL_FLASH_PAGE
+};
+
+// Where a record ends: segment number and byte offset within it.
+struct SpoolPos {
+  uint32_t segment;
+  uint32_t offset;
+};
+
+template <class Fs, class File, size_t BufferSize>
+class Spool {
+  static_assert(BufferSize > SPOOL_RECORD_OVERHEAD, "spool buffer too small");
+
+ public:
+  Spool(Fs &fs, const char *prefix, size_t segmentBytes = SPOOL_SEGMENT_BYTES)
+      : fs_(fs), prefix_(prefix), segmentBytes_(segmentBytes) {}
+
+  // Picks up head, tail, the acked offset and the next seq from the newest
+  // valid meta slot (or failing that, the segment files on flash), removes
+  // segment files outside that range, recovers the tail segment and sizes
+  // the ring to capacityBytes (at least SPOOL_MIN_SEGMENTS segments).
+  // Returns the bytes the existing segments hold. A text-line ring
+  // (SPL1/SPL2 meta) is converted first, see convertTextRing().
+  size_t begin(size_t capacityBytes) {
+    uint32_t meta[SPOOL_META_WORDS];
+    char path[SPOOL_PATH_MAX];
+    bool found = false;
+    for (int slot = 0; slot < 2; slot++) {
+      uint32_t m[SPOOL_META_WORDS];
+      if (readMeta(slot, m) != (int)sizeof(m) || m[0] != SPOOL_META_MAGIC || m[3] - m[2] >= 0x10000 ||
+          crc32((const uint8_t *)m, sizeof(m) - 4) != m[SPOOL_META_WORDS - 1]) {
+        continue;
+      }
+      if (found && (int32_t)(m[1] - meta[1]) <= 0) continue;
+      memcpy(meta, m, sizeof(m));
+      found = true;
+    }
+    uint32_t lo = 0, hi = 0;
+    bool onFlash = scanSegments(lo, hi);
+    bool dirty = false;
+    int n = found ? 0 : readMeta(0, meta);
+    if (found) {
+      metaGen_ = meta[1];
+      head_ = meta[2];
+      tail_ = meta[3];
+      ackOff_ = meta[4];
+      seq_ = meta[5];
+    } else if (n >= (int)(3 * sizeof(uint32_t)) && meta[2] - meta[1] < 0x10000) {
+      if (n == (int)(5 * sizeof(uint32_t)) && meta[0] == SPOOL_META_MAGIC_V3) {
+        head_ = meta[1];
+        tail_ = meta[2];
+        ackOff_ = meta[3];
+        seq_ = meta[4];
+        dirty = true;
+      } else if (meta[0] == SPOOL_META_MAGIC_V2 || meta[0] == SPOOL_META_MAGIC_V1) {
+        bool acked = meta[0] == SPOOL_META_MAGIC_V2 && n >= (int)(4 * sizeof(uint32_t));
+        uint32_t above = onFlash && (int32_t)(hi - meta[2]) > 0 ? hi : meta[2];
+        convertTextRing(meta[1], meta[2], acked ? meta[3] : 0, above);
+      }
+    } else if (onFlash) {
+      head_ = lo;
+      tail_ = hi;
+      stats_.metaRebuilt++;
+      dirty = true;
+    }
+    // Segments right after the tail are newer than the meta slot that was
+    // read (the newest one was lost); anything else outside the ring is
+    // left over from a drop or eviction the meta never recorded.
+    while (onFlash && tail_ != hi) {
+      segmentPath(tail_ + 1, path);
+      stats_.flashOps++;
+      if (!fs_.exists(path)) break;
+      tail_++;
+      dirty = true;
+    }
+    if (onFlash && !holdMeta_ && hi - lo < 0x10000) {
+      for (uint32_t s = lo; s != hi + 1; s++) {
+        if (s - head_ <= tail_ - head_) continue;
+        segmentPath(s, path);
+        stats_.flashOps++;
+        if (fs_.remove(path)) stats_.orphaned++;
+      }
+    }
+    size_t bytes = 0;
+    uint32_t tail = tail_;
+    for (uint32_t s = head_; s != tail + 1; s++) {
+      segmentPath(s, path);
+      stats_.flashOps++;
+      if (!fs_.exists(path)) continue;
+      File seg = fs_.open(path, "r");
+      if (!seg) continue;
+      bytes += seg.size();
+      if (s == tail) {
+        if (!recoverTail(seg)) dirty = true;
+      } else {
+        uint8_t hdr[SPOOL_SEGMENT_HEADER];
+        if (seg.read(hdr, sizeof(hdr)) != (int)sizeof(hdr) || !segmentHeaderValid(hdr, s)) stats_.crcErrors++;
+      }
+      seg.close();
+    }
+    readSeg_ = head_;
+    readOff_ = ackOff_;
+    if (dirty) writeMeta();
+    setCapacity(capacityBytes);
+    return bytes;
+  }
+
+  // Appends the records of a text spool file, one per line from byte
+  // offset from on, then removes the file. Empty lines are skipped; lines
+  // that are too long, not valid hex or cut short by a power cut (no
+  // final newline) count as discarded. Returns the records imported.
+  size_t importText(const char *path, uint32_t from = 0) {
+    stats_.flashOps++;
+    if (!fs_.exists(path)) return 0;
+    uint8_t *rec = (uint8_t *)malloc(BufferSize);
+    if (!rec) return 0;  // tried again next boot
+    size_t imported = importLines(path, from, rec);
+    free(rec);
+    fs_.remove(path);
+    stats_.flashOps++;
+    return imported;
+  }
+
+  // Each segment file also costs about a page of filesystem metadata.
+  void setCapacity(size_t capacityBytes) {
+    maxSegments_ = capacityBytes / (segmentBytes_ + SPOOL_FLASH_PAGE);
+    if (maxSegments_ < SPOOL_MIN_SEGMENTS) maxSegments_ = SPOOL_MIN_SEGMENTS;
+  }
+
+  void setCommit(size_t bytes, uint32_t ms) {
+    commitBytes_ = bytes < BufferSize ? bytes : BufferSize;
+    commitMs_ = ms;
+  }
+
+  // Frames one record into the buffer; commits first if it does not fit,
+  // and afterwards once the size threshold is reached.
+  bool append(const uint8_t *data, size_t len, uint32_t nowMs) {
+    size_t framed = len + SPOOL_RECORD_OVERHEAD;
+    if (!len || len > 0xFFFF || framed > BufferSize) return false;
+    if (used_ + framed > BufferSize && !commit()) return false;
+    if (!used_) {
+      firstMs_ = nowMs;
+      bufSeq_ = seq_;
+    }
+    uint8_t *p = buf_ + used_;
+    put16(p, (uint16_t)len);
+    put32(p + 2, seq_++);
+    memcpy(p + SPOOL_RECORD_HEADER, data, len);
+    put32(p + SPOOL_RECORD_HEADER + len, crc32(p, SPOOL_RECORD_HEADER + len));
+    used_ += framed;
+    stats_.records++;
+    stats_.recordBytes += len;
+    return used_ < commitBytes_ || commit();
+  }
+
+  // Time threshold; call periodically.
+  bool service(uint32_t nowMs) {
+    if (!used_ || nowMs - firstMs_ < commitMs_) return true;
+    return commit();
+  }
+
+  bool commit() {
+    if (!used_) return true;
+    // Reopen first: a tail closed since the last commit still counts.
+    if (!open()) return false;
+    if (size_ > SPOOL_SEGMENT_HEADER && size_ + used_ > segmentBytes_) {
+      startSegment();
+      if (!open()) return false;
+    }
+    size_t n = file_.write(buf_, used_);
+    file_.flush();
+    stats_.flashOps += 2;
+    stats_.commits++;
+    size_t pageOff = size_ % SPOOL_FLASH_PAGE;
+    stats_.flashBytes += ((pageOff + n + SPOOL_FLASH_PAGE - 1) / SPOOL_FLASH_PAGE + 1) * SPOOL_FLASH_PAGE;
+    size_ += n;
+    if (n) drained_ = false;
+    bool ok = n == used_;
+    used_ = 0;
+    return ok;
+  }
+
+  // Commits and releases the tail handle, e.g. before the spool is read
+  // back; the next append reopens it.
+  void close() {
+    commit();
+    if (!isOpen_) return;
+    file_.close();
+    stats_.flashOps++;
+    isOpen_ = false;
+  }
+
+  // Reads the next committed record into out and sets end to the position
+  // just past it, for ack(). Call close() first; returns false once
+  // everything committed has been read. If by then everything read has
+  // also been acked, the segments are removed and the ring restarts empty
+  // at the next segment number.
+  bool next(uint8_t *out, size_t cap, size_t &len, SpoolPos &end) {
+    if (drained_) return false;  // cleared by the next commit
+    for (;;) {
+      if (!reading_) openRead();
+      if (read_ && readRecord(out, cap, len)) {
+        readOff_ = (uint32_t)(rbufOff_ + rpos_);
+        end.segment = readSeg_;
+        end.offset = readOff_;
+        last_ = end;
+        unacked_ = true;
+        stats_.replayed++;
+        return true;
+      }
+      if (read_) read_.close();
+      reading_ = false;
+      if (readSeg_ != tail_) {
+        readSeg_++;
+        readOff_ = 0;
+        continue;
+      }
+      if (!unacked_) {
+        while (head_ != tail_) dropHead();
+        dropHead();
+        tail_ = head_;
+        size_ = 0;
+        readSeg_ = head_;
+        readOff_ = 0;
+        drained_ = true;
+        writeMeta();
+      }
+      return false;
+    }
+  }
+
+  // Marks everything up to end (from next()) as delivered. Segments before
+  // it are removed; the offset reaches the meta file with the next
+  // checkpoint. Acks for records whose segment was evicted meanwhile are
+  // ignored.
+  void ack(const SpoolPos &end) {
+    if ((int32_t)(end.segment - head_) < 0) return;
+    bool dropped = end.segment != head_;
+    while (head_ != end.segment) dropHead();
+    ackOff_ = end.offset;
+    stats_.acked++;
+    if (end.segment == last_.segment && end.offset == last_.offset) unacked_ = false;
+    if (dropped || ++sinceCheckpoint_ >= SPOOL_CHECKPOINT_RECORDS) writeMeta();
+  }
+
+  // Persists the acked offset now, e.g. when a flush stops.
+  void checkpoint() {
+    if (sinceCheckpoint_) writeMeta();
+  }
+
+  // Goes back to the last ack, e.g. after a flush was cut short; records
+  // read but not acked since are returned again.
+  void rewind() {
+    if (reading_ && read_) read_.close();
+    reading_ = false;
+    readSeg_ = head_;
+    readOff_ = ackOff_;
+    unacked_ = false;
+  }
+
+  uint32_t segmentCount() const { return tail_ - head_ + 1; }
+  uint32_t maxSegments() const { return maxSegments_; }
+  size_t segmentBytes() const { return segmentBytes_; }
+  size_t pending() const { return used_; }
+  uint32_t ackedOffset() const { return ackOff_; }
+  // seq of the next append.
+  uint32_t nextSeq() const { return seq_; }
+  const SpoolStats &stats() const { return stats_; }
+
+ private:
+  // Appends the lines of a text spool file from byte offset from on, with
+  // rec (BufferSize bytes) as scratch, and commits them. The file stays.
+  size_t importLines(const char *path, uint32_t from, uint8_t *rec) {
+    stats_.flashOps++;
+    if (!fs_.exists(path)) return 0;
+    File f = fs_.open(path, "r");
+    stats_.flashOps++;
+    size_t imported = 0;
+    if (f) {
+      if (from) f.seek(from);
+      size_t cap = BufferSize - SPOOL_RECORD_OVERHEAD, len = 0;
+      bool binary = false, bad = false, any = false;
+      int hi = -1, got;
+      uint8_t chunk[SPOOL_READ_CHUNK];
+      while ((got = f.read(chunk, sizeof(chunk))) > 0) {
+        for (int i = 0; i < got; i++) {
+          uint8_t c = chunk[i];
+          if (c == '\n' || c == '\r') {
+            if (any && (bad || !len || hi >= 0)) stats_.discarded++;
+            else if (any && append(rec, len, 0)) imported++;
+            len = 0;
+            binary = bad = any = false;
+            hi = -1;
+            continue;
+          }
+          if (!any) {
+            any = true;
+            binary = c != '{';
+          }
+          if (bad) continue;
+          if (!binary) {
+            if (len < cap) rec[len++] = c;
+            else bad = true;
+            continue;
+          }
+          int v = nibble(c);
+          if (v < 0 || (hi < 0 && len >= cap)) {
+            bad = true;
+          } else if (hi < 0) {
+            hi = v;
+          } else {
+            rec[len++] = (uint8_t)(hi << 4 | v);
+            hi = -1;
+          }
+        }
+      }
+      if (any) stats_.discarded++;  // torn last line
+      commit();
+    }
+    if (f) f.close();
+    stats_.flashOps++;
+    stats_.imported += imported;
+    return imported;
+  }
+
+  // Moves the records of a text-line ring (segments first..last, the
+  // first one read from ackOff) into binary segments numbered after above,
+  // the highest segment file on flash, so what an earlier attempt left
+  // there is never appended to. The text segments are removed only once
+  // both meta slots hold the new ring; a power cut before that repeats the
+  // conversion, and begin() removes the leftovers of this attempt.
+  void convertTextRing(uint32_t first, uint32_t last, uint32_t ackOff, uint32_t above) {
+    head_ = tail_ = above + 1;
+    holdMeta_ = true;
+    uint8_t *rec = (uint8_t *)malloc(BufferSize);
+    if (!rec) return;  // meta held for this boot; tried again next boot
+    maxSegments_ = 0xFFFF;  // nothing is evicted before setCapacity()
+    char path[SPOOL_PATH_MAX];
+    for (uint32_t s = first; s != last + 1; s++) {
+      segmentPath(s, path);
+      importLines(path, s == first ? ackOff : 0, rec);
+    }
+    free(rec);
+    close();
+    holdMeta_ = false;
+    // Both slots, so the text meta cannot come back if one is torn later.
+    writeMeta();
+    writeMeta();
+    for (uint32_t s = first; s != last + 1; s++) {
+      segmentPath(s, path);
+      fs_.remove(path);
+      stats_.flashOps++;
+    }
+  }
+
+  void metaPath(int slot, char *out) const { snprintf(out, SPOOL_PATH_MAX, slot ? "%s.meta1" : "%s.meta", prefix_); }
+
+  // Bytes read from a meta slot, 0 if it does not exist.
+  int readMeta(int slot, uint32_t *meta) {
+    char path[SPOOL_PATH_MAX];
+    metaPath(slot, path);
+    stats_.flashOps++;
+    if (!fs_.exists(path)) return 0;
+    File f = fs_.open(path, "r");
+    int n = f ? f.read((uint8_t *)meta, SPOOL_META_WORDS * sizeof(uint32_t)) : 0;
+    if (f) f.close();
+    return n;
+  }
+
+  // Lowest and highest n of the <prefix>.<n> files in the prefix's
+  // directory; false if there are none.
+  bool scanSegments(uint32_t &lo, uint32_t &hi) {
+    char dirPath[SPOOL_PATH_MAX];
+    const char *base = strrchr(prefix_, '/');
+    int dirLen = base ? (int)(base - prefix_) : 0;
+    snprintf(dirPath, sizeof(dirPath), "%.*s", dirLen, prefix_);
+    if (!dirLen) strcpy(dirPath, "/");
+    base = base ? base + 1 : prefix_;
+    size_t baseLen = strlen(base);
+    File dir = fs_.open(dirPath, "r");
+    stats_.flashOps++;
+    if (!dir) return false;
+    bool found = false;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+      const char *name = f.name();
+      const char *slash = strrchr(name, '/');  // a full path on older cores
+      if (slash) name = slash + 1;
+      char *end;
+      if (!strncmp(name, base, baseLen) && name[baseLen] == '.' && name[baseLen + 1] >= '0' &&
+          name[baseLen + 1] <= '9') {
+        unsigned long n = strtoul(name + baseLen + 1, &end, 10);
+        if (!*end) {
+          if (!found || n < lo) lo = (uint32_t)n;
+          if (!found || n > hi) hi = (uint32_t)n;
+          found = true;
+        }
+      }
+      f.close();
+      stats_.flashOps++;
+    }
+    dir.close();
+    return found;
+  }
+  void segmentPath(uint32_t n, char *out) const { snprintf(out, SPOOL_PATH_MAX, "%s.%lu", prefix_, (unsigned long)n); }
+
+  static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+  }
+  static void put32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+  }
+  static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+  static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+  }
+
+  static int nibble(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+
+  static bool segmentHeaderValid(const uint8_t *hdr, uint32_t segment) {
+    return get32(hdr) == SPOOL_SEGMENT_MAGIC && get32(hdr + 4) == segment && get32(hdr + 12) == crc32(hdr, 12);
+  }
+
+  // Walks the tail by record length and checks the CRC of the last record
+  // only; appends after a power cut go through here, so earlier records
+  // were complete. Picks up the next seq. A torn tail (short header,
+  // partial or corrupt last record) returns false and moves the tail to a
+  // new segment; the reader stops at the last good record of this one.
+  bool recoverTail(File &f) {
+    size_t size = f.size();
+    if (!size) return true;
+    uint8_t hdr[SPOOL_SEGMENT_HEADER], rh[SPOOL_RECORD_HEADER];
+    bool ok = size >= SPOOL_SEGMENT_HEADER && f.read(hdr, sizeof(hdr)) == (int)sizeof(hdr) &&
+              segmentHeaderValid(hdr, tail_);
+    uint32_t seq = ok ? get32(hdr + 8) : 0;
+    size_t off = SPOOL_SEGMENT_HEADER, last = 0;
+    while (ok && off + SPOOL_RECORD_HEADER <= size) {
+      f.seek(off);
+      stats_.flashOps++;
+      if (f.read(rh, sizeof(rh)) != (int)sizeof(rh)) break;
+      size_t framed = get16(rh) + SPOOL_RECORD_OVERHEAD;
+      if (framed == SPOOL_RECORD_OVERHEAD || framed > BufferSize || off + framed > size) break;
+      seq = get32(rh + 2);
+      last = off;
+      off += framed;
+    }
+    if (last) {
+      // The write buffer is empty at boot; borrow it for the last record.
+      size_t framed = off - last, len = framed - SPOOL_RECORD_OVERHEAD;
+      f.seek(last);
+      stats_.flashOps++;
+      if (f.read(buf_, framed) == (int)framed &&
+          get32(buf_ + SPOOL_RECORD_HEADER + len) == crc32(buf_, SPOOL_RECORD_HEADER + len)) {
+        seq++;
+      } else {
+        off = last;
+      }
+    }
+    if (ok && (int32_t)(seq - seq_) > 0) seq_ = seq;
+    if (ok && off == size) return true;
+    stats_.torn++;
+    tail_++;
+    size_ = 0;
+    return false;
+  }
+
+  void writeMeta() {
+    if (holdMeta_) return;
+    char path[SPOOL_PATH_MAX];
+    uint32_t meta[SPOOL_META_WORDS] = {SPOOL_META_MAGIC, ++metaGen_, head_, tail_, ackOff_, seq_, 0};
+    meta[SPOOL_META_WORDS - 1] = crc32((const uint8_t *)meta, sizeof(meta) - 4);
+    // The other slot keeps the previous generation until this one is whole.
+    metaPath(metaGen_ & 1, path);
+    File f = fs_.open(path, "w");
+    if (f) {
+      f.write((const uint8_t *)meta, sizeof(meta));
+      f.close();
+    }
+    stats_.flashOps += 3;
+    sinceCheckpoint_ = 0;
+  }
+
+  void dropHead() {
+    char path[SPOOL_PATH_MAX];
+    segmentPath(head_, path);
+    if (head_ == tail_ && isOpen_) {
+      file_.close();
+      isOpen_ = false;
+    }
+    fs_.remove(path);
+    stats_.flashOps++;
+    head_++;
+    ackOff_ = 0;
+    if ((int32_t)(readSeg_ - head_) < 0) {
+      // Evicted under the reader.
+      if (reading_ && read_) read_.close();
+      reading_ = false;
+      readSeg_ = head_;
+      readOff_ = 0;
+    }
+  }
+
+  // Closes the full tail and starts the next segment, evicting the head
+  // segment if the ring is at capacity.
+  void startSegment() {
+    if (isOpen_) {
+      file_.close();
+      stats_.flashOps++;
+      isOpen_ = false;
+    }
+    tail_++;
+    size_ = 0;
+    stats_.segments++;
+    while (segmentCount() > maxSegments_) {
+      dropHead();
+      stats_.evicted++;
+    }
+    writeMeta();
+  }
+
+  // Opens the tail for appending; a new segment gets its header first.
+  bool open() {
+    if (isOpen_) return true;
+    char path[SPOOL_PATH_MAX];
+    segmentPath(tail_, path);
+    file_ = fs_.open(path, "a");
+    stats_.flashOps++;
+    if (!file_) return false;
+    size_ = file_.size();
+    if (!size_) {
+      uint8_t hdr[SPOOL_SEGMENT_HEADER];
+      put32(hdr, SPOOL_SEGMENT_MAGIC);
+      put32(hdr + 4, tail_);
+      put32(hdr + 8, bufSeq_);
+      put32(hdr + 12, crc32(hdr, 12));
+      size_ = file_.write(hdr, sizeof(hdr));
+      stats_.flashOps++;
+    }
+    isOpen_ = true;
+    return true;
+  }
+
+  // Opens readSeg_ at readOff_, after checking its header; a segment with
+  // a bad header is skipped.
+  void openRead() {
+    char path[SPOOL_PATH_MAX];
+    segmentPath(readSeg_, path);
+    read_ = fs_.exists(path) ? fs_.open(path, "r") : File();
+    stats_.flashOps++;
+    rbufOff_ = rpos_ = rlen_ = 0;
+    reading_ = true;
+    if (!read_) return;
+    uint8_t hdr[SPOOL_SEGMENT_HEADER];
+    if (!readBytes(hdr, sizeof(hdr))) {
+      read_.close();  // empty, or a header torn at boot
+      return;
+    }
+    if (!segmentHeaderValid(hdr, readSeg_)) {
+      stats_.crcErrors++;
+      read_.close();
+      return;
+    }
+    if (readOff_ > SPOOL_SEGMENT_HEADER) {
+      read_.seek(readOff_);
+      stats_.flashOps++;
+      rbufOff_ = readOff_;
+      rpos_ = rlen_ = 0;
+    }
+  }
+
+  // n bytes from the read handle, through the chunk buffer.
+  bool readBytes(uint8_t *dst, size_t n) {
+    while (n) {
+      if (rpos_ == rlen_) {
+        int got = read_.read(rbuf_, sizeof(rbuf_));
+        rbufOff_ += rlen_;
+        rpos_ = 0;
+        rlen_ = got > 0 ? (size_t)got : 0;
+        if (!rlen_) return false;
+      }
+      size_t take = rlen_ - rpos_ < n ? rlen_ - rpos_ : n;
+      memcpy(dst, rbuf_ + rpos_, take);
+      rpos_ += take;
+      dst += take;
+      n -= take;
+    }
+    return true;
+  }
+
+  // One record from the read handle. False at the end of the segment,
+  // whether clean, torn or corrupt: nothing after a bad record can be
+  // framed, so the rest of the segment is skipped.
+  bool readRecord(uint8_t *out, size_t cap, size_t &len) {
+    uint8_t hdr[SPOOL_RECORD_HEADER], crc[4];
+    if (!readBytes(hdr, sizeof(hdr))) return false;
+    len = get16(hdr);
+    if (!len || len > cap) {
+      stats_.crcErrors++;
+      return false;
+    }
+    if (!readBytes(out, len) || !readBytes(crc, sizeof(crc))) return false;
+    if (get32(crc) != crc32(out, len, crc32(hdr, sizeof(hdr)))) {
+      stats_.crcErrors++;
+      return false;
+    }
+    return true;
+  }
+
+  Fs &fs_;
+  const char *prefix_;
+  size_t segmentBytes_;
+  uint32_t maxSegments_ = SPOOL_MIN_SEGMENTS;
+  uint32_t head_ = 0;
+  uint32_t tail_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t bufSeq_ = 0;
+  size_t commitBytes_ = SPOOL_COMMIT_BYTES < BufferSize ? SPOOL_COMMIT_BYTES : BufferSize;
+  uint32_t commitMs_ = SPOOL_COMMIT_MS;
+  File file_;
+  bool isOpen_ = false;
+  bool holdMeta_ = false;  // converting a text-line ring in begin()
+  uint32_t metaGen_ = 0;
+  size_t size_ = 0;
+  uint32_t ackOff_ = 0;
+  uint32_t sinceCheckpoint_ = 0;
+  uint32_t readSeg_ = 0;
+  uint32_t readOff_ = 0;
+  SpoolPos last_ = {};
+  bool unacked_ = false;
+  bool drained_ = false;
+  File read_;
+  bool reading_ = false;
+  size_t rbufOff_ = 0;
+  uint8_t rbuf_[SPOOL_READ_CHUNK];
+  size_t rpos_ = 0;
+  size_t rlen_ = 0;
+  size_t used_ = 0;
+  uint32_t firstMs_ = 0;
+  SpoolStats stats_ = {};
+  uint8_t buf_[BufferSize];
+};
@@ -2,6 +2,10 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <RadioLib.h>
+#include <esp_timer.h>
+#include "cobs_frame.h"
+#include "fingerprint.h"
+#include "rf_record.h"
 
 // ================= PIN MAP (Heltec WiFi LoRa 32 V3 / V3.2) =================
 #define LORA_CS    8
@@ -18,50 +22,129 @@
 #define SF         8
 #define CR_DENOM   8        // 4/8
 
+// ================= FINGERPRINT =================
+// Hash family (Fnv1a64, XxHash64, WyHash, SipHash24) and covered range
+// (FP_PREFIX20, FP_FULL, FP_NO_PATH) of the "fp" field, see
+// lib/fingerprint. The defaults reproduce the original fingerprint.
+#ifndef SNIFFER_FP_HASH
+#define SNIFFER_FP_HASH Fnv1a64
+#endif
+#ifndef SNIFFER_FP_RANGE
+#define SNIFFER_FP_RANGE FP_PREFIX20
+#endif
+typedef Fingerprint<SNIFFER_FP_HASH> FrameFingerprint;
+
+// ================= RX TASK =================
+// Woken straight from DIO1 by task notification; only drains the FIFO and
+// re-arms, so serial output can never delay the next receive.
+#define RX_TASK_PRIORITY (configMAX_PRIORITIES - 5)
+#define RX_TASK_STACK    4096
+#define RX_QUEUE_DEPTH   8
+
+// ================= SERIAL OUTPUT =================
+// Each record is assembled in one buffer and handed to the UART driver in a
+// single write; the TX buffer holds a few full records so the write returns
+// without waiting for the line to drain.
+//
+// OUTPUT_JSON prints the "rf" line at SNIFFER_JSON_BAUD. OUTPUT_BINARY sends
+// the same record as a CRC-32 checked COBS frame (lib/rf_record,
+// lib/cobs_frame) at SNIFFER_BINARY_BAUD, plus a stats frame every
+// SNIFFER_STATS_INTERVAL_MS; tools/rf_capture turns it back into rf JSON.
+// Serial commands: "mode json", "mode bin", "baud <n>" (binary baud).
+enum OutputMode : uint8_t { OUTPUT_JSON, OUTPUT_BINARY };
+
+#ifndef SNIFFER_OUTPUT
+#define SNIFFER_OUTPUT OUTPUT_JSON
+#endif
+#ifndef SNIFFER_JSON_BAUD
+#define SNIFFER_JSON_BAUD 115200
+#endif
+#ifndef SNIFFER_BINARY_BAUD
+#define SNIFFER_BINARY_BAUD 921600
+#endif
+#ifndef SNIFFER_STATS_INTERVAL_MS
+#define SNIFFER_STATS_INTERVAL_MS 5000
+#endif
+#define SERIAL_TX_BUFFER 2048
+#define RECORD_LINE_MAX  1024
+#define COMMAND_POLL_MS  20
+// Adds "rearm_us" (DIO1 interrupt to radio re-armed) to every record.
+#ifndef SNIFFER_TIMING
+#define SNIFFER_TIMING 0
+#endif
+
+OutputMode outputMode = SNIFFER_OUTPUT;
+uint32_t binaryBaud = SNIFFER_BINARY_BAUD;
+uint32_t recordsOut = 0;
+uint32_t txBytes = 0;
+volatile uint32_t queueDrops = 0;
+
 // ================= RADIO INSTANCE =================
 SX1262 radio = new Module(LORA_CS, LORA_DIO1, LORA_RST, LORA_BUSY);
-volatile bool rxFlag = false;
+TaskHandle_t rxTaskHandle = nullptr;
+QueueHandle_t rxQueue = nullptr;
+volatile int64_t irqUs = 0;
+
+struct RxFrame {
+  uint8_t data[255];
+  int len;
+  int reportedLen;
+  float rssi;
+  float snr;
+  int state;
+  int32_t rearmUs;
+};
 
 // ================= ISR =================
 void IRAM_ATTR onDio1() {
-  rxFlag = true;
+  irqUs = esp_timer_get_time();
+  BaseType_t woken = pdFALSE;
+  if (rxTaskHandle) vTaskNotifyGiveFromISR(rxTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
 }
 
 // ================= UTILITIES =================
-static inline void printHex(const uint8_t* data, size_t len) {
-  for (size_t i = 0; i < len; i++) {
-    if (data[i] < 0x10) Serial.print('0');
-    Serial.print(data[i], HEX);
-  }
-}
+static inline void captureFrame(RxFrame &frame) {
+  // Capture what the radio *thinks* length is (can be 0 depending on timing/modem state)
+  frame.reportedLen = radio.getPacketLength();
 
-// Stable fingerprint (FNV-1a over first N bytes)
-static inline uint64_t fnv1a64(const uint8_t* data, size_t len) {
-  uint64_t h = 0xcbf29ce484222325ULL;
-  for (size_t i = 0; i < len; i++) {
-    h ^= data[i];
-    h *= 0x100000001b3ULL;
-  }
-  return h;
+  // Safe clamp for read length
+  int len = frame.reportedLen;
+  if (len <= 0) len = (int)sizeof(frame.data);          // fallback: attempt read (we still report reportedLen)
+  if (len > (int)sizeof(frame.data)) len = sizeof(frame.data); // clamp
+  frame.len = len;
+
+  // Read signal stats around RX completion (some libs are more stable here)
+  frame.rssi = radio.getRSSI();
+  frame.snr  = radio.getSNR();
+
+  // Read data
+  frame.state = radio.readData(frame.data, len);
+
+  // Resume RX immediately
+  radio.startReceive();
+  frame.rearmUs = (int32_t)(esp_timer_get_time() - irqUs);
 }
 
-static inline bool takeRxFlag() {
-  bool got;
-  noInterrupts();
-  got = rxFlag;
-  rxFlag = false;
-  interrupts();
-  return got;
+static void rxTask(void *) {
+  RxFrame frame;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    captureFrame(frame);
+    if (xQueueSend(rxQueue, &frame, 0) != pdTRUE) queueDrops++;
+  }
 }
 
 // ================= SETUP =================
 void setup() {
-  Serial.begin(115200);
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER);
+  Serial.begin(outputMode == OUTPUT_BINARY ? binaryBaud : SNIFFER_JSON_BAUD);
   delay(1200);
 
   Serial.println();
   Serial.println("=== Heltec V3.2 MeshCORE Deep RF Sniffer ===");
-  Serial.println("Mode: CRC ON | Syncword 0x12 | Fingerprint enabled");
+  Serial.printf("Mode: CRC ON | Syncword 0x12 | Fingerprint %s/%s\r\n",
+                SNIFFER_FP_HASH::name(), FP_RANGE_NAMES[SNIFFER_FP_RANGE]);
 
   SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_CS);
 
@@ -80,6 +163,8 @@ void setup() {
     while (true) delay(1000);
   }
 
+  rxQueue = xQueueCreate(RX_QUEUE_DEPTH, sizeof(RxFrame));
+  xTaskCreate(rxTask, "rx", RX_TASK_STACK, nullptr, RX_TASK_PRIORITY, &rxTaskHandle);
   radio.setDio1Action(onDio1);
   radio.startReceive();
 
@@ -87,80 +172,100 @@ void setup() {
   Serial.println("Listening...");
 }
 
-// ================= LOOP =================
-void loop() {
-  if (!takeRxFlag()) {
-    delay(2);
-    return;
-  }
-
-  uint8_t buf[255];
-
-  // Capture what the radio *thinks* length is (can be 0 depending on timing/modem state)
-  int reportedLen = radio.getPacketLength();
-
-  // Safe clamp for read length
-  int len = reportedLen;
-  if (len <= 0) len = (int)sizeof(buf);          // fallback: attempt read (we still report reportedLen)
-  if (len > (int)sizeof(buf)) len = sizeof(buf); // clamp
-
-  // Read signal stats around RX completion (some libs are more stable here)
-  float rssi = radio.getRSSI();
-  float snr  = radio.getSNR();
-
-  // Read data
-  int state = radio.readData(buf, len);
-
-  // Frame type (first byte) if present
-  int ptype = (len > 0) ? buf[0] : -1;
-
-  // Fingerprint first 20 bytes (or less)
-  int fpLen = min(len, 20);
-  uint64_t fp = fnv1a64(buf, fpLen);
-
-  // ================= JSON OUTPUT =================
-  Serial.print("{\"type\":\"rf\"");
-
-  // Timestamp (ms since boot)
-  Serial.print(",\"ts\":");
-  Serial.print(millis());
-
-  // Packet type byte (useful for MeshCORE 0x11 adverts / 0x15 grouptext, etc.)
-  Serial.print(",\"ptype\":");
-  Serial.print(ptype);
-
-  // Fingerprint
-  Serial.print(",\"fp\":\"");
-  Serial.printf("%016llX", fp);
-  Serial.print("\"");
-
-  // RadioLib state code + boolean CRC result
-  Serial.print(",\"state\":");
-  Serial.print(state);
-
-  Serial.print(",\"crc\":");
-  Serial.print(state == RADIOLIB_ERR_NONE ? "true" : "false");
+// ================= OUTPUT =================
+static inline uint32_t outputBaud() {
+  return outputMode == OUTPUT_BINARY ? binaryBaud : SNIFFER_JSON_BAUD;
+}
 
-  // RF stats
-  Serial.print(",\"rssi\":");
-  Serial.print(rssi, 1);
+static inline void writeOut(const uint8_t *data, size_t len) {
+  Serial.write(data, len);
+  txBytes += len;
+}
 
-  Serial.print(",\"snr\":");
-  Serial.print(snr, 2);
+// Sends a record (or stats) as a binary frame.
+static inline void writeFrame(const uint8_t *rec, size_t len) {
+  static uint8_t frame[COBS_FRAME_MAX(RF_RECORD_MAX)];
+  size_t n = cobsFrameEncode(rec, len, frame, sizeof(frame));
+  if (n) writeOut(frame, n);
+}
 
-  // Lengths (reported vs used)
-  Serial.print(",\"reported_len\":");
-  Serial.print(reportedLen);
+static inline void serviceStats() {
+  static unsigned long lastMs = 0;
+  if (outputMode != OUTPUT_BINARY || millis() - lastMs < SNIFFER_STATS_INTERVAL_MS) return;
+  lastMs = millis();
+  RfStats st = {(uint32_t)millis(), recordsOut, txBytes, queueDrops, binaryBaud};
+  uint8_t rec[32];
+  size_t n = rfStatsEncode(st, rec, sizeof(rec));
+  if (n) writeFrame(rec, n);
+}
 
-  Serial.print(",\"len\":");
-  Serial.print(len);
+// Text replies go out before a switch to binary and after a switch back,
+// so they are always readable at the baud rate the host is on.
+static inline void setOutput(OutputMode mode, uint32_t baud) {
+  if (mode == OUTPUT_BINARY) {
+    Serial.printf("[sniffer] output bin baud=%u\r\n", (unsigned)baud);
+  }
+  Serial.flush();
+  outputMode = mode;
+  binaryBaud = baud;
+  Serial.updateBaudRate(outputBaud());
+  if (mode == OUTPUT_JSON) {
+    Serial.printf("[sniffer] output json baud=%u\r\n", (unsigned)SNIFFER_JSON_BAUD);
+  }
+}
 
-  // Payload hex
-  Serial.print(",\"hex\":\"");
-  printHex(buf, len);
-  Serial.println("\"}");
+static inline void handleSerialCommand() {
+  static char cmd[32];
+  static size_t cmdLen = 0;
+  while (Serial.available()) {
+    char c = (char)Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (cmdLen < sizeof(cmd) - 1) cmd[cmdLen++] = c;
+      continue;
+    }
+    cmd[cmdLen] = '\0';
+    if (!strcmp(cmd, "mode json")) {
+      setOutput(OUTPUT_JSON, binaryBaud);
+    } else if (!strcmp(cmd, "mode bin")) {
+      setOutput(OUTPUT_BINARY, binaryBaud);
+    } else if (!strncmp(cmd, "baud ", 5)) {
+      uint32_t baud = strtoul(cmd + 5, nullptr, 10);
+      if (baud >= SNIFFER_JSON_BAUD) setOutput(outputMode, baud);
+    }
+    cmdLen = 0;
+  }
+}
 
-  // Resume RX immediately
-  radio.startReceive();
-  delay(2);
+// ================= LOOP =================
+void loop() {
+  static RxFrame frame;
+  handleSerialCommand();
+  serviceStats();
+  if (xQueueReceive(rxQueue, &frame, pdMS_TO_TICKS(COMMAND_POLL_MS)) != pdTRUE) return;
+
+  const uint8_t *buf = frame.data;
+  int len = frame.len;
+
+  RfRecord rec;
+  rec.flags = SNIFFER_TIMING ? RF_FLAG_REARM : 0;
+  rec.ts = millis();
+  rec.state = frame.state;
+  rec.rssiDeci = obsRecordFixed(frame.rssi, 10.0f);
+  rec.snrCenti = obsRecordFixed(frame.snr, 100.0f);
+  rec.reportedLen = frame.reportedLen;
+  rec.len = len;
+  rec.fp = FrameFingerprint::of(buf, len, SNIFFER_FP_RANGE);
+  rec.rearmUs = frame.rearmUs;
+  rec.payload = buf;
+
+  if (outputMode == OUTPUT_BINARY) {
+    static uint8_t bin[RF_RECORD_MAX];
+    size_t n = rfRecordEncode(rec, bin, sizeof(bin));
+    if (n) writeFrame(bin, n);
+  } else {
+    static char line[RECORD_LINE_MAX];
+    size_t n = rfRecordJson(rec, line, sizeof(line));
+    if (n) writeOut((const uint8_t *)line, n);
+  }
+  recordsOut++;
 }
@@ -1,4 +1,4 @@
-// observer/main.cpp
+// src/observer_main.cpp
 #include <Arduino.h>
 #include <SPI.h>
 #include <WiFi.h>
@@ -12,6 +12,21 @@
 #include <RadioLib.h>
 #include <PubSubClient.h>
 #include <mbedtls/sha256.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include "frame_ring.h"
+#include "record_queue.h"
+#include "job_scheduler.h"
+#include "hex_codec.h"
+#include "json_writer.h"
+#include "lz_codec.h"
+#include "lz_dict_meshcore.h"
+#include "mqtt5_client.h"
+#include "obs_record.h"
+#include "ram_ring.h"
+#include "rx_capture.h"
+#include "sha256_soft.h"
+#include "spool.h"
 
 // ================= PIN MAP (Heltec WiFi LoRa 32 V3 / V3.2) =================
 #define LORA_CS    8
@@ -38,8 +53,7 @@
 #define OLED_RST   21
 Adafruit_SSD1306 display(128, 64, &Wire, OLED_RST);
 bool displayReady = false;
-bool displayDirty = true;
-unsigned long lastDisplayMs = 0;
+volatile bool displayDirty = true;
 uint8_t oledAddr = 0x3C;
 bool vextActiveLow = true;
 
@@ -59,6 +73,14 @@ bool vextActiveLow = true;
 #ifndef OBSERVER_MQTT_PORT
 #define OBSERVER_MQTT_PORT 8883
 #endif
+// 1 swaps PubSubClient (MQTT 3.1.1) for the MQTT 5 client in lib/mqtt5_client.
+#ifndef OBSERVER_MQTT5
+#define OBSERVER_MQTT5 0
+#endif
+// Sent as user property "schema" on every PUBLISH over MQTT 5.
+#ifndef OBSERVER_SCHEMA_VERSION
+#define OBSERVER_SCHEMA_VERSION "1"
+#endif
 #ifndef OBSERVER_MQTT_USER
 #define OBSERVER_MQTT_USER ""
 #endif
@@ -77,32 +99,334 @@ bool vextActiveLow = true;
 #ifndef OBSERVER_SERIAL_CONFIG
 #define OBSERVER_SERIAL_CONFIG 1
 #endif
+#ifndef OBSERVER_STATS_INTERVAL_MS
+#define OBSERVER_STATS_INTERVAL_MS 60000
+#endif
+// DIO1-to-capture wake-ups slower than this are counted as late.
+#ifndef OBSERVER_RX_LATENCY_BOUND_US
+#define OBSERVER_RX_LATENCY_BOUND_US 2000
+#endif
+#ifndef OBSERVER_NTP_SERVER
+#define OBSERVER_NTP_SERVER "pool.ntp.org"
+#endif
 
 // ================= STORAGE =================
 static const char *PREFS_NS = "observer";
-static const char *SPOOL_PATH = "/spool.ndjson";
-static const size_t MAX_SPOOL_BYTES = 256 * 1024;
+// Segment files /spool.<n> plus /spool.meta, see lib/spool.
+static const char *SPOOL_PREFIX = "/spool";
+// The single text-line spool of firmware before the segment ring; its
+// records are moved into the ring at boot.
+static const char *SPOOL_LEGACY_PATH = "/spool.ndjson";
+// Share of the free SPIFFS space (counting an existing spool as free) the
+// spool ring may fill; SPIFFS slows down badly when nearly full.
+#ifndef OBSERVER_SPOOL_FILL_PCT
+#define OBSERVER_SPOOL_FILL_PCT 70
+#endif
+// Spooled records are committed to flash once this many bytes are pending
+// or the oldest is this old; a power cut loses at most that window.
+#ifndef OBSERVER_SPOOL_COMMIT_BYTES
+#define OBSERVER_SPOOL_COMMIT_BYTES SPOOL_COMMIT_BYTES
+#endif
+#ifndef OBSERVER_SPOOL_COMMIT_MS
+#define OBSERVER_SPOOL_COMMIT_MS SPOOL_COMMIT_MS
+#endif
+#define SPOOL_BUFFER_BYTES 4096
+// First spool tier: records collect in a RAM ring (in PSRAM when the board
+// has it) and move to the flash spool only once the ring is
+// OBSERVER_SPOOL_RAM_FILL_PCT full or, with the link still down, its oldest
+// record is OBSERVER_SPOOL_RAM_AGE_MS old. Short outages never touch flash;
+// a power cut loses what the ring holds.
+#ifndef OBSERVER_SPOOL_RAM_BYTES
+#define OBSERVER_SPOOL_RAM_BYTES (24 * 1024)
+#endif
+#ifndef OBSERVER_SPOOL_PSRAM_BYTES
+#define OBSERVER_SPOOL_PSRAM_BYTES (512 * 1024)
+#endif
+#ifndef OBSERVER_SPOOL_RAM_FILL_PCT
+#define OBSERVER_SPOOL_RAM_FILL_PCT 75
+#endif
+#ifndef OBSERVER_SPOOL_RAM_AGE_MS
+#define OBSERVER_SPOOL_RAM_AGE_MS 30000
+#endif
+// Bytes moved from the RAM ring to flash per spool job run while spilling.
+#define SPOOL_RAM_SPILL_BYTES 4096
+// The spool is replayed in slices of at most this many records and bytes,
+// paced to OBSERVER_SPOOL_DRAIN_BPS record bytes per second (0 = as fast
+// as the link takes them).
+#ifndef OBSERVER_SPOOL_DRAIN_RECORDS
+#define OBSERVER_SPOOL_DRAIN_RECORDS 8
+#endif
+#ifndef OBSERVER_SPOOL_DRAIN_BYTES
+#define OBSERVER_SPOOL_DRAIN_BYTES 4096
+#endif
+#ifndef OBSERVER_SPOOL_DRAIN_BPS
+#define OBSERVER_SPOOL_DRAIN_BPS 16384
+#endif
+// With MQTT 5, spool replays go out with QoS 1 and are acked in the spool
+// only on a successful PUBACK; at most this many are unacknowledged at a
+// time, and replays still unacknowledged after SPOOL_ACK_TIMEOUT_MS are
+// sent again. A rejected one is sent again after the same delay.
+#define SPOOL_INFLIGHT 16
+#define SPOOL_ACK_TIMEOUT_MS 5000
+
+// ================= TASK LAYOUT =================
+// Radio capture, hashing and record building run on one core; WiFi/TLS,
+// MQTT, the spool, the OLED and the serial parser run on the other, so a
+// slow TLS write or flash erase never holds up a receive. The RX task must
+// outrank everything else on its core so DIO1 latency is bounded by the
+// scheduler.
+#ifndef OBSERVER_RADIO_CORE
+#define OBSERVER_RADIO_CORE 1
+#endif
+#ifndef OBSERVER_NET_CORE
+#define OBSERVER_NET_CORE 0
+#endif
+#ifndef OBSERVER_RX_TASK_PRIO
+#define OBSERVER_RX_TASK_PRIO (configMAX_PRIORITIES - 5)
+#endif
+#ifndef OBSERVER_PROC_TASK_PRIO
+#define OBSERVER_PROC_TASK_PRIO 2
+#endif
+#ifndef OBSERVER_UPLINK_TASK_PRIO
+#define OBSERVER_UPLINK_TASK_PRIO 3
+#endif
+#ifndef OBSERVER_UI_TASK_PRIO
+#define OBSERVER_UI_TASK_PRIO 1
+#endif
+#ifndef OBSERVER_CONN_TASK_PRIO
+#define OBSERVER_CONN_TASK_PRIO 2
+#endif
+#define RX_TASK_STACK     4096
+#define PROC_TASK_STACK   6144
+#define UPLINK_TASK_STACK 8192
+#define UI_TASK_STACK     4096
+#define CONN_TASK_STACK   8192
+
+struct TaskStats {
+  const char *name;
+  TaskHandle_t handle;
+  BaseType_t core;
+  UBaseType_t prio;
+  uint32_t stackBytes;
+  uint64_t busyUs;   // wall time spent working, preemption included
+  uint32_t runs;
+};
+
+enum { TASK_RX, TASK_PROC, TASK_UPLINK, TASK_UI, TASK_CONN, TASK_COUNT };
+TaskStats taskStats[TASK_COUNT] = {
+  {"rx", nullptr, OBSERVER_RADIO_CORE, OBSERVER_RX_TASK_PRIO, RX_TASK_STACK, 0, 0},
+  {"proc", nullptr, OBSERVER_RADIO_CORE, OBSERVER_PROC_TASK_PRIO, PROC_TASK_STACK, 0, 0},
+  {"uplink", nullptr, OBSERVER_NET_CORE, OBSERVER_UPLINK_TASK_PRIO, UPLINK_TASK_STACK, 0, 0},
+  {"ui", nullptr, OBSERVER_NET_CORE, OBSERVER_UI_TASK_PRIO, UI_TASK_STACK, 0, 0},
+  {"conn", nullptr, OBSERVER_NET_CORE, OBSERVER_CONN_TASK_PRIO, CONN_TASK_STACK, 0, 0},
+};
+
+static inline bool startTask(TaskFunction_t fn, TaskStats &t) {
+  return xTaskCreatePinnedToCore(fn, t.name, t.stackBytes, nullptr, t.prio, &t.handle, t.core) == pdPASS;
+}
+
+static inline void taskBusy(TaskStats &t, int64_t startUs) {
+  t.busyUs += esp_timer_get_time() - startUs;
+  t.runs++;
+}
 
 // ================= RADIO =================
+#define RX_RING_SLOTS 16
+
 SX1262 radio = new Module(LORA_CS, LORA_DIO1, LORA_RST, LORA_BUSY);
-volatile bool rxFlag = false;
+FrameRing<RX_RING_SLOTS> rxRing;
+
+// RX-done time, latched in the ISR so it is not skewed by task wake-up,
+// SPI reads or anything queued ahead of the frame.
+portMUX_TYPE irqMux = portMUX_INITIALIZER_UNLOCKED;
+int64_t irqUs = 0;
+
+// Receive-side loss accounting, written by the rx task only. Ring overflows
+// are counted by the ring itself and uplink drops in uplinkStats.
+struct RxStats {
+  uint32_t frames;        // DIO1 events serviced
+  uint32_t irqMissed;     // DIO1 fired again before the previous one was serviced
+  uint32_t zeroLen;       // getPacketLength() gave 0, read a full 255 bytes
+  uint32_t crcFail;
+  uint32_t readErrors;    // any other non-zero readData() status
+  uint32_t wakeMaxUs;     // worst DIO1-to-capture latency
+  uint32_t wakeLate;      // wake-ups over OBSERVER_RX_LATENCY_BOUND_US
+};
+RxStats rxStats = {};
 
 void IRAM_ATTR onDio1() {
-  rxFlag = true;
+  portENTER_CRITICAL_ISR(&irqMux);
+  irqUs = esp_timer_get_time();
+  portEXIT_CRITICAL_ISR(&irqMux);
+  BaseType_t woken = pdFALSE;
+  TaskHandle_t rx = taskStats[TASK_RX].handle;
+  if (rx) vTaskNotifyGiveFromISR(rx, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+// ESP-IDF's mbedtls port runs this on the SHA peripheral
+// (CONFIG_MBEDTLS_HARDWARE_SHA, on in the Arduino core). The digest stays
+// raw; it is hex-encoded, and possibly truncated, only when serialized.
+static inline void sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
+  mbedtls_sha256_ret(data, len, out, 0);
 }
 
-static inline bool takeRxFlag() {
-  bool got;
-  noInterrupts();
-  got = rxFlag;
-  rxFlag = false;
-  interrupts();
-  return got;
+// Reads the FIFO into the rx ring and puts the radio back into RX before
+// hashing (lib/rx_capture); everything slow happens afterwards in
+// processFrame(). True if the frame made it into the ring.
+static inline bool captureFrame() {
+  // When the ring is full the frame still has to leave the FIFO before the
+  // radio can be re-armed; it lands here and is counted as an overflow.
+  static RxFrame scratch;
+  portENTER_CRITICAL(&irqMux);
+  int64_t captureUs = irqUs;
+  portEXIT_CRITICAL(&irqMux);
+  uint32_t wakeUs = (uint32_t)(esp_timer_get_time() - captureUs);
+  if (wakeUs > rxStats.wakeMaxUs) rxStats.wakeMaxUs = wakeUs;
+  if (wakeUs > OBSERVER_RX_LATENCY_BOUND_US) rxStats.wakeLate++;
+  const RxFrame &frame = rxCapture(radio, rxRing, scratch, captureUs, sha256);
+
+  rxStats.frames++;
+  if (frame.reportedLen <= 0) rxStats.zeroLen++;
+  if (frame.state == RADIOLIB_ERR_CRC_MISMATCH) {
+    rxStats.crcFail++;
+  } else if (frame.state != RADIOLIB_ERR_NONE) {
+    rxStats.readErrors++;
+  }
+  return &frame != &scratch;
 }
 
+// ================= UPLINK QUEUE =================
+// Serialized records wait here between the proc task and the uplink task.
+// The policy decides what happens to a new record when the queue is full:
+// spill it to the flash spool, evict the oldest queued record, or evict the
+// oldest record of an expendable payload type (falling back to the oldest).
+// The proc task runs on the radio core and never touches the spool itself;
+// spilled records go through a second queue that the uplink task empties.
+enum UplinkPolicy : uint8_t { UPLINK_SPILL, UPLINK_DROP_OLDEST, UPLINK_DROP_TYPE, UPLINK_POLICY_COUNT };
+static const char *const UPLINK_POLICY_NAMES[UPLINK_POLICY_COUNT] = {"spill", "oldest", "type"};
+
+#ifndef OBSERVER_UPLINK_POLICY
+#define OBSERVER_UPLINK_POLICY UPLINK_SPILL
+#endif
+// Bit n set = MeshCore payload type n is expendable; default ACK and TRACE.
+#ifndef OBSERVER_UPLINK_DROP_TYPES
+#define OBSERVER_UPLINK_DROP_TYPES ((1UL << 0x03) | (1UL << 0x09))
+#endif
+#define UPLINK_QUEUE_DEPTH 16
+#define UPLINK_RECORD_MAX  1024
+#define UPLINK_SPILL_QUEUE_DEPTH 8
+
+typedef RecordQueue<UPLINK_QUEUE_DEPTH, UPLINK_RECORD_MAX> UplinkQueue;
+typedef RecordQueue<UPLINK_SPILL_QUEUE_DEPTH, UPLINK_RECORD_MAX> SpillQueue;
+UplinkQueue uplinkQueue;
+SpillQueue spillQueue;
+UplinkPolicy uplinkPolicy = OBSERVER_UPLINK_POLICY;
+uint32_t uplinkDropTypes = OBSERVER_UPLINK_DROP_TYPES;
+
+// Producer-side counters are written by the proc task only, delivery-side
+// counters by the uplink task only.
+struct UplinkStats {
+  uint32_t enqueued;
+  uint32_t droppedOldest;
+  uint32_t droppedType;
+  uint32_t droppedFull;    // queue and spill queue full, or oversize
+  uint32_t sent;
+  uint32_t spilled;        // queue full, record written to the spool instead
+  uint32_t spillFailed;    // queue full and the spool did not take it either
+  uint32_t spooled;        // dequeued while the link was down
+  uint32_t publishFailed;
+  uint32_t publishes;      // PUBLISH packets, one per batch in batch mode
+  uint64_t latencyUsSum;   // enqueue-to-publish
+  uint32_t latencyUsMax;
+  uint32_t lzBatches;      // batches run through the compressor
+  uint64_t lzIn;           // batch bytes before compression
+  uint64_t lzOut;          // bytes published for them (plain when it did not shrink)
+  uint64_t lzUsSum;
+};
+UplinkStats uplinkStats = {};
+
+// Record encoding: the JSON schema, or the compact binary record from
+// lib/obs_record, published on <packets topic>/bin so existing subscribers
+// never see it.
+enum RecordFormat : uint8_t { RECORD_JSON, RECORD_BIN, RECORD_FORMAT_COUNT };
+static const char *const RECORD_FORMAT_NAMES[RECORD_FORMAT_COUNT] = {"json", "bin"};
+
+#ifndef OBSERVER_RECORD_FORMAT
+#define OBSERVER_RECORD_FORMAT RECORD_JSON
+#endif
+RecordFormat recordFormat = OBSERVER_RECORD_FORMAT;
+
+// frameHash bytes sent upstream: the full SHA-256, or its first 16 bytes
+// (still far beyond any realistic collision risk for frame matching).
+#ifndef OBSERVER_HASH_BYTES
+#define OBSERVER_HASH_BYTES 32
+#endif
+uint8_t hashBytes = OBSERVER_HASH_BYTES;
+
+// Optional batching: coalesce queued records into one PUBLISH of up to
+// batchMaxRecords records, flushed after batchMaxMs at the latest. A batch
+// never exceeds what fits in MQTT_BUFFER_SIZE next to the topic.
+// BATCH_OFF keeps one record per PUBLISH for older ingest. Binary records
+// are self-delimiting and are simply concatenated whatever the format.
+enum BatchFormat : uint8_t { BATCH_OFF, BATCH_NDJSON, BATCH_ARRAY, BATCH_FORMAT_COUNT };
+static const char *const BATCH_FORMAT_NAMES[BATCH_FORMAT_COUNT] = {"off", "ndjson", "array"};
+
+#ifndef OBSERVER_BATCH_FORMAT
+#define OBSERVER_BATCH_FORMAT BATCH_OFF
+#endif
+#ifndef OBSERVER_BATCH_MAX_RECORDS
+#define OBSERVER_BATCH_MAX_RECORDS 16
+#endif
+#ifndef OBSERVER_BATCH_MAX_MS
+#define OBSERVER_BATCH_MAX_MS 1000
+#endif
+#define BATCH_RECORDS_LIMIT 32
+
+struct UplinkBatch {
+  char body[MQTT_BUFFER_SIZE];
+  size_t len;
+  uint8_t count;
+  uint16_t offset[BATCH_RECORDS_LIMIT];
+  uint16_t recLen[BATCH_RECORDS_LIMIT];
+  int64_t enqueuedUs[BATCH_RECORDS_LIMIT];
+  unsigned long startedMs;
+  bool binary;
+};
+
+BatchFormat batchFormat = OBSERVER_BATCH_FORMAT;
+uint8_t batchMaxRecords = OBSERVER_BATCH_MAX_RECORDS;
+uint32_t batchMaxMs = OBSERVER_BATCH_MAX_MS;
+UplinkBatch uplinkBatch = {};
+
+// Optional batch compression with lib/lz_codec and its MeshCore preset
+// dictionary. Compressed batches go to <packets topic>/lz (or
+// <packets topic>/bin/lz) and start with the dictionary id, so subscribers
+// of the plain topics never see them; tools/lz_codec decompresses. A batch
+// that does not shrink is published plain.
+#ifndef OBSERVER_BATCH_COMPRESS
+#define OBSERVER_BATCH_COMPRESS false
+#endif
+typedef LzCodec<MQTT_BUFFER_SIZE> UplinkCodec;
+
+bool batchCompress = OBSERVER_BATCH_COMPRESS;
+UplinkCodec uplinkCodec((const uint8_t *)LZ_DICT_MESHCORE, sizeof(LZ_DICT_MESHCORE) - 1, LZ_DICT_MESHCORE_ID);
+
 // ================= MQTT =================
+// With OBSERVER_MQTT5 each topic goes out once per connection and later
+// PUBLISHes carry a 2-byte topic alias instead, plus the schema version.
 WiFiClientSecure tlsClient;
+#if OBSERVER_MQTT5
+struct MillisClock {
+  static uint32_t ms() { return millis(); }
+  static void idle() { vTaskDelay(1); }
+};
+Mqtt5Client<WiFiClientSecure, MillisClock, MQTT_BUFFER_SIZE> mqttClient(tlsClient);
+#define MQTT_PUBLISH_PROPS MQTT5_PUBLISH_PROPS_MAX
+#else
 PubSubClient mqttClient(tlsClient);
+#define MQTT_PUBLISH_PROPS 0
+#endif
 
 Preferences prefs;
 String wifiSsid;
@@ -113,19 +437,118 @@ String mqttUser;
 String mqttPass;
 String observerId;
 String observerName;
+// Publish topics, built once observerId is known (it cannot change without
+// a reboot) so the hot paths do not rebuild them per message.
+#define TOPIC_MAX 96
+char packetsTopic[TOPIC_MAX];
+char packetsBinTopic[TOPIC_MAX];
+char packetsLzTopic[TOPIC_MAX];
+char packetsBinLzTopic[TOPIC_MAX];
+char statsTopic[TOPIC_MAX];
+char sessionTopic[TOPIC_MAX];
 float observerLat = OBSERVER_LAT;
 float observerLon = OBSERVER_LON;
 bool wifiWasConnected = false;
-bool mqttWasConnected = false;
+// Serializes access to the spool file between the uplink task (spill,
+// spool / drain) and the housekeeping commit job.
+SemaphoreHandle_t spoolLock = nullptr;
+// SPIFFS is mounted once in setup; the writer keeps the spool file open.
+bool spoolMounted = false;
+// Time spool.begin() took at boot, torn-tail recovery and the conversion
+// of older text spools included.
+uint32_t spoolRecoverMs = 0;
+uint32_t spoolCommitBytes = OBSERVER_SPOOL_COMMIT_BYTES;
+uint32_t spoolCommitMs = OBSERVER_SPOOL_COMMIT_MS;
+uint8_t spoolDrainRecords = OBSERVER_SPOOL_DRAIN_RECORDS;
+uint32_t spoolDrainBytes = OBSERVER_SPOOL_DRAIN_BYTES;
+uint32_t spoolDrainBps = OBSERVER_SPOOL_DRAIN_BPS;
+Spool<fs::FS, File, SPOOL_BUFFER_BYTES> spool(SPIFFS, SPOOL_PREFIX);
+RamRing spoolRam;
+bool spoolRamPsram = false;
+uint8_t spoolRamFillPct = OBSERVER_SPOOL_RAM_FILL_PCT;
+uint32_t spoolRamAgeMs = OBSERVER_SPOOL_RAM_AGE_MS;
+// Guards the config Strings the net task reads while the UI task edits them.
+SemaphoreHandle_t cfgLock = nullptr;
 
-// ================= UTILITIES =================
-static inline void toHex(const uint8_t *data, size_t len, char *out) {
-  const char *hex = "0123456789ABCDEF";
-  for (size_t i = 0; i < len; i++) {
-    out[i * 2] = hex[(data[i] >> 4) & 0x0F];
-    out[i * 2 + 1] = hex[data[i] & 0x0F];
+// ================= SESSION =================
+// Observer metadata (name, position, firmware) is published once per
+// session as a retained message on .../session. With sessionRecords on,
+// packet records drop observerId, observerName and gps and carry {sid, seq}
+// instead; ingest rebuilds full records from the session with that sid.
+// Any metadata change starts a new session. All of it is under cfgLock.
+#ifndef OBSERVER_SESSION_RECORDS
+#define OBSERVER_SESSION_RECORDS 0
+#endif
+bool sessionRecords = OBSERVER_SESSION_RECORDS;
+uint32_t sessionId = 0;
+uint32_t sessionSeq = 0;             // records serialized in this session
+volatile bool sessionDirty = false;  // metadata not yet published
+
+static inline void newSession() {
+  sessionId = esp_random();
+  sessionSeq = 0;
+  sessionDirty = true;
+}
+
+// ================= MQTT LINK =================
+// The net task owns the link state machine. The blocking DNS lookup and the
+// TLS + MQTT CONNECT handshake run in the conn task, and the net task never
+// touches mqttClient while a handshake is in flight, so an unreachable
+// broker costs nothing but that task's time: frames keep draining to the
+// spool.
+#define LINK_BACKOFF_MIN_MS      1000
+#define LINK_BACKOFF_MAX_MS      60000
+#define LINK_HANDSHAKE_TIMEOUT_S 10
+
+enum LinkState : uint8_t { LINK_OFFLINE, LINK_BACKOFF, LINK_CONNECTING, LINK_UP, LINK_STATE_COUNT };
+static const char *const LINK_STATE_NAMES[LINK_STATE_COUNT] = {"offline", "backoff", "connecting", "up"};
+
+volatile LinkState linkState = LINK_OFFLINE;
+unsigned long linkSinceMs = 0;
+uint64_t linkStateMs[LINK_STATE_COUNT] = {0};
+uint32_t linkAttempts = 0;
+uint32_t linkFailures = 0;
+uint32_t linkBackoffMs = 0;
+unsigned long linkRetryAtMs = 0;
+volatile bool connDone = false;
+volatile bool connOk = false;
+
+static inline void setLinkState(LinkState next) {
+  unsigned long now = millis();
+  linkStateMs[linkState] += now - linkSinceMs;
+  linkSinceMs = now;
+  if (next == LINK_UP && linkState != LINK_UP) {
+    // The broker may have lost the retained session since we last sent it.
+    sessionDirty = true;
+    Serial.print("[observer] mqtt connected ");
+    Serial.print(mqttHost);
+    Serial.print(":");
+    Serial.println(mqttPort);
+    displayDirty = true;
+  } else if (next != LINK_UP && linkState == LINK_UP) {
+    Serial.println("[observer] mqtt disconnected");
+    displayDirty = true;
   }
-  out[len * 2] = '\0';
+  linkState = next;
+}
+
+// Exponential backoff; half of each window is random so a fleet of
+// observers does not reconnect in lockstep after a broker restart.
+static inline void scheduleRetry() {
+  linkBackoffMs = linkBackoffMs ? min<uint32_t>(linkBackoffMs * 2, LINK_BACKOFF_MAX_MS) : LINK_BACKOFF_MIN_MS;
+  linkRetryAtMs = millis() + linkBackoffMs / 2 + esp_random() % (linkBackoffMs / 2 + 1);
+  setLinkState(LINK_BACKOFF);
+}
+
+// ================= UTILITIES =================
+// Wall-clock time of an esp_timer timestamp in microseconds since the Unix
+// epoch, or 0 until SNTP has set the clock.
+static inline int64_t epochUs(int64_t timerUs) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < 1600000000) return 0;
+  int64_t nowUs = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+  return nowUs - (esp_timer_get_time() - timerUs);
 }
 
 static inline String macId() {
@@ -135,19 +558,6 @@ static inline String macId() {
   return String(buf);
 }
 
-static inline String sha256Hex(const uint8_t *data, size_t len) {
-  uint8_t out[32];
-  mbedtls_sha256_context ctx;
-  mbedtls_sha256_init(&ctx);
-  mbedtls_sha256_starts_ret(&ctx, 0);
-  mbedtls_sha256_update_ret(&ctx, data, len);
-  mbedtls_sha256_finish_ret(&ctx, out);
-  mbedtls_sha256_free(&ctx);
-  char buf[65];
-  toHex(out, 32, buf);
-  return String(buf);
-}
-
 static inline void loadConfig() {
   prefs.begin(PREFS_NS, false);
   wifiSsid = prefs.getString("ssid", OBSERVER_WIFI_SSID);
@@ -156,7 +566,30 @@ static inline void loadConfig() {
   observerName = prefs.getString("name", "");
   observerLat = prefs.getFloat("lat", OBSERVER_LAT);
   observerLon = prefs.getFloat("lon", OBSERVER_LON);
+  uplinkPolicy = (UplinkPolicy)prefs.getUChar("upol", OBSERVER_UPLINK_POLICY);
+  uplinkDropTypes = prefs.getUInt("udrop", OBSERVER_UPLINK_DROP_TYPES);
+  batchFormat = (BatchFormat)prefs.getUChar("bfmt", OBSERVER_BATCH_FORMAT);
+  batchMaxRecords = prefs.getUChar("bn", OBSERVER_BATCH_MAX_RECORDS);
+  batchMaxMs = prefs.getUInt("bms", OBSERVER_BATCH_MAX_MS);
+  recordFormat = (RecordFormat)prefs.getUChar("rfmt", OBSERVER_RECORD_FORMAT);
+  sessionRecords = prefs.getBool("sess", OBSERVER_SESSION_RECORDS);
+  hashBytes = prefs.getUChar("hlen", OBSERVER_HASH_BYTES);
+  batchCompress = prefs.getBool("bz", OBSERVER_BATCH_COMPRESS);
+  spoolCommitBytes = prefs.getUInt("scb", OBSERVER_SPOOL_COMMIT_BYTES);
+  spoolCommitMs = prefs.getUInt("scm", OBSERVER_SPOOL_COMMIT_MS);
+  spoolDrainRecords = prefs.getUChar("sdn", OBSERVER_SPOOL_DRAIN_RECORDS);
+  spoolDrainBytes = prefs.getUInt("sdb", OBSERVER_SPOOL_DRAIN_BYTES);
+  spoolDrainBps = prefs.getUInt("sdr", OBSERVER_SPOOL_DRAIN_BPS);
+  spoolRamFillPct = prefs.getUChar("srf", OBSERVER_SPOOL_RAM_FILL_PCT);
+  spoolRamAgeMs = prefs.getUInt("sra", OBSERVER_SPOOL_RAM_AGE_MS);
   prefs.end();
+  if (!spoolDrainRecords) spoolDrainRecords = 1;
+  if (!spoolDrainBytes) spoolDrainBytes = 1;
+  if (uplinkPolicy >= UPLINK_POLICY_COUNT) uplinkPolicy = UPLINK_SPILL;
+  if (batchFormat >= BATCH_FORMAT_COUNT) batchFormat = BATCH_OFF;
+  if (recordFormat >= RECORD_FORMAT_COUNT) recordFormat = RECORD_JSON;
+  if (hashBytes != 16) hashBytes = 32;
+  batchMaxRecords = constrain(batchMaxRecords, 1, BATCH_RECORDS_LIMIT);
 
   mqttHost = OBSERVER_MQTT_HOST;
   mqttPort = OBSERVER_MQTT_PORT;
@@ -165,6 +598,12 @@ static inline void loadConfig() {
 
   if (observerId.length() == 0) observerId = macId();
   if (observerName.length() == 0) observerName = observerId;
+  snprintf(packetsTopic, sizeof(packetsTopic), "meshrank/observers/%s/packets", observerId.c_str());
+  snprintf(packetsBinTopic, sizeof(packetsBinTopic), "meshrank/observers/%s/packets/bin", observerId.c_str());
+  snprintf(packetsLzTopic, sizeof(packetsLzTopic), "%s/lz", packetsTopic);
+  snprintf(packetsBinLzTopic, sizeof(packetsBinLzTopic), "%s/lz", packetsBinTopic);
+  snprintf(statsTopic, sizeof(statsTopic), "meshrank/observers/%s/stats", observerId.c_str());
+  snprintf(sessionTopic, sizeof(sessionTopic), "meshrank/observers/%s/session", observerId.c_str());
 }
 
 static inline void renderDisplay() {
@@ -198,7 +637,7 @@ static inline void renderDisplay() {
 
   display.setCursor(0, 48);
   display.print("MQTT: ");
-  display.println(mqttClient.connected() ? "connected" : "offline");
+  display.println(LINK_STATE_NAMES[linkState]);
   display.display();
 }
 
@@ -238,49 +677,701 @@ static inline void saveConfig() {
   prefs.putString("name", observerName);
   prefs.putFloat("lat", observerLat);
   prefs.putFloat("lon", observerLon);
+  prefs.putUChar("upol", uplinkPolicy);
+  prefs.putUInt("udrop", uplinkDropTypes);
+  prefs.putUChar("bfmt", batchFormat);
+  prefs.putUChar("bn", batchMaxRecords);
+  prefs.putUInt("bms", batchMaxMs);
+  prefs.putUChar("rfmt", recordFormat);
+  prefs.putBool("sess", sessionRecords);
+  prefs.putUChar("hlen", hashBytes);
+  prefs.putBool("bz", batchCompress);
+  prefs.putUInt("scb", spoolCommitBytes);
+  prefs.putUInt("scm", spoolCommitMs);
+  prefs.putUChar("sdn", spoolDrainRecords);
+  prefs.putUInt("sdb", spoolDrainBytes);
+  prefs.putUInt("sdr", spoolDrainBps);
+  prefs.putUChar("srf", spoolRamFillPct);
+  prefs.putUInt("sra", spoolRamAgeMs);
   prefs.end();
 }
 
-static inline bool spoolAppend(const String &line) {
-  if (!SPIFFS.begin(true)) return false;
-  File f = SPIFFS.open(SPOOL_PATH, FILE_APPEND);
-  if (!f) return false;
-  f.println(line);
-  f.close();
-  File stat = SPIFFS.open(SPOOL_PATH, FILE_READ);
-  if (stat && stat.size() > MAX_SPOOL_BYTES) {
-    stat.close();
-    SPIFFS.remove(SPOOL_PATH);
-  } else if (stat) {
-    stat.close();
+// ================= SPOOL DRAIN =================
+// The spool is replayed by the uplink task a slice at a time: at most
+// spoolDrainRecords records and spoolDrainBytes bytes per pass, only when
+// no live record is queued, and paced by a token bucket to spoolDrainBps
+// so a reconnect after a long outage neither starves live records nor
+// holds the spool lock for more than one slice.
+struct SpoolDrainStats {
+  uint32_t slices;       // passes that sent something
+  uint32_t records;      // records replayed
+  uint64_t bytes;        // record bytes replayed
+  uint32_t yieldedLive;  // passes skipped for queued live records
+  uint32_t yieldedRate;  // passes skipped for the bandwidth target
+  uint32_t resent;       // replays sent again after a PUBACK timeout
+  uint32_t rejected;     // PUBACKs with a failure reason code
+};
+
+// Traffic between the RAM tier and flash.
+struct SpoolTierStats {
+  uint32_t spills;          // times the RAM ring started moving to flash
+  uint32_t spilledRecords;  // records moved to flash
+  uint32_t spillFailed;     // records the flash spool did not take
+  uint32_t ramDelivered;    // records replayed straight from RAM
+};
+
+SpoolDrainStats drainStats = {};
+SpoolTierStats tierStats = {};
+bool spoolRamSpilling = false;  // sustained outage: the RAM ring is moving to flash
+volatile bool spoolDrainArmed = false;    // records may be waiting in the spool
+volatile bool spoolDrainRestart = false;  // link came up: resume from the last ack
+volatile bool spoolDrainEof = false;      // everything committed has been read
+int32_t drainTokens = 0;
+uint32_t drainRefillMs = 0;
+
+// Moves up to maxBytes of the oldest RAM-tier records to the flash spool,
+// so flash only ever holds records older than those in RAM. Called with
+// spoolLock held.
+static inline void spillRam(size_t maxBytes) {
+  static uint8_t rec[UPLINK_RECORD_MAX];
+  size_t len, moved = 0;
+  if (!spoolMounted) return;
+  // Replays in flight from RAM are read again from flash.
+  if (spoolRam.unacked()) spoolDrainRestart = true;
+  uint32_t now = millis();
+  while (moved < maxBytes && spoolRam.front(rec, sizeof(rec), len)) {
+    if (spool.append(rec, len, now)) tierStats.spilledRecords++;
+    else tierStats.spillFailed++;
+    spoolRam.pop();
+    moved += len;
+  }
+  spoolDrainEof = false;
+}
+
+// Records go to the RAM tier; only when it is full do the oldest move to
+// flash right away, otherwise the spool job spills it in the background.
+// Both tiers store records as is, JSON or binary; flash adds a length,
+// seq and CRC per record (see lib/spool).
+static inline bool spoolAppend(const char *line, size_t len) {
+  xSemaphoreTake(spoolLock, portMAX_DELAY);
+  const uint8_t *data = (const uint8_t *)line;
+  uint32_t now = millis();
+  bool ok = spoolRam.push(data, len, now);
+  while (!ok && spoolMounted && spoolRam.records()) {
+    spillRam(1);
+    ok = spoolRam.push(data, len, now);
+  }
+  if (!ok && spoolMounted) ok = spool.append(data, len, now);
+  if (ok) {
+    spoolDrainArmed = true;
+    spoolDrainEof = false;
   }
-  return true;
+  xSemaphoreGive(spoolLock);
+  return ok;
+}
+
+// Replays go out with QoS 1 on MQTT 5 unless the broker's Maximum QoS is 0.
+static inline bool spoolQos1() {
+#if OBSERVER_MQTT5
+  return mqttClient.maxQos() > 0;
+#else
+  return false;
+#endif
 }
 
-static inline void spoolFlush() {
-  if (!SPIFFS.begin(true)) return;
-  if (!SPIFFS.exists(SPOOL_PATH)) return;
-  File f = SPIFFS.open(SPOOL_PATH, FILE_READ);
-  if (!f) return;
-  while (f.available()) {
-    String line = f.readStringUntil('\n');
-    line.trim();
-    if (line.length() == 0) continue;
-    if (!mqttClient.connected()) break;
-    mqttClient.publish(String("meshrank/observers/" + observerId + "/packets").c_str(), line.c_str());
-    delay(2);
+// The QoS 1 packet identifier, else 1; 0 if it was not sent.
+static inline uint16_t publishSpooled(const uint8_t *rec, size_t len, bool qos1) {
+  const char *topic = rec[0] == '{' ? packetsTopic : packetsBinTopic;
+#if OBSERVER_MQTT5
+  if (qos1) return mqttClient.publishQos1(topic, rec, len);
+#else
+  (void)qos1;
+#endif
+  return mqttClient.publish(topic, rec, len) ? 1 : 0;
+}
+
+#if OBSERVER_MQTT5
+// QoS 1 replays awaiting their PUBACK, oldest first: a flash spool position,
+// or the oldest unacked record of the RAM tier.
+struct SpoolInflight {
+  SpoolPos end;
+  bool ram;
+  uint16_t packetId;
+  bool acked;
+};
+
+SpoolInflight spoolInflight[SPOOL_INFLIGHT];
+uint8_t spoolInflightHead = 0;
+uint8_t spoolInflightCount = 0;
+uint32_t spoolAckWaitMs = 0;
+bool spoolDrainHeld = false;  // after a rejection, until SPOOL_ACK_TIMEOUT_MS
+
+// Matches the PUBACKs the uplink task's loop() has read to replays in
+// flight by packet identifier; the spool is acked up to the oldest replay
+// still waiting, so a PUBACK that overtakes an earlier one is kept until
+// that one arrives. Returns false on a failure reason code.
+static inline bool collectSpoolAcks() {
+  Mqtt5PubAck a;
+  bool ok = true;
+  while (mqttClient.nextPubAck(a)) {
+    for (uint8_t i = 0; i < spoolInflightCount; i++) {
+      SpoolInflight &e = spoolInflight[(spoolInflightHead + i) % SPOOL_INFLIGHT];
+      if (e.packetId != a.packetId || e.acked) continue;
+      spoolAckWaitMs = millis();
+      if (mqtt5PubAckOk(a.reason)) {
+        e.acked = true;
+      } else {
+        drainStats.rejected++;
+        ok = false;
+      }
+      break;
+    }
   }
-  f.close();
-  if (mqttClient.connected()) {
-    SPIFFS.remove(SPOOL_PATH);
+  while (spoolInflightCount && spoolInflight[spoolInflightHead].acked) {
+    const SpoolInflight &e = spoolInflight[spoolInflightHead];
+    if (e.ram) {
+      spoolRam.ack();
+      tierStats.ramDelivered++;
+    } else {
+      spool.ack(e.end);
+    }
+    spoolInflightHead = (spoolInflightHead + 1) % SPOOL_INFLIGHT;
+    spoolInflightCount--;
   }
+  return ok;
+}
+
+static inline uint8_t spoolWindow() {
+  uint16_t max = mqttClient.receiveMax();
+  return max < SPOOL_INFLIGHT ? (uint8_t)max : SPOOL_INFLIGHT;
+}
+#endif
+
+// Called when the link comes up: records read but not acked on the last
+// connection are read again.
+static inline void restartSpoolDrain() {
+  spoolDrainRestart = true;
+  spoolDrainArmed = true;
+}
+
+// Refills the token bucket; it holds at most one slice worth of bytes.
+static inline bool drainTokensAvailable() {
+  if (!spoolDrainBps) return true;
+  uint32_t now = millis();
+  uint64_t add = (uint64_t)spoolDrainBps * (now - drainRefillMs) / 1000;
+  if (add) {
+    drainRefillMs += (uint32_t)(add * 1000 / spoolDrainBps);
+    drainTokens = (int32_t)min<int64_t>((int64_t)drainTokens + add, spoolDrainBytes);
+  }
+  return drainTokens > 0;
+}
+
+// One slice of the replay: flash first, then the RAM tier, which only holds
+// newer records. A record counts as delivered once published (QoS 0) or
+// once its PUBACK is in (QoS 1: MQTT 5 and a broker that takes it); a drain cut short resumes after
+// the last delivered record, and the flash checkpoint carries that across
+// a reboot.
+static inline void serviceSpoolDrain() {
+  if (linkState != LINK_UP || !spoolDrainArmed) return;
+  if (uplinkQueue.size()) {
+    drainStats.yieldedLive++;
+    return;
+  }
+  if (!drainTokensAvailable()) {
+    drainStats.yieldedRate++;
+    return;
+  }
+  if (xSemaphoreTake(spoolLock, 0) != pdTRUE) return;
+  if (spoolDrainRestart) {
+    // Pending records go to flash first so the segments hold the whole
+    // backlog.
+    if (spoolMounted) spool.close();
+    spool.rewind();
+    spoolRam.rewind();
+    spoolRamSpilling = false;
+    spoolDrainRestart = false;
+    spoolDrainEof = false;
+#if OBSERVER_MQTT5
+    spoolInflightCount = 0;
+    spoolDrainHeld = false;
+    Mqtt5PubAck stale;  // for replays of the last connection
+    while (mqttClient.nextPubAck(stale)) continue;
+    spoolAckWaitMs = millis();
+#endif
+  } else if (spoolMounted && spool.pending()) {
+    spool.commit();  // spooled while up: a failed publish or a queue spill
+  }
+#if OBSERVER_MQTT5
+  // A rejection or a timeout sends everything unacked again, from the
+  // oldest; after a rejection only once SPOOL_ACK_TIMEOUT_MS has passed,
+  // so a broker over quota is not hammered.
+  bool rejected = !collectSpoolAcks();
+  if (rejected || (spoolInflightCount && millis() - spoolAckWaitMs > SPOOL_ACK_TIMEOUT_MS)) {
+    drainStats.resent += spoolInflightCount;
+    spoolInflightCount = 0;
+    spool.rewind();
+    spoolRam.rewind();
+    spoolDrainEof = false;
+    spoolAckWaitMs = millis();
+  }
+  if (rejected) spoolDrainHeld = true;
+  if (spoolDrainHeld && millis() - spoolAckWaitMs <= SPOOL_ACK_TIMEOUT_MS) {
+    xSemaphoreGive(spoolLock);
+    return;
+  }
+  spoolDrainHeld = false;
+  // Read to the end with replays in flight: once they are acked, one more
+  // read finds the spool drained and clears it.
+  if (spoolDrainEof && !spoolInflightCount) spoolDrainEof = false;
+#endif
+  static uint8_t rec[UPLINK_RECORD_MAX];
+  size_t len;
+  SpoolPos end;
+  bool qos1 = spoolQos1();
+  uint8_t n = 0;
+  uint32_t bytes = 0;
+  while (n < spoolDrainRecords && bytes < spoolDrainBytes && (!spoolDrainBps || drainTokens > 0)) {
+#if OBSERVER_MQTT5
+    if (spoolInflightCount >= spoolWindow()) break;
+#endif
+    bool ram = spoolDrainEof || !spoolMounted;
+    if (!ram && !spool.next(rec, sizeof(rec), len, end)) {
+      spoolDrainEof = true;
+      continue;
+    }
+    if (ram && !spoolRam.next(rec, sizeof(rec), len)) break;
+    uint16_t packetId = publishSpooled(rec, len, qos1);
+    if (!packetId) {
+      // Link trouble; start again from the last ack once it is back.
+      spoolDrainRestart = true;
+      break;
+    }
+#if OBSERVER_MQTT5
+    if (qos1) {
+      SpoolInflight &e = spoolInflight[(spoolInflightHead + spoolInflightCount++) % SPOOL_INFLIGHT];
+      e.end = end;
+      e.ram = ram;
+      e.packetId = packetId;
+      e.acked = false;
+      spoolAckWaitMs = millis();
+    }
+#endif
+    if (!qos1) {
+      if (ram) {
+        spoolRam.ack();
+        tierStats.ramDelivered++;
+      } else {
+        spool.ack(end);
+      }
+    }
+    n++;
+    bytes += len;
+    drainTokens -= (int32_t)len;
+  }
+  if (n) {
+    drainStats.slices++;
+    drainStats.records += n;
+    drainStats.bytes += bytes;
+  }
+#if OBSERVER_MQTT5
+  bool done = (spoolDrainEof || !spoolMounted) && !spoolRam.records() && !spoolInflightCount;
+#else
+  bool done = (spoolDrainEof || !spoolMounted) && !spoolRam.records();
+#endif
+  if (done) {
+    if (spoolMounted) spool.checkpoint();
+    spoolDrainArmed = false;
+  }
+  xSemaphoreGive(spoolLock);
+}
+
+// ================= PACKET PROCESSING =================
+// Hands a serialized record to the uplink task, applying uplinkPolicy when
+// the queue is full.
+static inline void enqueueRecord(const char *data, size_t len, uint8_t type) {
+  int64_t nowUs = esp_timer_get_time();
+  bool queued = uplinkQueue.push(data, len, type, nowUs);
+  if (!queued && len <= UplinkQueue::maxLen()) {
+    switch (uplinkPolicy) {
+      case UPLINK_DROP_OLDEST:
+        if (uplinkQueue.dropOldest()) uplinkStats.droppedOldest++;
+        queued = uplinkQueue.push(data, len, type, nowUs);
+        break;
+      case UPLINK_DROP_TYPE:
+        if (uplinkQueue.dropOldestOfType(uplinkDropTypes)) {
+          uplinkStats.droppedType++;
+        } else if (uplinkDropTypes & (1UL << type)) {
+          // Nothing expendable queued and the new record is expendable itself.
+          uplinkStats.droppedType++;
+          return;
+        } else if (uplinkQueue.dropOldest()) {
+          uplinkStats.droppedOldest++;
+        }
+        queued = uplinkQueue.push(data, len, type, nowUs);
+        break;
+      default:
+        if (spillQueue.push(data, len, type, nowUs)) {
+          xTaskNotifyGive(taskStats[TASK_UPLINK].handle);
+          return;
+        }
+        break;
+    }
+  }
+  if (!queued) {
+    uplinkStats.droppedFull++;
+    return;
+  }
+  uplinkStats.enqueued++;
+  xTaskNotifyGive(taskStats[TASK_UPLINK].handle);
+}
+
+// Both return the record length, or 0 if it does not fit in cap. The
+// caller holds cfgLock.
+static inline size_t jsonRecord(const RxFrame &frame, int64_t rxUs, char *out, size_t cap) {
+  int ptype = (frame.len > 0) ? frame.data[0] : -1;
+  JsonWriter w(out, cap);
+  if (sessionRecords) {
+    w.raw("{\"sid\":").u64(sessionId).raw(",\"seq\":").u64(sessionSeq);
+  } else {
+    w.raw("{\"observerId\":\"").text(observerId.c_str(), observerId.length())
+     .raw("\",\"observerName\":\"").text(observerName.c_str(), observerName.length()).raw("\"");
+  }
+  w.raw(",\"ts\":").u64((unsigned long)(frame.captureUs / 1000))
+   .raw(",\"tsUs\":").i64(frame.captureUs)
+   .raw(",\"ptype\":").i64(ptype)
+   .raw(",\"crc\":").boolean(frame.state == RADIOLIB_ERR_NONE)
+   .raw(",\"rssi\":").fixed(frame.rssi, 1)
+   .raw(",\"snr\":").fixed(frame.snr, 2)
+   .raw(",\"reported_len\":").i64(frame.reportedLen)
+   .raw(",\"len\":").i64(frame.len)
+   .raw(",\"payloadHex\":\"").hex(frame.data, frame.len)
+   .raw("\",\"frameHash\":\"").hex(frame.hash, hashBytes).raw("\"");
+  if (rxUs) w.raw(",\"rxUs\":").i64(rxUs);
+  if (!sessionRecords && (observerLat != 0.0f || observerLon != 0.0f)) {
+    w.raw(",\"gps\":{\"lat\":").fixed(observerLat, 6).raw(",\"lon\":").fixed(observerLon, 6).raw("}");
+  }
+  w.raw("}");
+  return w.ok() ? w.size() : 0;
+}
+
+static inline size_t binRecord(const RxFrame &frame, int64_t rxUs, char *out, size_t cap) {
+  ObsRecord r;
+  r.flags = (frame.state == RADIOLIB_ERR_NONE ? OBS_FLAG_CRC_OK : 0) | (rxUs ? OBS_FLAG_RX_US : 0) |
+            (sessionRecords ? OBS_FLAG_SESSION : 0) | (hashBytes == 16 ? OBS_FLAG_HASH16 : 0);
+  r.tsUs = frame.captureUs;
+  r.rxUs = rxUs;
+  r.sid = sessionId;
+  r.seq = sessionSeq;
+  r.rssiDeci = obsRecordFixed(frame.rssi, 10.0f);
+  r.snrCenti = obsRecordFixed(frame.snr, 100.0f);
+  r.reportedLen = frame.reportedLen;
+  r.len = frame.len;
+  r.payload = frame.data;
+  r.hash = frame.hash;
+  return obsRecordEncode(r, (uint8_t *)out, cap);
+}
+
+static inline void processFrame(const RxFrame &frame) {
+  int ptype = (frame.len > 0) ? frame.data[0] : -1;
+  Serial.printf("[observer] rx len=%d rssi=%.1f snr=%.2f crc=%s\n",
+                frame.len, frame.rssi, frame.snr, (frame.state == RADIOLIB_ERR_NONE ? "ok" : "bad"));
+
+  // Built in place in a buffer owned by the proc task: no String
+  // temporaries or heap traffic per frame.
+  static char record[UPLINK_RECORD_MAX];
+  int64_t rxUs = epochUs(frame.captureUs);
+  xSemaphoreTake(cfgLock, portMAX_DELAY);
+  size_t recordLen = (recordFormat == RECORD_BIN) ? binRecord(frame, rxUs, record, sizeof(record))
+                                                  : jsonRecord(frame, rxUs, record, sizeof(record));
+  if (recordLen) sessionSeq++;
+  xSemaphoreGive(cfgLock);
+  if (recordLen == 0) {
+    uplinkStats.droppedFull++;
+    return;
+  }
+
+  enqueueRecord(record, recordLen, (ptype >= 0) ? (ptype >> 2) & 0x0F : 0x0F);
+}
+
+// ================= LOSS STATS =================
+// Every place a frame can be lost, as comma-separated JSON members shared
+// by the serial status line and the periodic MQTT stats message.
+static inline String lossStatsJson() {
+  const RxStats &r = rxStats;
+  const UplinkStats &u = uplinkStats;
+  char buf[384];
+  snprintf(buf, sizeof(buf),
+           "\"rxFrames\":%u,\"rxIrqMissed\":%u,\"rxOverflow\":%u,\"rxHwm\":%u,"
+           "\"rxZeroLen\":%u,\"rxZeroLenRate\":%.4f,\"rxCrcFail\":%u,\"rxCrcFailRate\":%.4f,"
+           "\"rxReadErr\":%u,\"upDroppedOldest\":%u,\"upDroppedType\":%u,\"upDroppedFull\":%u",
+           (unsigned)r.frames, (unsigned)r.irqMissed, (unsigned)rxRing.overflows(), (unsigned)rxRing.highWater(),
+           (unsigned)r.zeroLen, r.frames ? (double)r.zeroLen / r.frames : 0.0,
+           (unsigned)r.crcFail, r.frames ? (double)r.crcFail / r.frames : 0.0,
+           (unsigned)r.readErrors, (unsigned)u.droppedOldest, (unsigned)u.droppedType, (unsigned)u.droppedFull);
+  return String(buf);
+}
+
+// ================= UPLINK =================
+static inline void recordDelivered(int64_t enqueuedUs) {
+  uint32_t latencyUs = (uint32_t)(esp_timer_get_time() - enqueuedUs);
+  uplinkStats.sent++;
+  uplinkStats.latencyUsSum += latencyUs;
+  if (latencyUs > uplinkStats.latencyUsMax) uplinkStats.latencyUsMax = latencyUs;
+}
+
+static inline void spoolRecord(const char *data, size_t len) {
+  if (spoolAppend(data, len)) uplinkStats.spooled++;
+}
+
+// Records the proc task could not queue under UPLINK_SPILL; appending may
+// wait for the spool lock and write flash, which is why it happens here.
+static inline void serviceSpill() {
+  static SpillQueue::Record rec;
+  while (spillQueue.pop(rec)) {
+    if (spoolAppend(rec.data, rec.len)) uplinkStats.spilled++;
+    else uplinkStats.spillFailed++;
+  }
+}
+
+static inline bool publishTo(const char *topic, const uint8_t *body, size_t len) {
+  if (linkState != LINK_UP) return false;
+  if (mqttClient.publish(topic, body, len)) {
+    uplinkStats.publishes++;
+    return true;
+  }
+  uplinkStats.publishFailed++;
+  Serial.printf("[observer] mqtt publish failed len=%u\n", (unsigned)len);
+  return false;
+}
+
+static inline bool publishBody(const char *body, size_t len, bool binary) {
+  return publishTo(binary ? packetsBinTopic : packetsTopic, (const uint8_t *)body, len);
+}
+
+// Body bytes available to a batch: the PUBLISH fixed header (up to 5
+// bytes), the topic and its 2-byte length and any MQTT 5 properties share
+// MQTT_BUFFER_SIZE with it.
+static inline size_t batchCapacity(bool binary) {
+  return MQTT_BUFFER_SIZE - 5 - 2 - MQTT_PUBLISH_PROPS - strlen(binary ? packetsBinTopic : packetsTopic);
+}
+
+// Compressed output is capped so that it plus the 3 bytes longer /lz topic
+// still fits where the plain batch did.
+static inline bool publishBatch(const UplinkBatch &b) {
+  if (!batchCompress) return publishBody(b.body, b.len, b.binary);
+  static uint8_t packed[MQTT_BUFFER_SIZE];
+  int64_t startUs = esp_timer_get_time();
+  size_t n = uplinkCodec.compress((const uint8_t *)b.body, b.len, packed, b.len - 3);
+  uplinkStats.lzUsSum += esp_timer_get_time() - startUs;
+  uplinkStats.lzBatches++;
+  uplinkStats.lzIn += b.len;
+  uplinkStats.lzOut += n ? n : b.len;
+  if (!n) return publishBody(b.body, b.len, b.binary);
+  return publishTo(b.binary ? packetsBinLzTopic : packetsLzTopic, packed, n);
+}
+
+// Publishes the pending batch; if that fails its records are spooled one
+// per line, exactly as they would have been without batching.
+static inline void flushBatch() {
+  UplinkBatch &b = uplinkBatch;
+  if (b.count == 0) return;
+  if (batchFormat == BATCH_ARRAY && !b.binary) b.body[b.len++] = ']';
+  if (publishBatch(b)) {
+    for (uint8_t i = 0; i < b.count; i++) recordDelivered(b.enqueuedUs[i]);
+  } else {
+    for (uint8_t i = 0; i < b.count; i++) spoolRecord(b.body + b.offset[i], b.recLen[i]);
+  }
+  b.len = 0;
+  b.count = 0;
+}
+
+static inline bool batchFits(size_t recLen, bool binary) {
+  // One separator before the record and, for arrays, the closing bracket.
+  size_t framing = binary ? 0 : 2;
+  return uplinkBatch.len + recLen + framing <= batchCapacity(binary);
+}
+
+static inline void batchRecord(const UplinkQueue::Record &rec) {
+  UplinkBatch &b = uplinkBatch;
+  bool binary = obsRecordIsBinary((uint8_t)rec.data[0]);
+  // A format switch never mixes JSON and binary records in one PUBLISH.
+  if (b.count && (b.binary != binary || !batchFits(rec.len, binary))) flushBatch();
+  if (!batchFits(rec.len, binary)) {
+    // Too big to share a PUBLISH with anything; send it on its own.
+    if (publishBody(rec.data, rec.len, binary)) recordDelivered(rec.enqueuedUs);
+    else spoolRecord(rec.data, rec.len);
+    return;
+  }
+  if (b.count == 0) {
+    b.startedMs = millis();
+    b.binary = binary;
+    if (batchFormat == BATCH_ARRAY && !binary) b.body[b.len++] = '[';
+  } else if (!binary) {
+    b.body[b.len++] = (batchFormat == BATCH_ARRAY) ? ',' : '\n';
+  }
+  b.offset[b.count] = b.len;
+  b.recLen[b.count] = rec.len;
+  b.enqueuedUs[b.count] = rec.enqueuedUs;
+  memcpy(b.body + b.len, rec.data, rec.len);
+  b.len += rec.len;
+  b.count++;
+  if (b.count >= batchMaxRecords) flushBatch();
+}
+
+// Time trigger, and the exit path when batching is switched off or the
+// link drops with a batch pending.
+static inline void serviceBatch() {
+  UplinkBatch &b = uplinkBatch;
+  if (b.count == 0) return;
+  if (batchFormat == BATCH_OFF || linkState != LINK_UP || millis() - b.startedMs >= batchMaxMs) {
+    flushBatch();
+  }
+}
+
+// Publishes the loss counters on .../stats every OBSERVER_STATS_INTERVAL_MS
+// while the link is up.
+static inline void serviceStats() {
+  static unsigned long lastStatsMs = 0;
+  if (linkState != LINK_UP || millis() - lastStatsMs < OBSERVER_STATS_INTERVAL_MS) return;
+  lastStatsMs = millis();
+  String json = "{\"observerId\":\"" + observerId + "\",\"uptimeMs\":" + String(millis()) + "," + lossStatsJson() + "}";
+  mqttClient.publish(statsTopic, json.c_str());
+}
+
+// Publishes the session metadata, retained, whenever it changed or the link
+// came back up.
+static inline void serviceSession() {
+  if (!sessionDirty || linkState != LINK_UP) return;
+  char json[384];
+  JsonWriter w(json, sizeof(json));
+  xSemaphoreTake(cfgLock, portMAX_DELAY);
+  w.raw("{\"observerId\":\"").text(observerId.c_str(), observerId.length())
+   .raw("\",\"observerName\":\"").text(observerName.c_str(), observerName.length())
+   .raw("\",\"sid\":").u64(sessionId)
+   .raw(",\"fw\":\"" OBSERVER_FW_VER "\",\"format\":\"").text(RECORD_FORMAT_NAMES[recordFormat])
+   .raw("\",\"sessionRecords\":").boolean(sessionRecords)
+   .raw(",\"hashBytes\":").u64(hashBytes);
+  if (observerLat != 0.0f || observerLon != 0.0f) {
+    w.raw(",\"gps\":{\"lat\":").fixed(observerLat, 6).raw(",\"lon\":").fixed(observerLon, 6).raw("}");
+  }
+  w.raw("}");
+  // Cleared under the lock so a change made while publishing re-arms it.
+  sessionDirty = false;
+  xSemaphoreGive(cfgLock);
+  if (!w.ok() || !mqttClient.publish(sessionTopic, (const uint8_t *)w.c_str(), w.size(), true)) {
+    sessionDirty = true;
+  }
+}
+
+// Publishes (or batches) one dequeued record, or spools it while the link
+// is down.
+static inline void sendRecord(const UplinkQueue::Record &rec) {
+  if (linkState != LINK_UP) {
+    spoolRecord(rec.data, rec.len);
+  } else if (batchFormat != BATCH_OFF) {
+    batchRecord(rec);
+  } else if (publishBody(rec.data, rec.len, obsRecordIsBinary((uint8_t)rec.data[0]))) {
+    recordDelivered(rec.enqueuedUs);
+  } else {
+    spoolRecord(rec.data, rec.len);
+  }
+}
+
+// One JSON line per task: stack high-water (bytes never used), time spent
+// working and that time as a share of uptime.
+static inline void printTaskStats() {
+  uint64_t upUs = esp_timer_get_time();
+  for (const TaskStats &t : taskStats) {
+    if (!t.handle) continue;
+    Serial.printf("{\"task\":\"%s\",\"core\":%d,\"prio\":%u,\"stackFree\":%u,\"busyUs\":%llu,\"runs\":%u,\"cpu\":%.2f}\n",
+                  t.name, (int)t.core, (unsigned)t.prio, (unsigned)uxTaskGetStackHighWaterMark(t.handle),
+                  (unsigned long long)t.busyUs, (unsigned)t.runs, upUs ? (100.0 * t.busyUs) / upUs : 0.0);
+  }
+}
+
+// One line per spool tier: RAM ring occupancy and spills, then the flash
+// cost of spooling (operations per record and estimated bytes programmed
+// per record byte) and the drain.
+static inline void printSpoolStats() {
+  Serial.printf("{\"tier\":\"ram\",\"psram\":%s,\"capacity\":%u,\"bytes\":%u,\"records\":%u,\"hwm\":%u,\"fillPct\":%u,\"ageMs\":%u,\"spilling\":%s,\"spills\":%u,\"spilledRecords\":%u,\"spillFailed\":%u,\"delivered\":%u}\n",
+                spoolRamPsram ? "true" : "false", (unsigned)spoolRam.capacity(), (unsigned)spoolRam.bytes(),
+                (unsigned)spoolRam.records(), (unsigned)spoolRam.highWater(), (unsigned)spoolRamFillPct,
+                (unsigned)spoolRamAgeMs, spoolRamSpilling ? "true" : "false", (unsigned)tierStats.spills,
+                (unsigned)tierStats.spilledRecords, (unsigned)tierStats.spillFailed, (unsigned)tierStats.ramDelivered);
+  const SpoolStats &s = spool.stats();
+  Serial.printf("{\"tier\":\"flash\",\"mounted\":%s,\"segments\":%u,\"maxSegments\":%u,\"segmentBytes\":%u,\"commitBytes\":%u,\"commitMs\":%u,\"pending\":%u,\"records\":%u,\"commits\":%u,\"evicted\":%u,\"replayed\":%u,\"acked\":%u,\"ackedOffset\":%u,\"drainN\":%u,\"drainBytes\":%u,\"drainBps\":%u,\"draining\":%s,\"drainSlices\":%u,\"drainRecords\":%u,\"drainRecordBytes\":%llu,\"drainYieldedLive\":%u,\"drainYieldedRate\":%u,\"drainResent\":%u,\"drainRejected\":%u,\"nextSeq\":%u,\"torn\":%u,\"crcErrors\":%u,\"discarded\":%u,\"imported\":%u,\"metaRebuilt\":%u,\"orphaned\":%u,\"recoverMs\":%u,\"flashOps\":%u,\"flashOpsPerRecord\":%.2f,\"writeAmp\":%.2f}\n",
+                spoolMounted ? "true" : "false", (unsigned)spool.segmentCount(), (unsigned)spool.maxSegments(),
+                (unsigned)spool.segmentBytes(), (unsigned)spoolCommitBytes, (unsigned)spoolCommitMs,
+                (unsigned)spool.pending(), (unsigned)s.records, (unsigned)s.commits, (unsigned)s.evicted,
+                (unsigned)s.replayed, (unsigned)s.acked, (unsigned)spool.ackedOffset(), (unsigned)spoolDrainRecords,
+                (unsigned)spoolDrainBytes, (unsigned)spoolDrainBps, spoolDrainArmed ? "true" : "false",
+                (unsigned)drainStats.slices, (unsigned)drainStats.records, (unsigned long long)drainStats.bytes,
+                (unsigned)drainStats.yieldedLive, (unsigned)drainStats.yieldedRate, (unsigned)drainStats.resent,
+                (unsigned)drainStats.rejected, (unsigned)spool.nextSeq(), (unsigned)s.torn, (unsigned)s.crcErrors,
+                (unsigned)s.discarded, (unsigned)s.imported, (unsigned)s.metaRebuilt, (unsigned)s.orphaned,
+                (unsigned)spoolRecoverMs, (unsigned)s.flashOps, s.records ? (double)s.flashOps / s.records : 0.0,
+                s.recordBytes ? (double)s.flashBytes / s.recordBytes : 0.0);
+}
+
+// Link state plus time spent in each state since boot.
+static inline void printLinkStats() {
+  LinkState state = linkState;
+  uint64_t inMs[LINK_STATE_COUNT];
+  for (int i = 0; i < LINK_STATE_COUNT; i++) inMs[i] = linkStateMs[i];
+  inMs[state] += millis() - linkSinceMs;
+  Serial.printf("{\"link\":\"%s\",\"attempts\":%u,\"failures\":%u,\"backoffMs\":%u,\"inMs\":{\"offline\":%llu,\"backoff\":%llu,\"connecting\":%llu,\"up\":%llu}}\n",
+                LINK_STATE_NAMES[state], (unsigned)linkAttempts, (unsigned)linkFailures, (unsigned)linkBackoffMs,
+                (unsigned long long)inMs[LINK_OFFLINE], (unsigned long long)inMs[LINK_BACKOFF],
+                (unsigned long long)inMs[LINK_CONNECTING], (unsigned long long)inMs[LINK_UP]);
+}
+
+static inline void printUplinkStats() {
+  const UplinkStats &u = uplinkStats;
+  Serial.printf("{\"format\":\"%s\",\"sid\":%u,\"sessionRecords\":%s,\"policy\":\"%s\",\"dropTypes\":\"%04lX\",\"batch\":\"%s\",\"batchN\":%u,\"batchMs\":%u,\"compress\":%s,\"lzRatio\":%.3f,\"lzAvgUs\":%u,\"publishes\":%u,\"depth\":%u,\"hwm\":%u,\"enqueued\":%u,\"sent\":%u,\"spooled\":%u,\"spilled\":%u,\"spillFailed\":%u,\"droppedOldest\":%u,\"droppedType\":%u,\"droppedFull\":%u,\"publishFailed\":%u,\"latencyAvgUs\":%u,\"latencyMaxUs\":%u}\n",
+                RECORD_FORMAT_NAMES[recordFormat], (unsigned)sessionId, sessionRecords ? "true" : "false", UPLINK_POLICY_NAMES[uplinkPolicy], (unsigned long)uplinkDropTypes,
+                BATCH_FORMAT_NAMES[batchFormat], (unsigned)batchMaxRecords, (unsigned)batchMaxMs,
+                batchCompress ? "true" : "false", u.lzIn ? (double)u.lzOut / u.lzIn : 1.0,
+                (unsigned)(u.lzBatches ? u.lzUsSum / u.lzBatches : 0),
+                (unsigned)u.publishes,
+                (unsigned)uplinkQueue.size(), (unsigned)uplinkQueue.highWater(),
+                (unsigned)u.enqueued, (unsigned)u.sent, (unsigned)u.spooled, (unsigned)u.spilled,
+                (unsigned)u.spillFailed, (unsigned)u.droppedOldest, (unsigned)u.droppedType, (unsigned)u.droppedFull,
+                (unsigned)u.publishFailed, (unsigned)(u.sent ? u.latencyUsSum / u.sent : 0),
+                (unsigned)u.latencyUsMax);
+}
+
+static inline void printJobStats();
+
+// Frame hashing throughput, software SHA-256 against the SHA peripheral,
+// over a maximum-size LoRa frame. Blocks the UI task for a few tens of ms.
+#define HASH_BENCH_ROUNDS 200
+static inline void runHashBench() {
+  static uint8_t frame[255];
+  for (size_t i = 0; i < sizeof(frame); i++) frame[i] = (uint8_t)esp_random();
+  uint8_t soft[32], hw[32];
+
+  int64_t startUs = esp_timer_get_time();
+  for (int i = 0; i < HASH_BENCH_ROUNDS; i++) Sha256Soft::hash(frame, sizeof(frame), soft);
+  int64_t softUs = esp_timer_get_time() - startUs;
+
+  startUs = esp_timer_get_time();
+  for (int i = 0; i < HASH_BENCH_ROUNDS; i++) sha256(frame, sizeof(frame), hw);
+  int64_t hwUs = esp_timer_get_time() - startUs;
+
+  Serial.printf("{\"bench\":\"sha256\",\"bytes\":%u,\"rounds\":%u,\"softPerSec\":%u,\"hwPerSec\":%u,\"match\":%s}\n",
+                (unsigned)sizeof(frame), (unsigned)HASH_BENCH_ROUNDS,
+                (unsigned)(softUs ? HASH_BENCH_ROUNDS * 1000000LL / softUs : 0),
+                (unsigned)(hwUs ? HASH_BENCH_ROUNDS * 1000000LL / hwUs : 0),
+                memcmp(soft, hw, sizeof(hw)) == 0 ? "true" : "false");
 }
 
 // ================= SERIAL CONFIG =================
-static inline void handleSerialConfig() {
+// Parses whatever serial input arrives before sliceEndUs; the rest waits
+// in the UART buffer for the next slice.
+static inline void handleSerialConfig(int64_t sliceEndUs) {
 #if OBSERVER_SERIAL_CONFIG
   static String buffer;
-  while (Serial.available()) {
+  while (Serial.available() && esp_timer_get_time() < sliceEndUs) {
     char c = (char)Serial.read();
     if (c == '\n' || c == '\r') {
       buffer.trim();
@@ -308,22 +1399,137 @@ static inline void handleSerialConfig() {
       } else if (buffer.startsWith("mqtt.")) {
         // MQTT endpoint is fixed (TLS-only).
       } else if (buffer.startsWith("observer.lat ")) {
+        xSemaphoreTake(cfgLock, portMAX_DELAY);
         observerLat = buffer.substring(13).toFloat();
+        newSession();
+        xSemaphoreGive(cfgLock);
         saveConfig();
         displayDirty = true;
         Serial.println("[observer] cfg lat updated");
       } else if (buffer.startsWith("observer.lon ")) {
+        xSemaphoreTake(cfgLock, portMAX_DELAY);
         observerLon = buffer.substring(13).toFloat();
+        newSession();
+        xSemaphoreGive(cfgLock);
         saveConfig();
         displayDirty = true;
         Serial.println("[observer] cfg lon updated");
       } else if (buffer.startsWith("observer.name ")) {
+        xSemaphoreTake(cfgLock, portMAX_DELAY);
         observerName = buffer.substring(14);
+        newSession();
+        xSemaphoreGive(cfgLock);
         saveConfig();
         displayDirty = true;
         Serial.println("[observer] cfg name updated");
       } else if (buffer == "status") {
-        Serial.println("{\"ok\":true,\"fw\":\"" OBSERVER_FW_VER "\",\"ssid\":\"" + wifiSsid + "\",\"host\":\"" + mqttHost + "\",\"port\":" + String(mqttPort) + ",\"id\":\"" + observerId + "\",\"name\":\"" + observerName + "\",\"lat\":" + String(observerLat, 6) + ",\"lon\":" + String(observerLon, 6) + "}");
+        Serial.println("{\"ok\":true,\"fw\":\"" OBSERVER_FW_VER "\",\"ssid\":\"" + wifiSsid + "\",\"host\":\"" + mqttHost + "\",\"port\":" + String(mqttPort) + ",\"id\":\"" + observerId + "\",\"name\":\"" + observerName + "\",\"lat\":" + String(observerLat, 6) + ",\"lon\":" + String(observerLon, 6) + "," + lossStatsJson() + "}");
+      } else if (buffer.startsWith("uplink.policy ")) {
+        String name = buffer.substring(14);
+        for (uint8_t i = 0; i < UPLINK_POLICY_COUNT; i++) {
+          if (name == UPLINK_POLICY_NAMES[i]) {
+            uplinkPolicy = (UplinkPolicy)i;
+            saveConfig();
+            Serial.println("[observer] cfg uplink policy updated");
+          }
+        }
+      } else if (buffer.startsWith("uplink.drop ")) {
+        uplinkDropTypes = strtoul(buffer.substring(12).c_str(), nullptr, 16);
+        saveConfig();
+        Serial.println("[observer] cfg uplink drop types updated");
+      } else if (buffer.startsWith("uplink.format ")) {
+        String name = buffer.substring(14);
+        for (uint8_t i = 0; i < RECORD_FORMAT_COUNT; i++) {
+          if (name == RECORD_FORMAT_NAMES[i]) {
+            xSemaphoreTake(cfgLock, portMAX_DELAY);
+            recordFormat = (RecordFormat)i;
+            newSession();
+            xSemaphoreGive(cfgLock);
+            saveConfig();
+            Serial.println("[observer] cfg uplink format updated");
+          }
+        }
+      } else if (buffer.startsWith("uplink.session ")) {
+        xSemaphoreTake(cfgLock, portMAX_DELAY);
+        sessionRecords = buffer.substring(15) == "on";
+        newSession();
+        xSemaphoreGive(cfgLock);
+        saveConfig();
+        Serial.println("[observer] cfg uplink session updated");
+      } else if (buffer.startsWith("uplink.hash ")) {
+        xSemaphoreTake(cfgLock, portMAX_DELAY);
+        hashBytes = buffer.substring(12).toInt() == 16 ? 16 : 32;
+        newSession();
+        xSemaphoreGive(cfgLock);
+        saveConfig();
+        Serial.println("[observer] cfg uplink hash updated");
+      } else if (buffer.startsWith("uplink.batch ")) {
+        String name = buffer.substring(13);
+        for (uint8_t i = 0; i < BATCH_FORMAT_COUNT; i++) {
+          if (name == BATCH_FORMAT_NAMES[i]) {
+            batchFormat = (BatchFormat)i;
+            saveConfig();
+            Serial.println("[observer] cfg uplink batch updated");
+          }
+        }
+      } else if (buffer.startsWith("uplink.batch.n ")) {
+        batchMaxRecords = constrain(buffer.substring(15).toInt(), 1, BATCH_RECORDS_LIMIT);
+        saveConfig();
+        Serial.println("[observer] cfg uplink batch size updated");
+      } else if (buffer.startsWith("uplink.batch.ms ")) {
+        batchMaxMs = buffer.substring(16).toInt();
+        saveConfig();
+        Serial.println("[observer] cfg uplink batch window updated");
+      } else if (buffer.startsWith("uplink.compress ")) {
+        batchCompress = buffer.substring(16) == "on";
+        saveConfig();
+        Serial.println("[observer] cfg uplink compress updated");
+      } else if (buffer == "uplink") {
+        printUplinkStats();
+      } else if (buffer.startsWith("spool.commit.bytes ")) {
+        xSemaphoreTake(spoolLock, portMAX_DELAY);
+        spoolCommitBytes = buffer.substring(19).toInt();
+        spool.setCommit(spoolCommitBytes, spoolCommitMs);
+        xSemaphoreGive(spoolLock);
+        saveConfig();
+        Serial.println("[observer] cfg spool commit size updated");
+      } else if (buffer.startsWith("spool.commit.ms ")) {
+        xSemaphoreTake(spoolLock, portMAX_DELAY);
+        spoolCommitMs = buffer.substring(16).toInt();
+        spool.setCommit(spoolCommitBytes, spoolCommitMs);
+        xSemaphoreGive(spoolLock);
+        saveConfig();
+        Serial.println("[observer] cfg spool commit window updated");
+      } else if (buffer.startsWith("spool.drain.n ")) {
+        spoolDrainRecords = constrain(buffer.substring(14).toInt(), 1, 255);
+        saveConfig();
+        Serial.println("[observer] cfg spool drain slice updated");
+      } else if (buffer.startsWith("spool.drain.bytes ")) {
+        spoolDrainBytes = max(1L, buffer.substring(18).toInt());
+        saveConfig();
+        Serial.println("[observer] cfg spool drain slice bytes updated");
+      } else if (buffer.startsWith("spool.drain.bps ")) {
+        spoolDrainBps = buffer.substring(16).toInt();
+        saveConfig();
+        Serial.println("[observer] cfg spool drain rate updated");
+      } else if (buffer.startsWith("spool.ram.fill ")) {
+        spoolRamFillPct = constrain(buffer.substring(15).toInt(), 1, 100);
+        saveConfig();
+        Serial.println("[observer] cfg spool ram fill updated");
+      } else if (buffer.startsWith("spool.ram.age ")) {
+        spoolRamAgeMs = buffer.substring(14).toInt();
+        saveConfig();
+        Serial.println("[observer] cfg spool ram age updated");
+      } else if (buffer == "spool") {
+        printSpoolStats();
+      } else if (buffer == "link") {
+        printLinkStats();
+      } else if (buffer == "jobs") {
+        printJobStats();
+      } else if (buffer == "tasks") {
+        printTaskStats();
+      } else if (buffer == "bench") {
+        runHashBench();
       }
       buffer = "";
       continue;
@@ -333,16 +1539,249 @@ static inline void handleSerialConfig() {
 #endif
 }
 
+// ================= HOUSEKEEPING =================
+// Low-priority periodic work, run by the ui task under a deadline
+// scheduler. Each job has a period and a slice budget; late finishes and
+// blown slices are counted per job ('jobs' serial command). The radio
+// tasks sit above all of this, so none of it can delay a capture.
+static void serialJob(int64_t sliceEndUs) {
+  handleSerialConfig(sliceEndUs);
+}
+
+static void wifiJob(int64_t) {
+  if (WiFi.status() == WL_CONNECTED && !wifiWasConnected) {
+    wifiWasConnected = true;
+    Serial.print("[observer] wifi connected ip=");
+    Serial.println(WiFi.localIP());
+    displayDirty = true;
+  }
+
+  if (WiFi.status() != WL_CONNECTED && wifiWasConnected) {
+    wifiWasConnected = false;
+    Serial.println("[observer] wifi disconnected");
+    displayDirty = true;
+  }
+}
+
+static void displayJob(int64_t) {
+  renderDisplay();
+  displayDirty = false;
+}
+
+static bool displayUrgent() {
+  return displayReady && displayDirty;
+}
+
+// Time-based group commit of the spool buffer, and the RAM tier's spill to
+// flash: once the ring crosses the fill threshold, or its oldest record
+// reaches the age limit while the link is down, the outage counts as
+// sustained and the ring moves to flash SPOOL_RAM_SPILL_BYTES per run until
+// it is empty or the link is back.
+static void spoolJob(int64_t) {
+  if (!spoolMounted || xSemaphoreTake(spoolLock, 0) != pdTRUE) return;
+  uint32_t now = millis();
+  bool linkUp = linkState == LINK_UP;
+  if (!spoolRamSpilling && spoolRam.records() &&
+      (spoolRam.bytes() * 100 >= spoolRam.capacity() * spoolRamFillPct ||
+       (!linkUp && now - spoolRam.oldestMs() >= spoolRamAgeMs))) {
+    spoolRamSpilling = true;
+    tierStats.spills++;
+  }
+  if (spoolRamSpilling) {
+    spillRam(SPOOL_RAM_SPILL_BYTES);
+    if (!spoolRam.records() || linkUp) spoolRamSpilling = false;
+  }
+  spool.service(now);
+  xSemaphoreGive(spoolLock);
+}
+
+Job housekeepingJobs[] = {
+  {"serial", 20000, 2000, serialJob, nullptr, {}},
+  {"wifi", 250000, 1000, wifiJob, nullptr, {}},
+  {"display", 3000000, 40000, displayJob, displayUrgent, {}},
+  {"spool", 250000, 30000, spoolJob, nullptr, {}},
+};
+JobScheduler housekeeping(housekeepingJobs, sizeof(housekeepingJobs) / sizeof(housekeepingJobs[0]), esp_timer_get_time);
+
+static inline void printJobStats() {
+  Serial.printf("{\"rxWakeMaxUs\":%u,\"rxWakeLate\":%u,\"rxBoundUs\":%u}\n",
+                (unsigned)rxStats.wakeMaxUs, (unsigned)rxStats.wakeLate, (unsigned)OBSERVER_RX_LATENCY_BOUND_US);
+  for (size_t i = 0; i < housekeeping.size(); i++) {
+    const Job &j = housekeeping.job(i);
+    Serial.printf("{\"job\":\"%s\",\"periodUs\":%u,\"sliceUs\":%u,\"runs\":%u,\"misses\":%u,\"overruns\":%u,\"maxRunUs\":%u}\n",
+                  j.name, (unsigned)j.periodUs, (unsigned)j.sliceUs, (unsigned)j.stats.runs,
+                  (unsigned)j.stats.misses, (unsigned)j.stats.overruns, (unsigned)j.stats.maxRunUs);
+  }
+}
+
+// ================= TASKS =================
+static inline void serviceNetwork() {
+  bool wifiUp = WiFi.status() == WL_CONNECTED;
+  switch (linkState) {
+    case LINK_OFFLINE:
+      if (wifiUp) {
+        linkRetryAtMs = millis();
+        setLinkState(LINK_BACKOFF);
+      }
+      break;
+    case LINK_BACKOFF:
+      if (!wifiUp) {
+        setLinkState(LINK_OFFLINE);
+      } else if ((long)(millis() - linkRetryAtMs) >= 0) {
+        connDone = false;
+        linkAttempts++;
+        setLinkState(LINK_CONNECTING);
+        xTaskNotifyGive(taskStats[TASK_CONN].handle);
+      }
+      break;
+    case LINK_CONNECTING:
+      if (!connDone) break;
+      if (connOk) {
+        linkBackoffMs = 0;
+        setLinkState(LINK_UP);
+        restartSpoolDrain();
+      } else {
+        linkFailures++;
+        scheduleRetry();
+        Serial.printf("[observer] mqtt connect failed rc=%d retry in %lums\n",
+                      mqttClient.state(), linkRetryAtMs - millis());
+      }
+      break;
+    case LINK_UP:
+      if (wifiUp && mqttClient.loop()) break;
+      mqttClient.disconnect();
+      if (wifiUp) {
+        scheduleRetry();
+      } else {
+        setLinkState(LINK_OFFLINE);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Runs one DNS lookup + TLS/MQTT handshake per notification from the net
+// task and reports the outcome through connDone/connOk.
+static void connTask(void *) {
+  TaskStats &self = taskStats[TASK_CONN];
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t startUs = esp_timer_get_time();
+    IPAddress ip;
+    bool ok = WiFi.hostByName(mqttHost.c_str(), ip) == 1;
+    if (ok) {
+      String clientId = "obs-" + observerId;
+      if (mqttUser.length()) {
+        ok = mqttClient.connect(clientId.c_str(), mqttUser.c_str(), mqttPass.c_str());
+      } else {
+        ok = mqttClient.connect(clientId.c_str());
+      }
+    }
+    connOk = ok;
+    connDone = true;
+    taskBusy(self, startUs);
+    xTaskNotifyGive(taskStats[TASK_UPLINK].handle);
+  }
+}
+
+static void rxTask(void *) {
+  TaskStats &self = taskStats[TASK_RX];
+  for (;;) {
+    // A count above one means DIO1 fired again before the last frame was
+    // read; the SX1262 FIFO only ever holds the newest frame.
+    uint32_t irqs = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (irqs > 1) rxStats.irqMissed += irqs - 1;
+    int64_t startUs = esp_timer_get_time();
+    if (captureFrame()) xTaskNotifyGive(taskStats[TASK_PROC].handle);
+    taskBusy(self, startUs);
+  }
+}
+
+static void procTask(void *) {
+  TaskStats &self = taskStats[TASK_PROC];
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t startUs = esp_timer_get_time();
+    while (const RxFrame *frame = rxRing.peek()) {
+      processFrame(*frame);
+      rxRing.release();
+    }
+    taskBusy(self, startUs);
+  }
+}
+
+static void uplinkTask(void *) {
+  TaskStats &self = taskStats[TASK_UPLINK];
+  static UplinkQueue::Record rec;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    int64_t startUs = esp_timer_get_time();
+    serviceNetwork();
+    while (uplinkQueue.pop(rec)) sendRecord(rec);
+    serviceSpill();
+    serviceSpoolDrain();
+    serviceBatch();
+    serviceStats();
+    serviceSession();
+    taskBusy(self, startUs);
+  }
+}
+
+static void uiTask(void *) {
+  TaskStats &self = taskStats[TASK_UI];
+  housekeeping.begin();
+  for (;;) {
+    int64_t startUs = esp_timer_get_time();
+    int64_t waitUs = housekeeping.runDue();
+    taskBusy(self, startUs);
+    vTaskDelay(max<TickType_t>(1, pdMS_TO_TICKS(waitUs / 1000)));
+  }
+}
+
 // ================= SETUP =================
 void setup() {
   Serial.begin(115200);
   delay(400);
 
+  cfgLock = xSemaphoreCreateMutex();
+  spoolLock = xSemaphoreCreateMutex();
   loadConfig();
+  newSession();
+  size_t ramBytes = OBSERVER_SPOOL_RAM_BYTES;
+  uint8_t *ram = nullptr;
+  if (psramFound()) {
+    ram = (uint8_t *)ps_malloc(OBSERVER_SPOOL_PSRAM_BYTES);
+    spoolRamPsram = ram != nullptr;
+    if (ram) ramBytes = OBSERVER_SPOOL_PSRAM_BYTES;
+  }
+  if (!ram) ram = (uint8_t *)malloc(ramBytes);
+  spoolRam.begin(ram, ram ? ramBytes : 0);
+  spoolMounted = SPIFFS.begin(true);
+  if (spoolMounted) {
+    uint32_t t0 = millis();
+    size_t spooled = spool.begin(0);
+    // The legacy file is removed once imported, so its space counts as free.
+    File legacy = SPIFFS.exists(SPOOL_LEGACY_PATH) ? SPIFFS.open(SPOOL_LEGACY_PATH, FILE_READ) : File();
+    size_t legacyBytes = legacy ? legacy.size() : 0;
+    if (legacy) legacy.close();
+    spool.setCapacity((SPIFFS.totalBytes() - SPIFFS.usedBytes() + spooled + legacyBytes) * OBSERVER_SPOOL_FILL_PCT /
+                      100);
+    spool.importText(SPOOL_LEGACY_PATH);
+    spoolRecoverMs = millis() - t0;
+  }
+  spool.setCommit(spoolCommitBytes, spoolCommitMs);
   Serial.println("[observer] boot");
   Serial.println(String("[observer] fw=") + OBSERVER_FW_VER);
   Serial.print("[observer] ssid=");
   Serial.println(wifiSsid.length() ? wifiSsid : "<empty>");
+  if (!spoolMounted) {
+    Serial.println("[observer] spiffs mount failed, spool disabled");
+  } else {
+    Serial.printf("[observer] spool recovered %u segments in %u ms (torn %u, discarded %u, imported %u)\n",
+                  (unsigned)spool.segmentCount(), (unsigned)spoolRecoverMs, (unsigned)spool.stats().torn,
+                  (unsigned)spool.stats().discarded, (unsigned)spool.stats().imported);
+  }
 
   setVext(true);
   pinMode(OLED_RST, OUTPUT);
@@ -400,10 +1839,17 @@ void setup() {
   if (wifiSsid.length()) {
     WiFi.begin(wifiSsid.c_str(), wifiPass.c_str());
   }
+  // SNTP keeps retrying in the background until WiFi is up; records carry
+  // rxUs (epoch microseconds) once the clock is set.
+  configTime(0, 0, OBSERVER_NTP_SERVER);
 
   tlsClient.setInsecure();
+  tlsClient.setHandshakeTimeout(LINK_HANDSHAKE_TIMEOUT_S);
   mqttClient.setServer(mqttHost.c_str(), mqttPort);
   mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+#if OBSERVER_MQTT5
+  mqttClient.setUserProperty("schema", OBSERVER_SCHEMA_VERSION);
+#endif
 
   SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_CS);
   radio.setTCXO(0.0);
@@ -413,106 +1859,17 @@ void setup() {
   if (state != RADIOLIB_ERR_NONE) {
     while (true) delay(1000);
   }
+  startTask(uplinkTask, taskStats[TASK_UPLINK]);
+  startTask(procTask, taskStats[TASK_PROC]);
+  startTask(uiTask, taskStats[TASK_UI]);
+  startTask(connTask, taskStats[TASK_CONN]);
+  startTask(rxTask, taskStats[TASK_RX]);
   radio.setDio1Action(onDio1);
   radio.startReceive();
 }
 
 // ================= LOOP =================
+// All work runs in the pinned tasks started from setup().
 void loop() {
-  handleSerialConfig();
-
-  if (WiFi.status() == WL_CONNECTED && !wifiWasConnected) {
-    wifiWasConnected = true;
-    Serial.print("[observer] wifi connected ip=");
-    Serial.println(WiFi.localIP());
-    displayDirty = true;
-  }
-
-  if (WiFi.status() != WL_CONNECTED && wifiWasConnected) {
-    wifiWasConnected = false;
-    Serial.println("[observer] wifi disconnected");
-    displayDirty = true;
-  }
-
-  if (WiFi.status() == WL_CONNECTED && !mqttClient.connected()) {
-    String clientId = "obs-" + observerId;
-    if (mqttUser.length()) {
-      mqttClient.connect(clientId.c_str(), mqttUser.c_str(), mqttPass.c_str());
-    } else {
-      mqttClient.connect(clientId.c_str());
-    }
-    if (mqttClient.connected()) {
-      if (!mqttWasConnected) {
-        mqttWasConnected = true;
-        Serial.print("[observer] mqtt connected ");
-        Serial.print(mqttHost);
-        Serial.print(":");
-        Serial.println(mqttPort);
-        displayDirty = true;
-      }
-      spoolFlush();
-    }
-  }
-  if (!mqttClient.connected() && mqttWasConnected) {
-    mqttWasConnected = false;
-    Serial.println("[observer] mqtt disconnected");
-    displayDirty = true;
-  }
-  mqttClient.loop();
-
-  if (displayReady && (displayDirty || millis() - lastDisplayMs > 3000)) {
-    renderDisplay();
-    displayDirty = false;
-    lastDisplayMs = millis();
-  }
-
-  if (!takeRxFlag()) {
-    delay(2);
-    return;
-  }
-
-  uint8_t buf[255];
-  int reportedLen = radio.getPacketLength();
-  int len = reportedLen;
-  if (len <= 0) len = (int)sizeof(buf);
-  if (len > (int)sizeof(buf)) len = sizeof(buf);
-
-  float rssi = radio.getRSSI();
-  float snr = radio.getSNR();
-  int state = radio.readData(buf, len);
-  int ptype = (len > 0) ? buf[0] : -1;
-  Serial.printf("[observer] rx len=%d rssi=%.1f snr=%.2f crc=%s\n",
-                len, rssi, snr, (state == RADIOLIB_ERR_NONE ? "ok" : "bad"));
-
-  String frameHash = sha256Hex(buf, len);
-  char payloadHex[512];
-  if ((size_t)len * 2 >= sizeof(payloadHex)) len = (sizeof(payloadHex) / 2) - 1;
-  toHex(buf, len, payloadHex);
-
-  String json = String("{\"observerId\":\"") + observerId +
-                "\",\"observerName\":\"" + observerName +
-                "\",\"ts\":" + String(millis()) +
-                ",\"ptype\":" + String(ptype) +
-                ",\"crc\":" + String(state == RADIOLIB_ERR_NONE ? "true" : "false") +
-                ",\"rssi\":" + String(rssi, 1) +
-                ",\"snr\":" + String(snr, 2) +
-                ",\"reported_len\":" + String(reportedLen) +
-                ",\"len\":" + String(len) +
-                ",\"payloadHex\":\"" + String(payloadHex) +
-                "\",\"frameHash\":\"" + frameHash + "\"";
-  if (observerLat != 0.0f || observerLon != 0.0f) {
-    json += ",\"gps\":{\"lat\":" + String(observerLat, 6) + ",\"lon\":" + String(observerLon, 6) + "}";
-  }
-  json += "}";
-
-  if (mqttClient.connected()) {
-    if (!mqttClient.publish(String("meshrank/observers/" + observerId + "/packets").c_str(), json.c_str())) {
-      Serial.printf("[observer] mqtt publish failed len=%d\n", json.length());
-    }
-  } else {
-    spoolAppend(json);
-  }
-
-  radio.startReceive();
-  delay(2);
+  vTaskDelete(nullptr);
 }
@@ -0,0 +1,163 @@
+// tools/fingerprint/fp_report.cpp
+//
+// Runs every fingerprint policy in lib/fingerprint over a capture and
+// reports, per hash family and covered range, how many distinct frames end
+// up sharing a fingerprint, and how fast each hash is.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/fingerprint tools/fingerprint/fp_report.cpp -o fp_report
+//
+// Usage:
+//   fp_report [--all] [--rounds N] [rf.ndjson]
+//
+// Reads the sniffer's rf lines ("hex") or observer records ("payloadHex").
+// Frames with "crc":false are skipped unless --all is given.
+//
+// Columns:
+//   inputs     distinct covered byte strings
+//   collide    distinct covered inputs sharing a fingerprint (true hash
+//              collisions; expected 0 for a 64-bit hash on any real corpus)
+//   merged     distinct frames sharing a fingerprint with another frame;
+//              for nopath that is intended (same packet, different path)
+//   ns/frame   mean hashing time over the corpus, --rounds passes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "fingerprint.h"
+
+typedef std::vector<uint8_t> Frame;
+
+// Keeps the timed loop from being optimized away.
+static volatile uint64_t benchSink;
+
+static int nibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Pulls the payload out of one JSON line without a JSON parser: both
+// record kinds write it as a plain upper-case hex string.
+static bool parseLine(const std::string &line, bool all, Frame &out) {
+  if (!all && line.find("\"crc\":false") != std::string::npos) return false;
+  size_t at = line.find("\"payloadHex\":\"");
+  size_t skip = 14;
+  if (at == std::string::npos) {
+    at = line.find("\"hex\":\"");
+    skip = 7;
+  }
+  if (at == std::string::npos) return false;
+  at += skip;
+  size_t end = line.find('"', at);
+  if (end == std::string::npos || (end - at) % 2 || end == at || end - at > 510) return false;
+  out.clear();
+  for (size_t i = at; i < end; i += 2) {
+    int hi = nibble(line[i]), lo = nibble(line[i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out.push_back((uint8_t)(hi << 4 | lo));
+  }
+  return true;
+}
+
+static std::string covered(const Frame &f, FpRange range) {
+  uint8_t buf[256];
+  switch (range) {
+    case FP_PREFIX20:
+      return std::string((const char *)f.data(), f.size() < 20 ? f.size() : 20);
+    case FP_NO_PATH:
+      return std::string((const char *)buf, fpStripPath(f.data(), f.size(), buf));
+    default:
+      return std::string((const char *)f.data(), f.size());
+  }
+}
+
+template <class Hash>
+static void report(const std::vector<Frame> &frames, int rounds) {
+  for (int r = 0; r < FP_RANGE_COUNT; r++) {
+    FpRange range = (FpRange)r;
+    std::unordered_map<uint64_t, std::string> byFp;
+    std::unordered_set<std::string> inputs;
+    unsigned long collide = 0;
+    std::unordered_map<uint64_t, unsigned long> framesPerFp;
+    for (const Frame &f : frames) {
+      uint64_t fp = Fingerprint<Hash>::of(f.data(), f.size(), range);
+      std::string in = covered(f, range);
+      if (inputs.insert(in).second) {
+        auto it = byFp.find(fp);
+        if (it == byFp.end()) byFp.emplace(fp, in);
+        else if (it->second != in) collide++;
+      }
+      framesPerFp[fp]++;
+    }
+    unsigned long merged = frames.size() - framesPerFp.size();
+
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      for (const Frame &f : frames) sink ^= Fingerprint<Hash>::of(f.data(), f.size(), range);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double perFrame = frames.empty() ? 0.0 : ns / ((double)frames.size() * rounds);
+
+    benchSink = sink;
+
+    printf("%-8s %-9s %9zu %8lu %8lu %9.1f\n", Hash::name(), FP_RANGE_NAMES[range], inputs.size(), collide,
+           merged, perFrame);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool all = false;
+  int rounds = 20;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--all")) all = true;
+    else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) rounds = atoi(argv[++i]);
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: fp_report [--all] [--rounds N] [rf.ndjson]\n");
+      return 2;
+    } else path = argv[i];
+  }
+  if (rounds < 1) rounds = 1;
+  FILE *in = path ? fopen(path, "r") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+
+  // Distinct frames only: the corpus repeats every packet once per hop
+  // heard, and only distinct content can collide.
+  std::vector<Frame> frames;
+  std::unordered_set<std::string> seen;
+  unsigned long lines = 0;
+  std::string line;
+  Frame f;
+  int c;
+  do {
+    c = fgetc(in);
+    if (c != '\n' && c != EOF) {
+      line += (char)c;
+      continue;
+    }
+    if (!line.empty()) {
+      lines++;
+      if (parseLine(line, all, f) && seen.insert(std::string(f.begin(), f.end())).second) frames.push_back(f);
+    }
+    line.clear();
+  } while (c != EOF);
+  if (in != stdin) fclose(in);
+
+  printf("lines=%lu distinctFrames=%zu rounds=%d\n", lines, frames.size(), rounds);
+  printf("%-8s %-9s %9s %8s %8s %9s\n", "hash", "range", "inputs", "collide", "merged", "ns/frame");
+  report<Fnv1a64>(frames, rounds);
+  report<XxHash64>(frames, rounds);
+  report<WyHash>(frames, rounds);
+  report<SipHash24>(frames, rounds);
+  return 0;
+}
@@ -0,0 +1,135 @@
+// tools/frame_ring/ring_stress.cpp
+//
+// Drives lib/frame_ring from two threads the way the observer does: a
+// producer (the RX task) fills slots in place and commits them, a consumer
+// (the proc task) reads them in place and releases them. Every frame
+// carries a sequence number and a payload derived from it, so the consumer
+// can check that it sees each committed frame exactly once, in order, and
+// never a slot the producer is still writing. Frames the producer cannot
+// place because the ring is full are skipped, as in the firmware, and must
+// match the ring's overflow counter.
+//
+// Build (ThreadSanitizer checks the memory ordering):
+//   g++ -O1 -g -std=c++17 -fsanitize=thread -I lib/frame_ring tools/frame_ring/ring_stress.cpp -o ring_stress -lpthread
+//
+// Usage:
+//   ring_stress [--frames N] [--slow-every N]
+//
+// --slow-every makes the consumer pause every N frames so the ring fills
+// and overflows (default 4096; 0 never pauses). Exits 1 on any mismatch.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "frame_ring.h"
+
+#define RING_SLOTS 16
+
+struct Options {
+  uint32_t frames = 1000000;
+  uint32_t slowEvery = 4096;
+};
+
+static FrameRing<RING_SLOTS> ring;
+static std::atomic<bool> started{false};
+static std::atomic<bool> producerDone{false};
+
+static uint8_t payloadByte(uint32_t seq, int i) { return (uint8_t)(seq * 31 + i * 7); }
+
+static void produce(const Options &o, uint32_t &skipped) {
+  while (!started.load(std::memory_order_acquire)) std::this_thread::yield();
+  for (uint32_t seq = 0; seq < o.frames; seq++) {
+    RxFrame *slot = ring.acquire();
+    if (!slot) {
+      // The next DIO1 is at least an airtime away; let the consumer run.
+      skipped++;
+      std::this_thread::yield();
+      continue;
+    }
+    int len = 1 + seq % sizeof(slot->data);
+    memcpy(slot->data, &seq, sizeof(seq));
+    for (int i = sizeof(seq); i < len; i++) slot->data[i] = payloadByte(seq, i);
+    slot->len = (int16_t)len;
+    slot->captureUs = seq;
+    ring.commit();
+  }
+  producerDone.store(true, std::memory_order_release);
+}
+
+static bool consume(const Options &o, uint32_t &received) {
+  uint32_t last = 0;
+  bool first = true, ok = true;
+  while (!started.load(std::memory_order_acquire)) std::this_thread::yield();
+  for (;;) {
+    const RxFrame *f = ring.peek();
+    if (!f) {
+      if (producerDone.load(std::memory_order_acquire) && !ring.peek()) break;
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t seq;
+    memcpy(&seq, f->data, sizeof(seq));
+    int len = 1 + seq % sizeof(f->data);
+    if (!first && seq <= last) {
+      fprintf(stderr, "  frame %u after %u\n", (unsigned)seq, (unsigned)last);
+      ok = false;
+    }
+    if (f->len != len || f->captureUs != seq) {
+      fprintf(stderr, "  frame %u: torn slot header\n", (unsigned)seq);
+      ok = false;
+    }
+    for (int i = sizeof(seq); i < len; i++) {
+      if (f->data[i] != payloadByte(seq, i)) {
+        fprintf(stderr, "  frame %u: torn payload at byte %d\n", (unsigned)seq, i);
+        ok = false;
+        break;
+      }
+    }
+    ring.release();
+    first = false;
+    last = seq;
+    received++;
+    if (o.slowEvery && received % o.slowEvery == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    if (!ok) break;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--frames") && more) o.frames = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(a, "--slow-every") && more) o.slowEvery = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else {
+      fprintf(stderr, "usage: ring_stress [--frames N] [--slow-every N]\n");
+      return 2;
+    }
+  }
+  uint32_t skipped = 0, received = 0;
+  bool ok = true;
+  std::thread consumer([&] { ok = consume(o, received); });
+  std::thread producer([&] { produce(o, skipped); });
+  started.store(true, std::memory_order_release);
+  producer.join();
+  consumer.join();
+  if (received + skipped != o.frames) {
+    fprintf(stderr, "  %u received + %u skipped != %u produced\n", (unsigned)received, (unsigned)skipped,
+            (unsigned)o.frames);
+    ok = false;
+  }
+  if (ring.overflows() != skipped) {
+    fprintf(stderr, "  overflow counter %u, producer skipped %u\n", (unsigned)ring.overflows(), (unsigned)skipped);
+    ok = false;
+  }
+  if (ring.highWater() > RING_SLOTS || ring.size() != 0) {
+    fprintf(stderr, "  high water %u, %u left in the ring\n", (unsigned)ring.highWater(), (unsigned)ring.size());
+    ok = false;
+  }
+  printf("frames=%u received=%u overflows=%u hwm=%u/%u  %s\n", (unsigned)o.frames, (unsigned)received,
+         (unsigned)ring.overflows(), (unsigned)ring.highWater(), RING_SLOTS, ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// tools/hex_codec/hex_bench.cpp
+//
+// Two measurements for the sniffer's output path (src/main.cpp):
+//
+// Encoder: hexEncode() from lib/hex_codec against the printHex() it
+// replaced, which made a Serial.print() call per byte (plus one for the
+// leading zero) through Arduino's Print::printNumber(). Print calls go to
+// a counting sink here, so the table shows host ns per frame and Print
+// calls per frame. Both must give the same characters as printf("%02X").
+//
+// IRQ to re-arm: what the SNIFFER_TIMING=1 build reports as "rearm_us",
+// simulated for three versions of the sniffer on back-to-back frames:
+//
+//   poll-loop     the baseline: loop() polls rxFlag every 2 ms, prints the
+//                 record field by field, then calls startReceive()
+//   rx-task       the RX task re-arms before the record is printed; loop()
+//                 still prints about twenty fields and two calls per byte
+//                 straight into the 128-byte UART FIFO
+//   single-write  as now: loop() builds the line with JsonWriter and hands
+//                 it to a 2 KB TX buffer in one Serial.write
+//
+// loopUs is how long loop() is busy per record, queueDrops the frames the
+// RX task could not queue, missed the frames the radio was deaf for. The
+// radio model and the capture costs are rx_sim's; the UART costs are
+// UART_CALL_US per driver call and 10 bits per byte at the line rate.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/hex_codec -I lib/json_writer -I lib/obs_record -I lib/rf_record tools/hex_codec/hex_bench.cpp -o hex_bench
+//
+// Usage:
+//   hex_bench [--frames N] [--baud B]
+//
+// Exits 1 if the encoders disagree, or if the rx-task versions lose a frame.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
+#include "hex_codec.h"
+#include "rf_record.h"
+
+// Observer radio settings, as in tools/rx_sim.
+#define SIM_SF         8
+#define SIM_BW_HZ      62500.0
+#define SIM_CR         4  // 4/8
+#define SIM_PREAMBLE   8
+#define PREAMBLE_DETECT_SYMBOLS 5
+
+#define WAKE_US        40
+#define READ_US(len)   (120 + (len))
+#define REARM_US       150
+#define POLL_US        2000   // the baseline loop()'s delay(2)
+#define UART_FIFO      128
+#define UART_TX_BUFFER 2048
+#define UART_CALL_US   3      // uart_write_bytes: lock, copy, unlock
+#define RX_QUEUE_DEPTH 8
+#define RECORD_LINE_MAX 1024
+
+struct Options {
+  unsigned frames = 2000;
+  unsigned baud = 115200;
+};
+
+// Enough of Arduino's Print for printHex(): print(char) and
+// print(uint8_t, HEX) as Print::printNumber() writes them.
+struct PrintSink {
+  char *out;
+  size_t calls = 0;
+  void write(const char *s, size_t n) {
+    memcpy(out, s, n);
+    out += n;
+    calls++;
+  }
+  void print(char c) { write(&c, 1); }
+  void printNumber(unsigned long n, uint8_t base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    do {
+      char c = (char)(n % base);
+      n /= base;
+      *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    write(str, strlen(str));
+  }
+};
+
+static void printHex(PrintSink &s, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] < 0x10) s.print('0');
+    s.printNumber(data[i], 16);
+  }
+}
+
+static bool checkEncoders() {
+  uint8_t all[256];
+  for (int i = 0; i < 256; i++) all[i] = (uint8_t)i;
+  char table[513], print[513], ref[513];
+  for (int i = 0; i < 256; i++) snprintf(ref + 2 * i, 3, "%02X", i);
+  hexEncode(all, sizeof(all), table)[0] = '\0';
+  PrintSink s{print};
+  printHex(s, all, sizeof(all));
+  *s.out = '\0';
+  if (strcmp(table, ref) || strcmp(print, ref)) {
+    fprintf(stderr, "  encoders disagree with %%02X\n");
+    return false;
+  }
+  return true;
+}
+
+static void benchEncoder(int len) {
+  std::mt19937 rng(len);
+  uint8_t data[255];
+  for (int i = 0; i < len; i++) data[i] = (uint8_t)rng();
+  static char out[512];
+  const int reps = 200000;
+  size_t calls = 0;
+  volatile char sink = 0;
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; r++) {
+    PrintSink s{out};
+    data[0] = (uint8_t)r;
+    printHex(s, data, len);
+    calls = s.calls;
+    sink = sink + out[r % (2 * len)];
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; r++) {
+    data[0] = (uint8_t)r;
+    hexEncode(data, len, out);
+    sink = sink + out[r % (2 * len)];
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  double printNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / reps;
+  double tableNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / reps;
+  printf("%5d %12.0f %11zu %12.0f %11d %8.1fx\n", len, printNs, calls, tableNs, 1, printNs / tableNs);
+}
+
+enum Build { POLL_LOOP, RX_TASK, SINGLE_WRITE };
+static const char *const BUILD_NAMES[] = {"poll-loop", "rx-task", "single-write"};
+
+struct Result {
+  unsigned missed = 0;
+  unsigned queueDrops = 0;
+  double rearmMaxUs = 0;
+  double loopMaxUs = 0;
+  size_t lineBytes = 0;
+};
+
+static double airtimeUs(int len) {
+  double sym = (1 << SIM_SF) / SIM_BW_HZ * 1e6;
+  int de = sym > 16000 ? 1 : 0;
+  double n = ceil((8.0 * len - 4 * SIM_SF + 28 + 16) / (4.0 * (SIM_SF - 2 * de)));
+  if (n < 0) n = 0;
+  return (SIM_PREAMBLE + 4.25) * sym + (8 + n * (SIM_CR + 4)) * sym;
+}
+
+// The rf line for a len-byte frame and the Print calls the field-by-field
+// version made for it: two per fixed field, one for the opening brace and
+// the closing quote, one or two per payload byte.
+static size_t lineFor(int len, const uint8_t *payload, size_t &calls) {
+  RfRecord r = {};
+  r.ts = 123456;
+  r.rssiDeci = -835;
+  r.snrCenti = 525;
+  r.reportedLen = (uint16_t)len;
+  r.len = (uint16_t)len;
+  r.fp = 0x0123456789ABCDEFULL;
+  r.payload = payload;
+  char line[RECORD_LINE_MAX];
+  calls = 3 + 2 * 9;
+  for (int i = 0; i < len; i++) calls += payload[i] < 0x10 ? 2 : 1;
+  return rfRecordJson(r, line, sizeof(line));
+}
+
+// Time a write of n bytes in calls driver calls blocks loop(), given the
+// bytes still queued ahead of it; advances the queue to the end of it.
+static double uartWrite(double &queuedBytes, size_t n, size_t calls, size_t room, double byteUs) {
+  double blocked = std::max(0.0, queuedBytes + n - room) * byteUs;
+  queuedBytes = std::min<double>(queuedBytes + n, room);
+  return blocked + calls * UART_CALL_US;
+}
+
+static Result simulate(const Options &o, int len, Build build) {
+  std::mt19937 rng(len);
+  uint8_t payload[255];
+  for (int i = 0; i < len; i++) payload[i] = (uint8_t)rng();
+  size_t calls;
+  Result r;
+  r.lineBytes = lineFor(len, payload, calls);
+  if (build == SINGLE_WRITE) calls = 1;
+  double byteUs = 10e6 / o.baud;
+  size_t room = build == SINGLE_WRITE ? UART_TX_BUFFER + UART_FIFO : UART_FIFO;
+  double air = airtimeUs(len);
+  double slack = (SIM_PREAMBLE - PREAMBLE_DETECT_SYMBOLS) * (1 << SIM_SF) / SIM_BW_HZ * 1e6;
+
+  double armedAt = 0, loopFree = 0, uartAt = 0, queued = 0;
+  std::deque<double> waiting;  // when loop() takes each queued frame
+  for (unsigned k = 0; k < o.frames; k++) {
+    double start = k * air, end = start + air;
+    if (armedAt > start + slack) {
+      r.missed++;
+      continue;
+    }
+    double irq = end;
+    // Bytes the UART has sent since the last write.
+    auto drainTo = [&](double t) {
+      queued = std::max(0.0, queued - (t - uartAt) / byteUs);
+      uartAt = t;
+    };
+    if (build == POLL_LOOP) {
+      double t = std::max(irq + POLL_US, loopFree);
+      drainTo(t);
+      double loopUs = READ_US(len) + uartWrite(queued, r.lineBytes, calls, room, byteUs);
+      armedAt = t + loopUs + REARM_US;
+      loopFree = armedAt + POLL_US;
+      r.loopMaxUs = std::max(r.loopMaxUs, loopUs);
+    } else {
+      armedAt = irq + WAKE_US + READ_US(len) + REARM_US;
+      while (!waiting.empty() && waiting.front() <= armedAt) waiting.pop_front();
+      if (waiting.size() >= RX_QUEUE_DEPTH) {
+        r.queueDrops++;
+      } else {
+        double t = std::max(armedAt, loopFree);
+        drainTo(t);
+        double loopUs = uartWrite(queued, r.lineBytes, calls, room, byteUs);
+        loopFree = t + loopUs;
+        waiting.push_back(t);
+        r.loopMaxUs = std::max(r.loopMaxUs, loopUs);
+      }
+    }
+    r.rearmMaxUs = std::max(r.rearmMaxUs, armedAt - irq);
+  }
+  return r;
+}
+
+int main(int argc, char **argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--frames") && more) o.frames = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--baud") && more) o.baud = (unsigned)atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: hex_bench [--frames N] [--baud B]\n");
+      return 2;
+    }
+  }
+  if (!o.baud) o.baud = 115200;
+
+  bool ok = checkEncoders();
+  printf("encoder (host ns per frame)\n");
+  printf("%5s %12s %11s %12s %11s %9s\n", "len", "printHex ns", "print calls", "hexEncode ns", "calls", "speedup");
+  const int lens[] = {16, 100, 255};
+  for (int len : lens) benchEncoder(len);
+
+  printf("\nIRQ to re-arm, %u back-to-back frames, SF%d BW%.1fkHz, %u baud\n", o.frames, SIM_SF, SIM_BW_HZ / 1000,
+         o.baud);
+  printf("%5s %9s %-13s %6s %10s %10s %7s %10s  %s\n", "len", "airMs", "build", "line", "rearmMaxUs", "loopMaxUs",
+         "missed", "queueDrops", "");
+  for (int len : lens) {
+    for (Build b : {POLL_LOOP, RX_TASK, SINGLE_WRITE}) {
+      Result r = simulate(o, len, b);
+      bool good = b == POLL_LOOP || (!r.missed && !r.queueDrops);
+      ok = ok && good;
+      printf("%5d %9.1f %-13s %6zu %10.0f %10.0f %7u %10u  %s\n", len, airtimeUs(len) / 1000, BUILD_NAMES[b],
+             r.lineBytes, r.rearmMaxUs, r.loopMaxUs, r.missed, r.queueDrops, good ? "ok" : "FAIL");
+    }
+  }
+  return ok ? 0 : 1;
+}
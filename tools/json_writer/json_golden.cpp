@@ -0,0 +1,358 @@
+// tools/json_writer/json_golden.cpp
+//
+// Golden tests for lib/json_writer against the Arduino String code it
+// replaced in the observer, plus an allocation count per record.
+//
+//  - fixed() must give the same digits as Arduino's String(value, n), which
+//    is dtostrf(value, n + 2, n) (arduino-esp32 WString.cpp and
+//    stdlib_noniso.c; ref_dtostrf below follows it step for step,
+//    including its padding). Checked on a table of literal goldens taken
+//    from observer records, on every RSSI and SNR value the SX1262 can
+//    report, and on random floats.
+//  - A full packet record built with JsonWriter, as jsonRecord() in
+//    src/observer_main.cpp does, must be byte for byte the record built
+//    with the String concatenation chain processFrame() used before, for
+//    random frames in both record layouts (per-record metadata and
+//    session sid/seq).
+//  - Allocations per record are counted for both: the String shim counts
+//    its buffer (re)allocations the way WString's changeBuffer() makes
+//    them, and global operator new is counted too. JsonWriter must make
+//    none.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/json_writer -I lib/hex_codec tools/json_writer/json_golden.cpp -o json_golden
+//
+// Usage:
+//   json_golden [--records N] [--seed S]
+//
+// Exits 1 on the first mismatch, printing both strings.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include "json_writer.h"
+
+static size_t newCalls = 0;
+
+void *operator new(size_t n) {
+  newCalls++;
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// dtostrf() as in arduino-esp32's stdlib_noniso.c.
+static char *ref_dtostrf(double number, signed int width, unsigned int prec, char *s) {
+  bool negative = false;
+  if (isnan(number)) {
+    strcpy(s, "nan");
+    return s;
+  }
+  if (isinf(number)) {
+    strcpy(s, "inf");
+    return s;
+  }
+  char *out = s;
+  int fillme = width;
+  if (prec > 0) fillme -= (prec + 1);
+  if (number < 0.0) {
+    negative = true;
+    fillme--;
+    number = -number;
+  }
+  double rounding = 2.0;
+  for (uint8_t i = 0; i < prec; ++i) rounding *= 10.0;
+  rounding = 1.0 / rounding;
+  number += rounding;
+  double tenpow = 1.0;
+  int digitcount = 1;
+  while (number >= 10.0 * tenpow) {
+    tenpow *= 10.0;
+    digitcount++;
+  }
+  number /= tenpow;
+  fillme -= digitcount;
+  while (fillme-- > 0) *out++ = ' ';
+  if (negative) *out++ = '-';
+  digitcount += prec;
+  int8_t digit = 0;
+  while (digitcount-- > 0) {
+    digit = (int8_t)number;
+    if (digit > 9) digit = 9;
+    *out++ = (char)('0' | digit);
+    if ((digitcount == (int)prec) && (prec > 0)) *out++ = '.';
+    number -= digit;
+    number *= 10.0;
+  }
+  *out = 0;
+  return s;
+}
+
+// Enough of Arduino's String for the old record chain. Like WString, the
+// buffer is reallocated to the exact new length whenever it grows, and
+// operator+ on a temporary appends in place (StringSumHelper).
+static size_t stringAllocs = 0;
+
+class String {
+ public:
+  String(const char *s = "") { assign(s, strlen(s)); }
+  String(const String &o) { assign(o.buf_, o.len_); }
+  String(String &&o) noexcept : buf_(o.buf_), len_(o.len_), cap_(o.cap_) { o.buf_ = nullptr, o.len_ = o.cap_ = 0; }
+  explicit String(unsigned long v) { number("%lu", v); }
+  explicit String(unsigned long long v) { number("%llu", v); }
+  explicit String(long long v) { number("%lld", v); }
+  explicit String(int v) { number("%d", v); }
+  String(float v, unsigned prec) {
+    char tmp[64];
+    ref_dtostrf(v, prec + 2, prec, tmp);
+    assign(tmp, strlen(tmp));
+  }
+  ~String() { free(buf_); }
+  String &operator=(const String &) = delete;
+
+  String &operator+=(const char *s) { return append(s, strlen(s)); }
+  String &operator+=(const String &s) { return append(s.buf_, s.len_); }
+  friend String operator+(String &&a, const char *b) { return std::move(a += b); }
+  friend String operator+(String &&a, const String &b) { return std::move(a += b); }
+  friend String operator+(const char *a, const String &b) { return String(a) + b; }
+
+  const char *c_str() const { return buf_ ? buf_ : ""; }
+  size_t length() const { return len_; }
+
+ private:
+  template <class T>
+  void number(const char *fmt, T v) {
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), fmt, v);
+    assign(tmp, strlen(tmp));
+  }
+  void reserve(size_t n) {
+    if (buf_ && cap_ >= n) return;
+    buf_ = (char *)realloc(buf_, n + 1);
+    cap_ = n;
+    stringAllocs++;
+  }
+  void assign(const char *s, size_t n) {
+    reserve(n);
+    memcpy(buf_, s, n);
+    buf_[len_ = n] = '\0';
+  }
+  String &append(const char *s, size_t n) {
+    reserve(len_ + n);
+    memcpy(buf_ + len_, s, n);
+    buf_[len_ += n] = '\0';
+    return *this;
+  }
+
+  char *buf_ = nullptr;
+  size_t len_ = 0;
+  size_t cap_ = 0;
+};
+
+// The fields jsonRecord() takes from the frame and the observer config.
+struct Frame {
+  uint8_t data[255];
+  int16_t len;
+  int16_t reportedLen;
+  bool crcOk;
+  float rssi;
+  float snr;
+  int64_t captureUs;
+  int64_t rxUs;
+  uint8_t hash[32];
+};
+
+struct Config {
+  std::string observerId;
+  std::string observerName;
+  float lat;
+  float lon;
+  bool sessionRecords;
+  uint32_t sid;
+  uint32_t seq;
+  uint8_t hashBytes;
+};
+
+// The record as the String chain in processFrame() built it, with the
+// fields added since (tsUs, rxUs, session records) written the same way.
+static String stringRecord(const Frame &f, const Config &c) {
+  char payloadHex[512], hashHex[65];
+  hexEncode(f.data, f.len, payloadHex)[0] = '\0';
+  hexEncode(f.hash, c.hashBytes, hashHex)[0] = '\0';
+  int ptype = (f.len > 0) ? f.data[0] : -1;
+  String observerId(c.observerId.c_str()), observerName(c.observerName.c_str());
+  String json = c.sessionRecords ? String("{\"sid\":") + String((unsigned long)c.sid) +
+                                       ",\"seq\":" + String((unsigned long)c.seq)
+                                 : String("{\"observerId\":\"") + observerId +
+                                       "\",\"observerName\":\"" + observerName + "\"";
+  json += String(",\"ts\":") + String((unsigned long)(f.captureUs / 1000)) +
+          ",\"tsUs\":" + String((long long)f.captureUs) +
+          ",\"ptype\":" + String(ptype) +
+          ",\"crc\":" + String(f.crcOk ? "true" : "false") +
+          ",\"rssi\":" + String(f.rssi, 1) +
+          ",\"snr\":" + String(f.snr, 2) +
+          ",\"reported_len\":" + String((int)f.reportedLen) +
+          ",\"len\":" + String((int)f.len) +
+          ",\"payloadHex\":\"" + String(payloadHex) +
+          "\",\"frameHash\":\"" + String(hashHex) + "\"";
+  if (f.rxUs) json += String(",\"rxUs\":") + String((long long)f.rxUs);
+  if (!c.sessionRecords && (c.lat != 0.0f || c.lon != 0.0f)) {
+    json += ",\"gps\":{\"lat\":" + String(c.lat, 6) + ",\"lon\":" + String(c.lon, 6) + "}";
+  }
+  json += "}";
+  return json;
+}
+
+// jsonRecord() from src/observer_main.cpp.
+static size_t writerRecord(const Frame &f, const Config &c, char *out, size_t cap) {
+  int ptype = (f.len > 0) ? f.data[0] : -1;
+  JsonWriter w(out, cap);
+  if (c.sessionRecords) {
+    w.raw("{\"sid\":").u64(c.sid).raw(",\"seq\":").u64(c.seq);
+  } else {
+    w.raw("{\"observerId\":\"").text(c.observerId.c_str(), c.observerId.size())
+     .raw("\",\"observerName\":\"").text(c.observerName.c_str(), c.observerName.size()).raw("\"");
+  }
+  w.raw(",\"ts\":").u64((unsigned long)(f.captureUs / 1000))
+   .raw(",\"tsUs\":").i64(f.captureUs)
+   .raw(",\"ptype\":").i64(ptype)
+   .raw(",\"crc\":").boolean(f.crcOk)
+   .raw(",\"rssi\":").fixed(f.rssi, 1)
+   .raw(",\"snr\":").fixed(f.snr, 2)
+   .raw(",\"reported_len\":").i64(f.reportedLen)
+   .raw(",\"len\":").i64(f.len)
+   .raw(",\"payloadHex\":\"").hex(f.data, f.len)
+   .raw("\",\"frameHash\":\"").hex(f.hash, c.hashBytes).raw("\"");
+  if (f.rxUs) w.raw(",\"rxUs\":").i64(f.rxUs);
+  if (!c.sessionRecords && (c.lat != 0.0f || c.lon != 0.0f)) {
+    w.raw(",\"gps\":{\"lat\":").fixed(c.lat, 6).raw(",\"lon\":").fixed(c.lon, 6).raw("}");
+  }
+  w.raw("}");
+  return w.ok() ? w.size() : 0;
+}
+
+static bool checkFixed(double v, unsigned prec, const char *expect = nullptr) {
+  char ref[64], buf[64];
+  String s((float)v, prec);
+  ref_dtostrf(v, prec + 2, prec, ref);
+  JsonWriter w(buf, sizeof(buf));
+  w.fixed(v, prec);
+  const char *want = expect ? expect : ref;
+  // String(float) narrows to float first, as the firmware's float fields do.
+  if (strcmp(buf, want) || (expect && (float)v == v && strcmp(s.c_str(), want))) {
+    fprintf(stderr, "fixed(%.9g, %u) = \"%s\", dtostrf \"%s\"%s%s\n", v, prec, buf, ref,
+            expect ? ", golden " : "", expect ? expect : "");
+    return false;
+  }
+  return true;
+}
+
+struct Golden {
+  double value;
+  unsigned prec;
+  const char *expect;
+};
+
+// Values and the digits the String-built observer records carried.
+static const Golden GOLDEN[] = {
+    {-83.0f, 1, "-83.0"},         {-57.0f, 1, "-57.0"},       {-120.5f, 1, "-120.5"},
+    {-13.5f, 2, "-13.50"},        {5.25f, 2, "5.25"},         {-0.25f, 2, "-0.25"},
+    {0.0f, 1, "0.0"},             {-0.0f, 1, "0.0"},          {-0.04f, 1, "-0.0"},
+    {1.999, 2, "2.00"},           {9.96, 1, "10.0"},          {47.123456f, 6, "47.123455"},
+    {-122.5f, 6, "-122.500000"},  {51.5f, 6, "51.500000"},    {-0.12f, 6, "-0.120000"},
+    {NAN, 1, "nan"},              {INFINITY, 2, "inf"},       {-INFINITY, 2, "inf"},
+};
+
+int main(int argc, char **argv) {
+  unsigned records = 20000, seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--records") && i + 1 < argc) records = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: json_golden [--records N] [--seed S]\n");
+      return 2;
+    }
+  }
+
+  // Literal goldens, then every value getRSSI() (half dBm steps) and
+  // getSNR() (quarter dB steps) can return, then random floats.
+  size_t fixedChecks = 0;
+  for (const Golden &g : GOLDEN) {
+    if (!checkFixed(g.value, g.prec, g.expect)) return 1;
+    fixedChecks++;
+  }
+  for (int half = -320; half <= 0; half++, fixedChecks++) {
+    if (!checkFixed((float)(half / 2.0), 1)) return 1;
+  }
+  for (int quarter = -128; quarter <= 127; quarter++, fixedChecks++) {
+    if (!checkFixed((float)(quarter / 4.0), 2)) return 1;
+  }
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> wide(-1000.0f, 1000.0f), deg(-180.0f, 180.0f);
+  for (unsigned i = 0; i < 200000; i++, fixedChecks += 3) {
+    if (!checkFixed(wide(rng), 1) || !checkFixed(wide(rng), 2) || !checkFixed(deg(rng), 6)) return 1;
+  }
+
+  // Whole records.
+  static const char *names[] = {"Roof", "London North", "", "Obs-7 \xC3\xA9"};
+  size_t stringAllocTotal = 0, stringNewTotal = 0, writerNewTotal = 0, bytes = 0;
+  double stringNs = 0, writerNs = 0;
+  char out[1024];
+  for (unsigned i = 0; i < records; i++) {
+    Frame f = {};
+    Config c;
+    c.observerId = "OBS" + std::to_string(rng() % 1000);
+    c.observerName = names[rng() % 4];
+    c.lat = rng() % 4 ? deg(rng) / 2 : 0.0f;
+    c.lon = c.lat != 0.0f ? deg(rng) : 0.0f;
+    c.sessionRecords = rng() % 2;
+    c.sid = rng();
+    c.seq = rng() % 100000;
+    c.hashBytes = rng() % 2 ? 32 : 16;
+    f.len = (int16_t)(rng() % 256);
+    f.reportedLen = rng() % 8 ? f.len : 0;
+    for (int j = 0; j < f.len; j++) f.data[j] = (uint8_t)rng();
+    for (int j = 0; j < 32; j++) f.hash[j] = (uint8_t)rng();
+    f.crcOk = rng() % 10;
+    f.rssi = (float)(-(int)(rng() % 280)) / 2.0f;
+    f.snr = (float)((int)(rng() % 256) - 128) / 4.0f;
+    f.captureUs = 1700000000000000LL + (int64_t)(rng() % 100000000) * 1000 + rng() % 1000;
+    f.rxUs = rng() % 3 ? f.captureUs + 12 : 0;
+
+    size_t allocs = stringAllocs, news = newCalls;
+    auto t0 = std::chrono::steady_clock::now();
+    String s = stringRecord(f, c);
+    auto t1 = std::chrono::steady_clock::now();
+    stringAllocTotal += stringAllocs - allocs;
+    stringNewTotal += newCalls - news;
+    news = newCalls;
+    auto t2 = std::chrono::steady_clock::now();
+    size_t n = writerRecord(f, c, out, sizeof(out));
+    auto t3 = std::chrono::steady_clock::now();
+    writerNewTotal += newCalls - news;
+    stringNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    writerNs += std::chrono::duration<double, std::nano>(t3 - t2).count();
+    bytes += n;
+    if (n != s.length() || memcmp(out, s.c_str(), n)) {
+      fprintf(stderr, "record %u differs\n  String:     %s\n  JsonWriter: %.*s\n", i, s.c_str(), (int)n, out);
+      return 1;
+    }
+  }
+  if (writerNewTotal) {
+    fprintf(stderr, "JsonWriter allocated %zu times\n", writerNewTotal);
+    return 1;
+  }
+  printf("fixed(): %zu values identical to dtostrf, %zu goldens\n", fixedChecks, sizeof(GOLDEN) / sizeof(GOLDEN[0]));
+  printf("records: %u identical, avg %.0f bytes\n", records, records ? (double)bytes / records : 0.0);
+  printf("%-11s %14s %12s %10s\n", "builder", "allocs/record", "new/record", "ns/record");
+  printf("%-11s %14.1f %12.1f %10.0f\n", "String", (double)stringAllocTotal / records,
+         (double)stringNewTotal / records, stringNs / records);
+  printf("%-11s %14.1f %12.1f %10.0f\n", "JsonWriter", 0.0, (double)writerNewTotal / records, writerNs / records);
+  return 0;
+}
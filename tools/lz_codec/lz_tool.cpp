@@ -0,0 +1,356 @@
+// tools/lz_codec/lz_tool.cpp
+//
+// Host side of the observer's compressed uplink (lib/lz_codec): decompresses
+// what arrives on .../packets/lz and .../packets/bin/lz, benchmarks the codec
+// on a capture, and trains a new preset dictionary from one.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/lz_codec tools/lz_codec/lz_tool.cpp -o lz_tool
+//
+// Usage:
+//   lz_tool decompress [--hex] [file]      one message per file, or one hex
+//                                          line per message (mosquitto_sub -F %x)
+//   lz_tool compress [file]                whole input as one message
+//   lz_tool bench [--batch N] [--hex] [capture]
+//   lz_tool train [--size N] [--id N] [capture] > lz_dict_meshcore.h
+//
+// bench and train read observer packet records, one per line: JSON as
+// published, or binary records as hex with --hex. bench groups them into
+// batches the way the observer does (newline separated JSON, concatenated
+// binary, at most N records and one MQTT buffer) and reports the ratio
+// with and without the preset dictionary and host throughput.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lz_codec.h"
+#include "lz_dict_meshcore.h"
+
+// Observer batches stay below MQTT_BUFFER_SIZE; leave room for anything
+// a host might feed the decompressor.
+#define LZ_TOOL_INPUT_MAX 65536
+#define BATCH_BODY_MAX 2000
+
+typedef LzCodec<LZ_TOOL_INPUT_MAX> Codec;
+
+// Keeps the timed loop from being optimized away.
+static volatile size_t benchSink;
+
+static int nibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static bool fromHex(const std::string &line, std::string &out) {
+  if (line.size() % 2) return false;
+  out.clear();
+  for (size_t i = 0; i < line.size(); i += 2) {
+    int hi = nibble(line[i]), lo = nibble(line[i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out += (char)(hi << 4 | lo);
+  }
+  return true;
+}
+
+static std::vector<std::string> readLines(FILE *in) {
+  std::vector<std::string> lines;
+  std::string line;
+  int c;
+  do {
+    c = fgetc(in);
+    if (c != '\n' && c != EOF) {
+      if (c != '\r') line += (char)c;
+      continue;
+    }
+    if (!line.empty()) lines.push_back(line);
+    line.clear();
+  } while (c != EOF);
+  return lines;
+}
+
+static std::string readAll(FILE *in) {
+  std::string data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) data.append(buf, n);
+  return data;
+}
+
+static Codec *meshcoreCodec() {
+  static Codec codec((const uint8_t *)LZ_DICT_MESHCORE, sizeof(LZ_DICT_MESHCORE) - 1, LZ_DICT_MESHCORE_ID);
+  return &codec;
+}
+
+static Codec *plainCodec() {
+  static Codec codec((const uint8_t *)"", 0, LZ_DICT_MESHCORE_ID);
+  return &codec;
+}
+
+static int runDecompress(FILE *in, bool hex) {
+  std::vector<std::string> messages;
+  if (hex) {
+    for (const std::string &line : readLines(in)) {
+      std::string msg;
+      if (!fromHex(line, msg)) {
+        fprintf(stderr, "skipping line that is not hex\n");
+        continue;
+      }
+      messages.push_back(msg);
+    }
+  } else {
+    messages.push_back(readAll(in));
+  }
+  int bad = 0;
+  for (const std::string &msg : messages) {
+    size_t n;
+    const uint8_t *raw = meshcoreCodec()->decompress((const uint8_t *)msg.data(), msg.size(), n);
+    if (!raw) {
+      bad++;
+      continue;
+    }
+    fwrite(raw, 1, n, stdout);
+    if (hex) fputc('\n', stdout);
+  }
+  if (bad) fprintf(stderr, "%d message(s) failed to decompress (corrupt or another dictionary id)\n", bad);
+  return bad ? 1 : 0;
+}
+
+static int runCompress(FILE *in) {
+  std::string raw = readAll(in);
+  if (raw.size() > LZ_TOOL_INPUT_MAX) {
+    fprintf(stderr, "input larger than %d bytes\n", LZ_TOOL_INPUT_MAX);
+    return 1;
+  }
+  std::vector<uint8_t> out(LZ_BOUND(raw.size()));
+  size_t n = meshcoreCodec()->compress((const uint8_t *)raw.data(), raw.size(), out.data(), out.size());
+  fwrite(out.data(), 1, n, stdout);
+  return n ? 0 : 1;
+}
+
+// Splits the records into observer-sized batches.
+static std::vector<std::string> makeBatches(const std::vector<std::string> &records, bool binary, size_t maxRecords) {
+  std::vector<std::string> batches;
+  std::string body;
+  size_t count = 0;
+  for (const std::string &rec : records) {
+    size_t sep = (!binary && count) ? 1 : 0;
+    if (count && (count >= maxRecords || body.size() + sep + rec.size() > BATCH_BODY_MAX)) {
+      batches.push_back(body);
+      body.clear();
+      count = 0;
+      sep = 0;
+    }
+    if (sep) body += '\n';
+    body += rec;
+    count++;
+  }
+  if (count) batches.push_back(body);
+  return batches;
+}
+
+static void benchCodec(const char *label, Codec *codec, const std::vector<std::string> &batches) {
+  size_t rawBytes = 0, packed = 0;
+  std::vector<uint8_t> out(LZ_BOUND(LZ_TOOL_INPUT_MAX));
+  std::vector<std::vector<uint8_t>> encoded;
+  for (const std::string &b : batches) {
+    size_t n = codec->compress((const uint8_t *)b.data(), b.size(), out.data(), out.size());
+    size_t got;
+    const uint8_t *back = codec->decompress(out.data(), n, got);
+    if (!n || !back || got != b.size() || memcmp(back, b.data(), got)) {
+      fprintf(stderr, "%s: round trip failed on a %zu byte batch\n", label, b.size());
+      exit(1);
+    }
+    encoded.push_back(std::vector<uint8_t>(out.begin(), out.begin() + n));
+    rawBytes += b.size();
+    packed += n;
+  }
+
+  // Repeat until each direction has run for a measurable time.
+  int rounds = 0;
+  double compressNs = 0, decompressNs = 0;
+  size_t sink = 0;
+  while (compressNs < 2e8 && rounds < 10000) {
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string &b : batches) {
+      sink += codec->compress((const uint8_t *)b.data(), b.size(), out.data(), out.size());
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (const std::vector<uint8_t> &e : encoded) {
+      size_t got;
+      if (codec->decompress(e.data(), e.size(), got)) sink += got;
+    }
+    auto end = std::chrono::steady_clock::now();
+    compressNs += std::chrono::duration<double, std::nano>(mid - start).count();
+    decompressNs += std::chrono::duration<double, std::nano>(end - mid).count();
+    rounds++;
+  }
+  benchSink = sink;
+
+  double mb = (double)rawBytes * rounds / 1e6;
+  printf("%-8s %10zu %10zu %7.3f %10.1f %10.1f %9.2f\n", label, rawBytes, packed,
+         rawBytes ? (double)packed / rawBytes : 0.0, mb / (compressNs / 1e9), mb / (decompressNs / 1e9),
+         batches.empty() ? 0.0 : compressNs / 1e3 / ((double)batches.size() * rounds));
+}
+
+static int runBench(FILE *in, bool hex, size_t maxRecords) {
+  std::vector<std::string> records;
+  for (const std::string &line : readLines(in)) {
+    std::string rec;
+    if (!hex) records.push_back(line);
+    else if (fromHex(line, rec)) records.push_back(rec);
+  }
+  std::vector<std::string> batches = makeBatches(records, hex, maxRecords);
+  printf("records=%zu batches=%zu batchN=%zu dict=%u (%zu bytes)\n", records.size(), batches.size(), maxRecords,
+         (unsigned)LZ_DICT_MESHCORE_ID, sizeof(LZ_DICT_MESHCORE) - 1);
+  printf("%-8s %10s %10s %7s %10s %10s %9s\n", "dict", "raw", "packed", "ratio", "comp MB/s", "dec MB/s",
+         "us/batch");
+  benchCodec("meshcore", meshcoreCodec(), batches);
+  benchCodec("none", plainCodec(), batches);
+  return 0;
+}
+
+// Greedy dictionary builder: count in how many records each SEGMENT-byte
+// string occurs, then take the most common ones, chaining segments that
+// overlap (the windows of one long repeated key) into a single run and
+// skipping near-duplicates of what is already in.
+#define TRAIN_SEGMENT 12
+#define TRAIN_OVERLAP 4
+
+struct Piece {
+  std::string text;
+  uint32_t score;
+};
+
+static void emitHeader(const std::vector<Piece> &pieces, unsigned id, size_t records) {
+  printf("// lib/lz_codec/lz_dict_meshcore.h\n#pragma once\n#include <stdint.h>\n\n");
+  printf("// Preset dictionary for observer uplink batches (dictionary id %u).\n", id);
+  printf("// Trained by tools/lz_codec/lz_tool on %zu records. A stream is only\n", records);
+  printf("// readable with the dictionary it was compressed against, so bump the id\n");
+  printf("// whenever the content changes. Most common strings go last.\n");
+  printf("#define LZ_DICT_MESHCORE_ID %u\n\nstatic const char LZ_DICT_MESHCORE[] =", id);
+  for (size_t i = 0; i < pieces.size(); i++) {
+    printf("\n    \"");
+    for (unsigned char c : pieces[i].text) {
+      if (c == '"' || c == '\\') printf("\\%c", c);
+      else if (c == '\n') printf("\\n");
+      else if (c < 0x20 || c >= 0x7F) printf("\\x%02X\"\"", c);
+      else putchar(c);
+    }
+    putchar('"');
+  }
+  printf(";\n");
+}
+
+static int runTrain(FILE *in, size_t size, unsigned id) {
+  std::vector<std::string> records = readLines(in);
+  if (records.empty()) {
+    fprintf(stderr, "no records\n");
+    return 1;
+  }
+  std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> counts;  // segment -> (records, last record)
+  for (uint32_t r = 0; r < records.size(); r++) {
+    const std::string &rec = records[r];
+    for (size_t i = 0; i + TRAIN_SEGMENT <= rec.size(); i++) {
+      auto &c = counts[rec.substr(i, TRAIN_SEGMENT)];
+      if (c.first && c.second == r) continue;
+      c.first++;
+      c.second = r;
+    }
+  }
+  std::vector<std::pair<uint32_t, std::string>> ranked;
+  uint32_t minCount = std::max<uint32_t>(2, (uint32_t)(records.size() / 50));
+  for (const auto &c : counts) {
+    if (c.second.first >= minCount) ranked.push_back(std::make_pair(c.second.first, c.first));
+  }
+  std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint32_t, std::string> &a,
+                                             const std::pair<uint32_t, std::string> &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+
+  std::vector<Piece> pieces;
+  size_t total = 0;
+  for (const auto &cand : ranked) {
+    if (total >= size) break;
+    const std::string &s = cand.second;
+    bool placed = false;
+    for (Piece &p : pieces) {
+      if (p.text.find(s) != std::string::npos) {
+        placed = true;
+        break;
+      }
+      for (size_t k = TRAIN_SEGMENT - 1; k >= TRAIN_OVERLAP && !placed; k--) {
+        if (p.text.compare(p.text.size() - k, k, s, 0, k) == 0) {
+          p.text += s.substr(k);
+          total += s.size() - k;
+          placed = true;
+        } else if (p.text.compare(0, k, s, s.size() - k, k) == 0) {
+          p.text = s.substr(0, s.size() - k) + p.text;
+          total += s.size() - k;
+          placed = true;
+        }
+      }
+      if (placed) break;
+    }
+    // A variant of a string already taken (a different value digit next
+    // to the same key) would mostly duplicate it.
+    for (const Piece &p : pieces) {
+      if (placed) break;
+      placed = p.text.find(s.substr(1)) != std::string::npos ||
+               p.text.find(s.substr(0, s.size() - 1)) != std::string::npos;
+    }
+    if (!placed) {
+      pieces.push_back(Piece{s, cand.first});
+      total += s.size();
+    }
+  }
+  std::stable_sort(pieces.begin(), pieces.end(), [](const Piece &a, const Piece &b) { return a.score < b.score; });
+  emitHeader(pieces, id, records.size());
+  fprintf(stderr, "dictionary: %zu pieces, %zu bytes\n", pieces.size(), total);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: lz_tool decompress|compress|bench|train [options] [file]\n");
+    return 2;
+  }
+  const char *cmd = argv[1];
+  bool hex = false;
+  size_t batchN = 16, size = 1024;
+  unsigned id = LZ_DICT_MESHCORE_ID + 1;
+  const char *path = nullptr;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--hex")) hex = true;
+    else if (!strcmp(argv[i], "--batch") && i + 1 < argc) batchN = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--size") && i + 1 < argc) size = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--id") && i + 1 < argc) id = strtoul(argv[++i], nullptr, 10);
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    } else path = argv[i];
+  }
+  if (batchN < 1) batchN = 1;
+  if (size > 4096) size = 4096;
+  FILE *in = path ? fopen(path, "rb") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+  int rc;
+  if (!strcmp(cmd, "decompress")) rc = runDecompress(in, hex);
+  else if (!strcmp(cmd, "compress")) rc = runCompress(in);
+  else if (!strcmp(cmd, "bench")) rc = runBench(in, hex, batchN);
+  else if (!strcmp(cmd, "train")) rc = runTrain(in, size, id);
+  else {
+    fprintf(stderr, "unknown command %s\n", cmd);
+    rc = 2;
+  }
+  if (in != stdin) fclose(in);
+  return rc;
+}
@@ -0,0 +1,290 @@
+// tools/mqtt5/batch_bench.cpp
+//
+// Compares the observer's uplink with batching off, NDJSON and array
+// batches: publishes per second and bytes on the wire per record, at a
+// quiet and a flood record rate. Batches are packed with the observer's
+// rules (batchRecord / flushBatch in src/observer_main.cpp): up to N records
+// or T ms, never more than MQTT_BUFFER_SIZE minus the PUBLISH header, topic
+// and properties. MQTT 5 publishes go through lib/mqtt5_client into a
+// loopback transport that decodes every PUBLISH, resolves topic aliases
+// and splits the batch again; each record must come back byte for byte.
+// MQTT 3.1.1 (PubSubClient) sizes follow from its fixed framing.
+//
+// Wire bytes are counted at three levels: MQTT packets; plus a TLS 1.2
+// AES-GCM record per PUBLISH (both clients hand a PUBLISH to the socket in
+// one write); plus 40 bytes of TCP/IP header per 1460-byte segment.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/mqtt5_client tools/mqtt5/batch_bench.cpp -o batch_bench
+//
+// Usage:
+//   batch_bench [--id OBS] [--n N] [--ms T] [--seconds S] [records.ndjson]
+//
+// The records (one JSON record per line) are replayed in a loop for S
+// seconds (default 600) at 1 and 20 records per second. Exits 1 if a
+// record does not come back intact.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "mqtt5_client.h"
+
+#define MQTT_BUFFER_SIZE 2048
+#define TLS_RECORD_OVERHEAD 29  // 5 header + 8 explicit nonce + 16 tag
+#define TCP_MSS 1460
+#define TCPIP_HEADER 40
+
+enum Mode { MODE_OFF, MODE_NDJSON, MODE_ARRAY };
+static const char *const MODE_NAMES[] = {"off", "ndjson", "array"};
+
+struct FakeClock {
+  static uint32_t now;
+  static uint32_t ms() { return now; }
+  static void idle() { now++; }
+};
+uint32_t FakeClock::now = 0;
+
+// Accepts the connection with a Topic Alias Maximum and hands back the
+// payload of every PUBLISH the client writes.
+class Loopback {
+ public:
+  int connect(const char *, uint16_t) {
+    open_ = true;
+    uint8_t ack[] = {MQTT5_CONNACK, 6, 0, 0, 3, MQTT5_PROP_TOPIC_ALIAS_MAX, 0, MQTT5_TOPIC_ALIASES};
+    out_.assign(ack, ack + sizeof(ack));
+    return 1;
+  }
+  uint8_t connected() { return open_; }
+  int available() { return (int)out_.size(); }
+  int read() {
+    if (out_.empty()) return -1;
+    uint8_t b = out_.front();
+    out_.pop_front();
+    return b;
+  }
+  size_t write(const uint8_t *data, size_t len) {
+    if ((data[0] & 0xF0) == MQTT5_PUBLISH) {
+      uint32_t remaining;
+      size_t n = mqtt5GetVarint(data + 1, data + len, remaining);
+      const uint8_t *p = data + 1 + n, *end = p + remaining;
+      size_t topicLen = (size_t)p[0] << 8 | p[1];
+      std::string topic((const char *)p + 2, topicLen);
+      p += 2 + topicLen;
+      uint32_t propLen;
+      p += mqtt5GetVarint(p, end, propLen);
+      uint16_t alias = 0;
+      mqtt5ForEachProperty(p, p + propLen, [&](uint8_t id, const uint8_t *v, size_t) {
+        if (id == MQTT5_PROP_TOPIC_ALIAS) alias = (uint16_t)(v[0] << 8 | v[1]);
+      });
+      p += propLen;
+      if (alias && !topic.empty()) aliases_[alias] = topic;
+      if (topic.empty()) topic = aliases_[alias];
+      topics.push_back(topic);
+      payloads.push_back(std::string((const char *)p, end - p));
+    }
+    return len;
+  }
+  void stop() { open_ = false; }
+
+  std::vector<std::string> topics;
+  std::vector<std::string> payloads;
+
+ private:
+  bool open_ = false;
+  std::deque<uint8_t> out_;
+  std::map<uint16_t, std::string> aliases_;
+};
+
+struct Options {
+  std::string id = "OBS1";
+  unsigned n = 16;
+  unsigned ms = 1000;
+  unsigned seconds = 600;
+};
+
+struct Totals {
+  size_t records = 0;
+  size_t payload = 0;
+  size_t publishes = 0;
+  size_t mqtt311 = 0, mqtt5 = 0;
+  size_t tls311 = 0, tls5 = 0;
+};
+
+static size_t onWire(size_t mqtt) {
+  size_t tls = mqtt + TLS_RECORD_OVERHEAD;
+  return tls + (tls + TCP_MSS - 1) / TCP_MSS * TCPIP_HEADER;
+}
+
+// Splits a batch body back into records.
+static std::vector<std::string> unbatch(const std::string &body, Mode mode) {
+  std::vector<std::string> out;
+  if (mode == MODE_OFF) {
+    out.push_back(body);
+    return out;
+  }
+  std::string s = body;
+  if (mode == MODE_ARRAY) {
+    if (s.size() < 2 || s.front() != '[' || s.back() != ']') return out;
+    s = s.substr(1, s.size() - 2);
+  }
+  // Records are flat JSON objects with no separators inside strings that
+  // could be mistaken for ours: split between "}" and the next "{".
+  char sep = mode == MODE_ARRAY ? ',' : '\n';
+  size_t start = 0;
+  for (size_t i = 0; i + 1 < s.size(); i++) {
+    if (s[i] == '}' && s[i + 1] == sep && i + 2 < s.size() && s[i + 2] == '{') {
+      out.push_back(s.substr(start, i + 1 - start));
+      start = i + 2;
+    }
+  }
+  out.push_back(s.substr(start));
+  return out;
+}
+
+static bool run(const std::vector<std::string> &records, const Options &o, Mode mode, double rate, Totals &t) {
+  Loopback loop;
+  Mqtt5Client<Loopback, FakeClock, MQTT_BUFFER_SIZE> client(loop);
+  client.setServer("loopback", 8883);
+  client.setUserProperty("schema", "1");
+  FakeClock::now = 0;
+  if (!client.connect(("obs-" + o.id).c_str())) return false;
+  std::string topic = "meshrank/observers/" + o.id + "/packets";
+  size_t capacity = MQTT_BUFFER_SIZE - 5 - 2 - MQTT5_PUBLISH_PROPS_MAX - topic.size();
+
+  std::string body;
+  unsigned count = 0;
+  uint32_t startedMs = 0;
+  std::vector<std::string> sent;
+  auto publish = [&](const std::string &payload) {
+    size_t rem = 2 + topic.size() + payload.size();
+    size_t m311 = 1 + mqtt5VarintLen(rem) + rem;
+    uint32_t before = client.bytesSent();
+    client.publish(topic.c_str(), (const uint8_t *)payload.data(), payload.size());
+    size_t m5 = client.bytesSent() - before;
+    t.publishes++;
+    t.mqtt311 += m311;
+    t.mqtt5 += m5;
+    t.tls311 += onWire(m311);
+    t.tls5 += onWire(m5);
+  };
+  auto flush = [&] {
+    if (!count) return;
+    if (mode == MODE_ARRAY) body += ']';
+    publish(body);
+    body.clear();
+    count = 0;
+  };
+
+  size_t total = (size_t)(rate * o.seconds);
+  for (size_t i = 0; i < total; i++) {
+    uint32_t now = (uint32_t)(i * 1000 / rate);
+    // serviceBatch() runs every uplink task pass, well inside T.
+    if (count && now - startedMs >= o.ms) flush();
+    FakeClock::now = now;
+    const std::string &rec = records[i % records.size()];
+    sent.push_back(rec);
+    t.records++;
+    t.payload += rec.size();
+    if (mode == MODE_OFF) {
+      publish(rec);
+      continue;
+    }
+    if (count && body.size() + rec.size() + 2 > capacity) flush();
+    if (body.size() + rec.size() + 2 > capacity) {
+      publish(rec);  // too big to share a PUBLISH
+      continue;
+    }
+    if (!count) {
+      startedMs = now;
+      if (mode == MODE_ARRAY) body += '[';
+    } else {
+      body += mode == MODE_ARRAY ? ',' : '\n';
+    }
+    body += rec;
+    if (++count >= o.n) flush();
+  }
+  flush();
+  client.disconnect();
+
+  std::vector<std::string> got;
+  for (size_t i = 0; i < loop.payloads.size(); i++) {
+    if (loop.topics[i] != topic) return false;
+    // A record too big to share a PUBLISH goes out bare, even in array mode.
+    bool single = mode == MODE_ARRAY && loop.payloads[i][0] != '[';
+    for (const std::string &r : unbatch(loop.payloads[i], single ? MODE_OFF : mode)) got.push_back(r);
+  }
+  if (got != sent) {
+    fprintf(stderr, "%s at %.0f/s: %zu records sent, %zu came back%s\n", MODE_NAMES[mode], rate, sent.size(),
+            got.size(), got.size() == sent.size() ? " altered" : "");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  Options o;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--id") && more) o.id = argv[++i];
+    else if (!strcmp(a, "--n") && more) o.n = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--ms") && more) o.ms = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--seconds") && more) o.seconds = (unsigned)atoi(argv[++i]);
+    else if (a[0] == '-') {
+      fprintf(stderr, "usage: batch_bench [--id OBS] [--n N] [--ms T] [--seconds S] [records.ndjson]\n");
+      return 2;
+    } else path = a;
+  }
+  FILE *in = path ? fopen(path, "r") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+  std::vector<std::string> records;
+  std::string line;
+  int c;
+  do {
+    c = fgetc(in);
+    if (c != '\n' && c != EOF) {
+      line += (char)c;
+      continue;
+    }
+    if (!line.empty() && line[0] == '{') records.push_back(line);
+    line.clear();
+  } while (c != EOF);
+  if (in != stdin) fclose(in);
+  if (records.empty()) {
+    fprintf(stderr, "no JSON records\n");
+    return 1;
+  }
+  if (!o.n) o.n = 1;
+
+  size_t payload = 0;
+  for (const std::string &r : records) payload += r.size();
+  printf("records=%zu avg=%.0fB batch n=%u ms=%u seconds=%u\n", records.size(), (double)payload / records.size(),
+         o.n, o.ms, o.seconds);
+  printf("%5s %-7s %9s %8s %8s %11s %11s %11s %11s\n", "rate", "batch", "publishes", "pub/s", "rec/pub",
+         "mqtt311/rec", "mqtt5/rec", "wire311/rec", "wire5/rec");
+  const double rates[] = {1, 20};
+  bool ok = true;
+  for (double rate : rates) {
+    for (Mode mode : {MODE_OFF, MODE_NDJSON, MODE_ARRAY}) {
+      Totals t;
+      if (!run(records, o, mode, rate, t)) {
+        ok = false;
+        continue;
+      }
+      double over = (double)t.payload / t.records;
+      printf("%5.0f %-7s %9zu %8.2f %8.1f %11.1f %11.1f %11.1f %11.1f\n", rate, MODE_NAMES[mode], t.publishes,
+             (double)t.publishes / o.seconds, (double)t.records / t.publishes, (double)t.mqtt311 / t.records - over,
+             (double)t.mqtt5 / t.records - over, (double)t.tls311 / t.records - over,
+             (double)t.tls5 / t.records - over);
+    }
+  }
+  printf("(per-record columns are bytes over the %.0f-byte average record)\n", (double)payload / records.size());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,431 @@
+// tools/mqtt5/mqtt5_loopback.cpp
+//
+// Runs lib/mqtt5_client against an in-process broker stand-in on the host:
+// every packet the client writes is decoded the way a broker would (topic
+// aliases resolved, user properties read) and checked against what was
+// published. Every third record goes out with QoS 1 and must get exactly
+// one PUBACK through nextPubAck(), with its packet identifier and reason
+// code; the broker acks them in swapped pairs and rejects every seventh
+// packet identifier with Quota exceeded. It also checks that a Maximum QoS
+// of 0 stops QoS 1 publishes and that a packet trickled in byte by byte
+// times out once. Reports the bytes on the wire with and without topic
+// aliases.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/mqtt5_client tools/mqtt5/mqtt5_loopback.cpp -o mqtt5_loopback
+//
+// Usage:
+//   mqtt5_loopback [--id OBS] [--trace] [records.ndjson]
+//
+// Each input line is published as one record on
+// meshrank/observers/<id>/packets, with a stats message every 50 records,
+// so the alias table sees more than one topic. Exits 1 if the broker side
+// saw anything other than what was published.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "mqtt5_client.h"
+
+struct FakeClock {
+  static uint32_t now;
+  static uint32_t ms() { return now; }
+  static void idle() { now++; }
+};
+uint32_t FakeClock::now = 0;
+
+struct Received {
+  std::string topic;
+  std::string payload;
+  std::string schema;
+  bool retained;
+  uint8_t qos;
+};
+
+// Speaks just enough of the broker side of MQTT 5 for the client: CONNACK
+// with a configurable Topic Alias Maximum, PUBLISH decoding, PUBACK for
+// QoS 1 (out of order, some of them failures), PINGRESP.
+class LoopbackBroker {
+ public:
+  LoopbackBroker(uint16_t aliasMax, bool trace) : aliasMax_(aliasMax), trace_(trace) {}
+
+  // Arduino Client surface used by Mqtt5Client.
+  int connect(const char *, uint16_t) {
+    open_ = true;
+    in_.clear();
+    aliases_.clear();
+    return 1;
+  }
+  uint8_t connected() { return open_; }
+  int available() {
+    if (!slow_.empty() && FakeClock::now >= slowAtMs_) {
+      out_.push_back(slow_.front());
+      slow_.pop_front();
+      slowAtMs_ = FakeClock::now + slowEveryMs_;
+    }
+    return (int)out_.size();
+  }
+  int read() {
+    if (out_.empty()) return -1;
+    uint8_t b = out_.front();
+    out_.pop_front();
+    return b;
+  }
+  size_t write(const uint8_t *data, size_t len) {
+    if (!open_) return 0;
+    in_.insert(in_.end(), data, data + len);
+    wireBytes += len;
+    parse();
+    return len;
+  }
+  void stop() { open_ = false; }
+
+  // Queues raw bytes for the client, e.g. a packet cut short.
+  void inject(const uint8_t *data, size_t len) { out_.insert(out_.end(), data, data + len); }
+
+  // Queues bytes that become readable one at a time, everyMs apart.
+  void trickle(const uint8_t *data, size_t len, uint32_t everyMs) {
+    slow_.insert(slow_.end(), data, data + len);
+    slowEveryMs_ = everyMs;
+    slowAtMs_ = FakeClock::now;
+  }
+
+  // CONNACK properties to send instead of alias maximum and Receive Maximum.
+  std::vector<uint8_t> connackProps;
+  std::vector<Received> received;
+  size_t wireBytes = 0;
+  unsigned pings = 0;
+  unsigned errors = 0;
+
+  // Reason code the broker answers a QoS 1 PUBLISH with.
+  static uint8_t pubAckReason(uint16_t packetId) { return packetId % 7 ? 0x00 : 0x97; }
+
+ private:
+  void sendPubAck(uint16_t packetId) {
+    uint8_t reason = pubAckReason(packetId);
+    uint8_t puback[] = {MQTT5_PUBACK, (uint8_t)(reason ? 3 : 2), (uint8_t)(packetId >> 8), (uint8_t)packetId, reason};
+    out_.insert(out_.end(), puback, puback + puback[1] + 2);
+  }
+
+  void fail(const char *what) {
+    fprintf(stderr, "broker: %s\n", what);
+    errors++;
+    open_ = false;
+  }
+
+  static std::string getString(const uint8_t *&p) {
+    size_t n = (size_t)p[0] << 8 | p[1];
+    std::string s((const char *)p + 2, n);
+    p += 2 + n;
+    return s;
+  }
+
+  void parse() {
+    for (;;) {
+      uint32_t remaining;
+      if (in_.size() < 2) return;
+      size_t n = mqtt5GetVarint(in_.data() + 1, in_.data() + in_.size(), remaining);
+      if (!n || in_.size() < 1 + n + remaining) return;
+      std::vector<uint8_t> body(in_.begin() + 1 + n, in_.begin() + 1 + n + remaining);
+      uint8_t type = in_[0];
+      in_.erase(in_.begin(), in_.begin() + 1 + n + remaining);
+      handle(type, body);
+    }
+  }
+
+  void handle(uint8_t type, const std::vector<uint8_t> &body) {
+    switch (type & 0xF0) {
+      case MQTT5_CONNECT: {
+        if (body.size() < 10 || body[6] != 5) return fail("CONNECT is not protocol level 5");
+        std::vector<uint8_t> props = connackProps;
+        if (props.empty()) {
+          props = {MQTT5_PROP_TOPIC_ALIAS_MAX, (uint8_t)(aliasMax_ >> 8), (uint8_t)aliasMax_,
+                   MQTT5_PROP_RECEIVE_MAX, 0, 20};
+        }
+        uint8_t ack[] = {MQTT5_CONNACK, (uint8_t)(3 + props.size()), 0, 0, (uint8_t)props.size()};
+        out_.insert(out_.end(), ack, ack + sizeof(ack));
+        out_.insert(out_.end(), props.begin(), props.end());
+        break;
+      }
+      case MQTT5_PUBLISH: {
+        const uint8_t *p = body.data(), *end = p + body.size();
+        std::string topic = getString(p);
+        uint8_t qos = (type >> 1) & 3;
+        if (qos > 1) return fail("QoS 2 PUBLISH");
+        uint16_t packetId = 0;
+        if (qos) {
+          packetId = (uint16_t)(p[0] << 8 | p[1]);
+          p += 2;
+          if (!packetId) return fail("QoS 1 PUBLISH without packet identifier");
+        }
+        uint32_t propLen;
+        size_t n = mqtt5GetVarint(p, end, propLen);
+        if (!n) return fail("bad property length");
+        p += n;
+        uint16_t alias = 0;
+        std::string schema;
+        bool ok = mqtt5ForEachProperty(p, p + propLen, [&](uint8_t id, const uint8_t *v, size_t) {
+          if (id == MQTT5_PROP_TOPIC_ALIAS) alias = (uint16_t)(v[0] << 8 | v[1]);
+          if (id == MQTT5_PROP_USER) {
+            const uint8_t *q = v;
+            std::string key = getString(q);
+            std::string value = getString(q);
+            if (key == "schema") schema = value;
+          }
+        });
+        if (!ok) return fail("bad properties");
+        p += propLen;
+        if (alias > aliasMax_) return fail("alias above Topic Alias Maximum");
+        if (alias && !topic.empty()) aliases_[alias] = topic;
+        if (alias && topic.empty()) {
+          auto it = aliases_.find(alias);
+          if (it == aliases_.end()) return fail("alias used before it was set");
+          topic = it->second;
+        }
+        if (topic.empty()) return fail("PUBLISH without topic or alias");
+        if (trace_) {
+          printf("PUBLISH %-40s alias=%u %s schema=%s len=%zu wire=%zu\n", topic.c_str(), alias,
+                 body.size() > 2 && (body[0] | body[1]) ? "topic+alias" : "alias-only", schema.c_str(),
+                 (size_t)(end - p), body.size() + 1 + mqtt5VarintLen(body.size()));
+        }
+        received.push_back(Received{topic, std::string((const char *)p, end - p), schema, (type & 1) != 0, qos});
+        // Every other PUBACK is held back and sent after the next one.
+        if (qos && !held_) {
+          held_ = packetId;
+        } else if (qos) {
+          sendPubAck(packetId);
+          sendPubAck(held_);
+          held_ = 0;
+        }
+        break;
+      }
+      case MQTT5_PINGREQ: {
+        pings++;
+        if (held_) sendPubAck(held_);
+        held_ = 0;
+        uint8_t pong[] = {MQTT5_PINGRESP, 0};
+        out_.insert(out_.end(), pong, pong + sizeof(pong));
+        break;
+      }
+      case MQTT5_DISCONNECT:
+        open_ = false;
+        break;
+      default:
+        fail("unexpected packet type");
+    }
+  }
+
+  uint16_t aliasMax_;
+  bool trace_;
+  bool open_ = false;
+  std::vector<uint8_t> in_;
+  std::deque<uint8_t> out_;
+  std::deque<uint8_t> slow_;
+  uint32_t slowEveryMs_ = 0;
+  uint32_t slowAtMs_ = 0;
+  std::map<uint16_t, std::string> aliases_;
+  uint16_t held_ = 0;
+};
+
+struct Sent {
+  std::string topic;
+  std::string payload;
+  uint8_t qos;
+};
+
+// Publishes the records through a client connected to a broker offering
+// aliasMax aliases; returns wire bytes, or 0 if anything did not match.
+static size_t run(const std::vector<std::string> &records, const std::string &id, uint16_t aliasMax, bool trace) {
+  LoopbackBroker broker(aliasMax, trace);
+  Mqtt5Client<LoopbackBroker, FakeClock> client(broker);
+  std::string packets = "meshrank/observers/" + id + "/packets";
+  std::string stats = "meshrank/observers/" + id + "/stats";
+  client.setServer("loopback", 8883);
+  client.setUserProperty("schema", "1");
+  if (!client.connect(("obs-" + id).c_str())) {
+    fprintf(stderr, "connect failed rc=%d\n", client.state());
+    return 0;
+  }
+
+  if (client.receiveMax() != 20 || client.maxQos() != 1) {
+    fprintf(stderr, "Receive Maximum read as %u, Maximum QoS as %u\n", client.receiveMax(), client.maxQos());
+    return 0;
+  }
+  std::vector<Sent> sent;
+  uint32_t qos1 = 0;
+  std::vector<uint16_t> unacked;  // packet identifiers in publish order
+  unsigned overtaken = 0, bad = 0;
+  auto collectAcks = [&] {
+    Mqtt5PubAck a;
+    while (client.nextPubAck(a)) {
+      auto it = std::find(unacked.begin(), unacked.end(), a.packetId);
+      if (it == unacked.end() || a.reason != LoopbackBroker::pubAckReason(a.packetId)) {
+        fprintf(stderr, "PUBACK id=%u reason=0x%02X not expected\n", a.packetId, a.reason);
+        bad++;
+        continue;
+      }
+      if (it != unacked.begin()) overtaken++;
+      unacked.erase(it);
+    }
+  };
+  for (size_t i = 0; i < records.size(); i++) {
+    const uint8_t *data = (const uint8_t *)records[i].data();
+    uint8_t qos = i % 3 == 0;
+    uint16_t packetId = 0;
+    bool ok = qos ? (packetId = client.publishQos1(packets.c_str(), data, records[i].size())) != 0
+                  : client.publish(packets.c_str(), data, records[i].size());
+    if (!ok) {
+      fprintf(stderr, "publish of a %zu byte record failed\n", records[i].size());
+      return 0;
+    }
+    if (qos) unacked.push_back(packetId);
+    qos1 += qos;
+    sent.push_back(Sent{packets, records[i], qos});
+    if (i % 50 == 49) {
+      std::string json = "{\"observerId\":\"" + id + "\",\"records\":" + std::to_string(i + 1) + "}";
+      client.publish(stats.c_str(), json.c_str());
+      sent.push_back(Sent{stats, json, 0});
+    }
+    FakeClock::now += 100;
+    client.loop();
+    collectAcks();
+  }
+  // An idle keep-alive period must produce exactly one ping round trip.
+  unsigned pings = broker.pings;
+  FakeClock::now += MQTT5_KEEPALIVE_S * 1000 + 1;
+  client.loop();
+  client.loop();
+  if (!client.connected() || broker.pings != pings + 1) {
+    fprintf(stderr, "keep-alive: connected=%d pings=%u\n", client.connected(), broker.pings - pings);
+    return 0;
+  }
+  collectAcks();
+  if (client.pubAcks() != qos1 || !unacked.empty() || bad || (qos1 > 1 && !overtaken)) {
+    fprintf(stderr, "%u PUBACKs for %u QoS 1 publishes, %zu unmatched, %u unexpected, %u out of order\n",
+            client.pubAcks(), qos1, unacked.size(), bad, overtaken);
+    return 0;
+  }
+  client.disconnect();
+
+  if (broker.errors || broker.received.size() != sent.size()) {
+    fprintf(stderr, "broker saw %zu of %zu publishes, %u errors\n", broker.received.size(), sent.size(),
+            broker.errors);
+    return 0;
+  }
+  for (size_t i = 0; i < sent.size(); i++) {
+    const Received &r = broker.received[i];
+    if (r.topic != sent[i].topic || r.payload != sent[i].payload || r.schema != "1" || r.qos != sent[i].qos) {
+      fprintf(stderr, "publish %zu arrived as topic=%s schema=%s\n", i, r.topic.c_str(), r.schema.c_str());
+      return 0;
+    }
+  }
+  return broker.wireBytes;
+}
+
+// A packet that stops arriving halfway must time out the connection after
+// the socket timeout, with the client idling rather than spinning.
+static bool checkReadTimeout() {
+  LoopbackBroker broker(MQTT5_TOPIC_ALIASES, false);
+  Mqtt5Client<LoopbackBroker, FakeClock> client(broker);
+  client.setServer("loopback", 8883);
+  FakeClock::now = 0;
+  if (!client.connect("obs-timeout")) return false;
+  const uint8_t partial[] = {MQTT5_PUBACK, 3, 0};
+  broker.inject(partial, sizeof(partial));
+  uint32_t start = FakeClock::now;
+  bool alive = client.loop();
+  uint32_t waited = FakeClock::now - start;
+  if (alive || client.state() != MQTT5_CONNECTION_TIMEOUT || waited < MQTT5_SOCKET_TIMEOUT_S * 1000) {
+    fprintf(stderr, "truncated packet: loop()=%d state=%d after %u ms\n", alive, client.state(), (unsigned)waited);
+    return false;
+  }
+
+  // The timeout covers the whole packet: bytes that keep arriving, each
+  // well inside the timeout, must not stretch the read past it.
+  if (!client.connect("obs-trickle")) return false;
+  uint8_t slow[2 + 100] = {MQTT5_PUBACK, 100, 0, 1};
+  uint32_t every = MQTT5_SOCKET_TIMEOUT_S * 1000 / 4;
+  broker.trickle(slow, sizeof(slow), every);
+  start = FakeClock::now;
+  alive = client.loop();
+  waited = FakeClock::now - start;
+  if (alive || client.state() != MQTT5_CONNECTION_TIMEOUT || waited > MQTT5_SOCKET_TIMEOUT_S * 1000 + every) {
+    fprintf(stderr, "trickled packet: loop()=%d state=%d after %u ms\n", alive, client.state(), (unsigned)waited);
+    return false;
+  }
+  return true;
+}
+
+// CONNACK properties of every width, ending on a 1-byte one, must each be
+// read at their own width and applied; with Maximum QoS 0, publishQos1()
+// must send nothing.
+static bool checkConnackProperties() {
+  LoopbackBroker broker(MQTT5_TOPIC_ALIASES, false);
+  broker.connackProps = {MQTT5_PROP_MAX_PACKET, 0, 0, 0x01, 0x00,  // 256
+                         MQTT5_PROP_TOPIC_ALIAS_MAX, 0, 3,
+                         MQTT5_PROP_RECEIVE_MAX, 0, 5,
+                         MQTT5_PROP_MAX_QOS, 0,
+                         MQTT5_PROP_RETAIN_AVAILABLE, 0};
+  Mqtt5Client<LoopbackBroker, FakeClock> client(broker);
+  client.setServer("loopback", 8883);
+  if (!client.connect("obs-props")) return false;
+  std::string small(100, 'x'), big(300, 'x');
+  bool ok = client.topicAliasMax() == 3 && client.receiveMax() == 5 && client.maxQos() == 0 &&
+            client.publish("t", small.c_str(), true) && !client.publish("t", big.c_str(), false) &&
+            !client.publishQos1("t", (const uint8_t *)small.data(), small.size()) &&
+            broker.received.size() == 1 && !broker.received[0].retained;
+  if (!ok) {
+    fprintf(stderr, "CONNACK properties: aliasMax=%u receiveMax=%u maxQos=%u publishes=%zu\n",
+            client.topicAliasMax(), client.receiveMax(), client.maxQos(), broker.received.size());
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  std::string id = "OBS1";
+  bool trace = false;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--id") && i + 1 < argc) id = argv[++i];
+    else if (!strcmp(argv[i], "--trace")) trace = true;
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: mqtt5_loopback [--id OBS] [--trace] [records.ndjson]\n");
+      return 2;
+    } else path = argv[i];
+  }
+  FILE *in = path ? fopen(path, "r") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+  std::vector<std::string> records;
+  std::string line;
+  int c;
+  do {
+    c = fgetc(in);
+    if (c != '\n' && c != EOF) {
+      line += (char)c;
+      continue;
+    }
+    if (!line.empty()) records.push_back(line);
+    line.clear();
+  } while (c != EOF);
+  if (in != stdin) fclose(in);
+
+  if (!checkReadTimeout() || !checkConnackProperties()) return 1;
+  size_t withAliases = run(records, id, MQTT5_TOPIC_ALIASES, trace);
+  size_t without = withAliases ? run(records, id, 0, false) : 0;
+  if (!withAliases || !without) return 1;
+  size_t payload = 0;
+  for (const std::string &r : records) payload += r.size();
+  printf("records=%zu payload=%zu\n", records.size(), payload);
+  printf("wire bytes, aliases:    %zu (%.1f per record over payload)\n", withAliases,
+         records.empty() ? 0.0 : (double)(withAliases - payload) / records.size());
+  printf("wire bytes, no aliases: %zu (%.1f per record over payload)\n", without,
+         records.empty() ? 0.0 : (double)(without - payload) / records.size());
+  return 0;
+}
@@ -0,0 +1,179 @@
+// tools/obs_record/obs_record_bench.cpp
+//
+// Size and speed of the binary observer record against the JSON record it
+// replaces with uplink.format bin. Random frames of a fixed payload length
+// (16, 100 and 255 bytes, and a uniform mix) are turned into:
+//
+//   bin    obsRecordEncode(), then obsRecordDecode() of the result
+//   json   the JsonWriter record jsonRecord() in src/observer_main.cpp builds
+//
+// for both record layouts the observer can send (per-record metadata, and
+// session sid/seq with a 16-byte hash). Every decoded record must match
+// the frame it was encoded from. Times are host nanoseconds per record and
+// only useful relative to each other.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/obs_record -I lib/json_writer -I lib/hex_codec tools/obs_record/obs_record_bench.cpp -o obs_record_bench
+//
+// Usage:
+//   obs_record_bench [--records N] [--seed S]
+//
+// Exits 1 if a record does not decode to what was encoded.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "json_writer.h"
+#include "obs_record.h"
+
+struct Options {
+  unsigned records = 100000;
+  unsigned seed = 1;
+};
+
+struct Frame {
+  ObsRecord rec;
+  uint8_t payload[255];
+  uint8_t hash[OBS_RECORD_HASH_LEN];
+};
+
+struct Result {
+  double binBytes = 0, jsonBytes = 0;
+  double encodeNs = 0, decodeNs = 0, jsonNs = 0;
+};
+
+static const char *OBSERVER_ID = "A1B2C3";
+static const char *OBSERVER_NAME = "London North";
+
+// jsonRecord() from src/observer_main.cpp, fed from the same fields.
+static size_t jsonRecord(const ObsRecord &r, char *out, size_t cap) {
+  bool session = r.flags & OBS_FLAG_SESSION;
+  JsonWriter w(out, cap);
+  if (session) {
+    w.raw("{\"sid\":").u64(r.sid).raw(",\"seq\":").u64(r.seq);
+  } else {
+    w.raw("{\"observerId\":\"").text(OBSERVER_ID)
+     .raw("\",\"observerName\":\"").text(OBSERVER_NAME).raw("\"");
+  }
+  w.raw(",\"ts\":").u64((uint32_t)(r.tsUs / 1000))
+   .raw(",\"tsUs\":").i64(r.tsUs)
+   .raw(",\"ptype\":").i64(r.len > 0 ? r.payload[0] : -1)
+   .raw(",\"crc\":").boolean(r.flags & OBS_FLAG_CRC_OK)
+   .raw(",\"rssi\":").fixed(r.rssiDeci / 10.0f, 1)
+   .raw(",\"snr\":").fixed(r.snrCenti / 100.0f, 2)
+   .raw(",\"reported_len\":").i64(r.reportedLen)
+   .raw(",\"len\":").i64(r.len)
+   .raw(",\"payloadHex\":\"").hex(r.payload, r.len)
+   .raw("\",\"frameHash\":\"").hex(r.hash, obsRecordHashLen(r.flags)).raw("\"");
+  if (r.flags & OBS_FLAG_RX_US) w.raw(",\"rxUs\":").i64(r.rxUs);
+  if (!session) w.raw(",\"gps\":{\"lat\":").fixed(51.5f, 6).raw(",\"lon\":").fixed(-0.12f, 6).raw("}");
+  w.raw("}");
+  return w.ok() ? w.size() : 0;
+}
+
+static bool same(const ObsRecord &a, const ObsRecord &b) {
+  return a.flags == b.flags && a.tsUs == b.tsUs && a.rxUs == b.rxUs &&
+         (!(a.flags & OBS_FLAG_SESSION) || (a.sid == b.sid && a.seq == b.seq)) && a.rssiDeci == b.rssiDeci &&
+         a.snrCenti == b.snrCenti && a.reportedLen == b.reportedLen && a.len == b.len &&
+         !memcmp(a.payload, b.payload, a.len) && !memcmp(a.hash, b.hash, obsRecordHashLen(a.flags));
+}
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// len < 0 draws a length per frame.
+static bool run(const Options &o, int len, bool session, Result &res) {
+  std::mt19937 rng(o.seed);
+  std::vector<Frame> frames(o.records);
+  for (uint32_t i = 0; i < o.records; i++) {
+    Frame &f = frames[i];
+    ObsRecord &r = f.rec;
+    r.flags = (rng() % 10 ? OBS_FLAG_CRC_OK : 0) | OBS_FLAG_RX_US | (session ? OBS_FLAG_SESSION | OBS_FLAG_HASH16 : 0);
+    r.tsUs = 3600000000LL + (int64_t)i * 1500000 + rng() % 1000;
+    r.rxUs = 1700000000000000LL + r.tsUs;
+    r.sid = 0x5EED0001;
+    r.seq = i;
+    r.rssiDeci = (int16_t)(-5 * (int)(rng() % 280));
+    r.snrCenti = (int16_t)(25 * ((int)(rng() % 256) - 128));
+    r.len = (uint16_t)(len < 0 ? rng() % 256 : len);
+    r.reportedLen = r.len;
+    for (int j = 0; j < r.len; j++) f.payload[j] = (uint8_t)rng();
+    for (int j = 0; j < OBS_RECORD_HASH_LEN; j++) f.hash[j] = (uint8_t)rng();
+    r.payload = f.payload;
+    r.hash = f.hash;
+  }
+
+  std::vector<uint8_t> bin((size_t)o.records * OBS_RECORD_MAX);
+  std::vector<size_t> sizes(o.records);
+  size_t used = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < o.records; i++) {
+    sizes[i] = obsRecordEncode(frames[i].rec, bin.data() + used, OBS_RECORD_MAX);
+    used += sizes[i];
+  }
+  res.encodeNs = nsSince(t0) / o.records;
+  res.binBytes = (double)used / o.records;
+
+  std::vector<ObsRecord> decoded(o.records);
+  const uint8_t *p = bin.data();
+  size_t left = used;
+  t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < o.records; i++) {
+    size_t n = obsRecordDecode(p, left, decoded[i]);
+    if (n != sizes[i]) break;
+    p += n;
+    left -= n;
+  }
+  res.decodeNs = nsSince(t0) / o.records;
+  for (uint32_t i = 0; i < o.records; i++) {
+    if (!same(frames[i].rec, decoded[i])) {
+      fprintf(stderr, "  len=%d record %u does not decode to what was encoded\n", len, (unsigned)i);
+      return false;
+    }
+  }
+
+  char json[1024];
+  size_t jsonUsed = 0;
+  t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < o.records; i++) jsonUsed += jsonRecord(frames[i].rec, json, sizeof(json));
+  res.jsonNs = nsSince(t0) / o.records;
+  res.jsonBytes = (double)jsonUsed / o.records;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--records") && more) o.records = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--seed") && more) o.seed = (unsigned)atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: obs_record_bench [--records N] [--seed S]\n");
+      return 2;
+    }
+  }
+  if (!o.records) o.records = 1;
+
+  printf("records=%u per case\n", o.records);
+  printf("%5s %-8s %9s %10s %6s %9s %9s %9s  %s\n", "len", "layout", "bin B", "json B", "ratio", "encode ns",
+         "decode ns", "json ns", "");
+  const int lens[] = {16, 100, 255, -1};
+  bool ok = true;
+  for (bool session : {false, true}) {
+    for (int len : lens) {
+      Result r;
+      bool good = run(o, len, session, r);
+      ok = ok && good;
+      char lenName[8];
+      snprintf(lenName, sizeof(lenName), len < 0 ? "mix" : "%d", len);
+      printf("%5s %-8s %9.1f %10.1f %6.2f %9.1f %9.1f %9.1f  %s\n", lenName, session ? "session" : "metadata",
+             r.binBytes, r.jsonBytes, r.binBytes ? r.jsonBytes / r.binBytes : 0.0, r.encodeNs, r.decodeNs,
+             r.jsonNs, good ? "ok" : "FAIL");
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// tools/obs_record/obs_record_convert.cpp
+//
+// Converts binary observer records (meshrank/observers/<id>/packets/bin)
+// back to the JSON packet schema, one record per line, so ingest can keep
+// consuming JSON while observers move to the compact format.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/obs_record -I lib/json_writer -I lib/hex_codec tools/obs_record/obs_record_convert.cpp -o obs_record_convert
+//
+// Usage:
+//   obs_record_convert --id <observerId> [--name <name>] [--lat <deg> --lon <deg>]
+//                      [--hex] [file]
+//
+// Input is raw PUBLISH payloads concatenated (e.g. mosquitto_sub -N), or
+// with --hex one hex-encoded payload per line (spool lines, mosquitto_sub
+// -F %x). Session records (uplink.session on) come out with sid and seq and
+// without the observer metadata, as the observer would have sent them; the
+// --name/--lat/--lon options only apply to the others. A size summary goes
+// to stderr.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "json_writer.h"
+#include "obs_record.h"
+
+struct Observer {
+  const char *id = "";
+  const char *name = nullptr;
+  float lat = 0.0f;
+  float lon = 0.0f;
+};
+
+struct Totals {
+  unsigned long records = 0;
+  unsigned long errors = 0;
+  unsigned long long binBytes = 0;
+  unsigned long long jsonBytes = 0;
+};
+
+// Same fields, order and number formatting as the firmware's jsonRecord():
+// session records carry sid/seq in place of the observer metadata.
+static size_t toJson(const ObsRecord &r, const Observer &obs, char *out, size_t cap) {
+  bool session = r.flags & OBS_FLAG_SESSION;
+  JsonWriter w(out, cap);
+  if (session) {
+    w.raw("{\"sid\":").u64(r.sid).raw(",\"seq\":").u64(r.seq);
+  } else {
+    w.raw("{\"observerId\":\"").text(obs.id)
+     .raw("\",\"observerName\":\"").text(obs.name ? obs.name : obs.id).raw("\"");
+  }
+  w.raw(",\"ts\":").u64((uint32_t)(r.tsUs / 1000))
+   .raw(",\"tsUs\":").i64(r.tsUs)
+   .raw(",\"ptype\":").i64(r.len > 0 ? r.payload[0] : -1)
+   .raw(",\"crc\":").boolean(r.flags & OBS_FLAG_CRC_OK)
+   .raw(",\"rssi\":").fixed(r.rssiDeci / 10.0f, 1)
+   .raw(",\"snr\":").fixed(r.snrCenti / 100.0f, 2)
+   .raw(",\"reported_len\":").i64(r.reportedLen)
+   .raw(",\"len\":").i64(r.len)
+   .raw(",\"payloadHex\":\"").hex(r.payload, r.len)
+   .raw("\",\"frameHash\":\"").hex(r.hash, obsRecordHashLen(r.flags)).raw("\"");
+  if (r.flags & OBS_FLAG_RX_US) w.raw(",\"rxUs\":").i64(r.rxUs);
+  if (!session && (obs.lat != 0.0f || obs.lon != 0.0f)) {
+    w.raw(",\"gps\":{\"lat\":").fixed(obs.lat, 6).raw(",\"lon\":").fixed(obs.lon, 6).raw("}");
+  }
+  w.raw("}");
+  return w.ok() ? w.size() : 0;
+}
+
+static void convert(const uint8_t *data, size_t len, const Observer &obs, Totals &t) {
+  char json[1024];
+  while (len) {
+    ObsRecord r;
+    size_t used = obsRecordDecode(data, len, r);
+    if (used == 0) {
+      // Nothing after a bad record can be framed reliably.
+      t.errors++;
+      return;
+    }
+    size_t n = toJson(r, obs, json, sizeof(json));
+    if (n) {
+      fwrite(json, 1, n, stdout);
+      fputc('\n', stdout);
+      t.records++;
+      t.binBytes += used;
+      t.jsonBytes += n;
+    } else {
+      t.errors++;
+    }
+    data += used;
+    len -= used;
+  }
+}
+
+static int nibble(int c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static int usage() {
+  fprintf(stderr, "usage: obs_record_convert --id <observerId> [--name <name>] [--lat <deg> --lon <deg>] [--hex] [file]\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  Observer obs;
+  bool hexInput = false;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--id") && i + 1 < argc) obs.id = argv[++i];
+    else if (!strcmp(argv[i], "--name") && i + 1 < argc) obs.name = argv[++i];
+    else if (!strcmp(argv[i], "--lat") && i + 1 < argc) obs.lat = strtof(argv[++i], nullptr);
+    else if (!strcmp(argv[i], "--lon") && i + 1 < argc) obs.lon = strtof(argv[++i], nullptr);
+    else if (!strcmp(argv[i], "--hex")) hexInput = true;
+    else if (argv[i][0] == '-') return usage();
+    else path = argv[i];
+  }
+  if (!obs.id[0]) return usage();
+
+  FILE *in = path ? fopen(path, "rb") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+
+  Totals t;
+  std::vector<uint8_t> buf;
+  if (hexInput) {
+    std::string line;
+    int c;
+    do {
+      c = fgetc(in);
+      if (c != '\n' && c != EOF) {
+        if (c != '\r') line += (char)c;
+        continue;
+      }
+      buf.clear();
+      bool ok = line.size() % 2 == 0;
+      for (size_t i = 0; ok && i < line.size(); i += 2) {
+        int hi = nibble(line[i]), lo = nibble(line[i + 1]);
+        ok = hi >= 0 && lo >= 0;
+        buf.push_back((uint8_t)(hi << 4 | lo));
+      }
+      if (!ok) t.errors++;
+      else if (!buf.empty()) convert(buf.data(), buf.size(), obs, t);
+      line.clear();
+    } while (c != EOF);
+  } else {
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) buf.insert(buf.end(), chunk, chunk + n);
+    convert(buf.data(), buf.size(), obs, t);
+  }
+  if (in != stdin) fclose(in);
+
+  fprintf(stderr, "records=%lu errors=%lu binBytes=%llu jsonBytes=%llu ratio=%.2f\n",
+          t.records, t.errors, t.binBytes, t.jsonBytes,
+          t.binBytes ? (double)t.jsonBytes / t.binBytes : 0.0);
+  return t.errors ? 1 : 0;
+}
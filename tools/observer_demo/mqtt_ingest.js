@@ -14,11 +14,19 @@ const observerPath = path.join(dataDir, "observer.ndjson");
 const observerStatusPath = path.join(dataDir, "observers.json");
 const devicesPath = path.join(dataDir, "devices.json");
 const ingestLogPath = path.join(dataDir, "ingest.log");
+const sessionsPath = path.join(dataDir, "sessions.json");
 const keysPath = path.join(projectRoot, "tools", "meshcore_keys.json");
 const dbPath = path.join(dataDir, "meshrank.db");
 const GPS_WARN_KM = 50;
 const RF_MAX_ROWS = 50000;
 const RF_CLEAN_INTERVAL = 500;
+const SESSION_MAX = 4096;
+// Observers may send the full SHA-256 or, with uplink.hash 16, its first 16
+// bytes; every frameHash is stored as that 32-hex-digit prefix so sightings
+// from both kinds of observer match.
+const FRAME_HASH_HEX = 32;
+const PENDING_MAX = 2048;
+const PENDING_WAIT_MS = 60000;
 
 let rfDb = null;
 let rfInsert = null;
@@ -34,6 +42,7 @@ let keyMap = {};
 
 const mqttUrl = process.env.MESHRANK_MQTT_URL || "mqtts://meshrank.net:8883";
 const mqttTopic = process.env.MESHRANK_MQTT_TOPIC || "meshrank/observers/+/packets";
+const mqttSessionTopic = process.env.MESHRANK_MQTT_SESSION_TOPIC || "meshrank/observers/+/session";
 const mqttUser = process.env.MESHRANK_MQTT_USER || undefined;
 const mqttPass = process.env.MESHRANK_MQTT_PASS || undefined;
 
@@ -52,6 +61,12 @@ function sha256Hex(hex) {
   }
 }
 
+function normalizeFrameHash(value) {
+  const clean = String(value || "").trim().toUpperCase();
+  if (!/^[0-9A-F]+$/.test(clean) || clean.length < FRAME_HASH_HEX) return clean || null;
+  return clean.slice(0, FRAME_HASH_HEX);
+}
+
 function parseTopicInfo(topic) {
   const parts = String(topic || "").split("/");
   if (parts.length >= 4 && parts[0] === "meshcore") {
@@ -331,7 +346,7 @@ function storeMessage(record) {
   const msgHash = String(
     decoded.messageHash ||
     record.frameHash ||
-    sha256Hex(String(record.payloadHex).toUpperCase()) ||
+    normalizeFrameHash(sha256Hex(String(record.payloadHex).toUpperCase())) ||
     "unknown"
   ).toUpperCase();
   const pathRaw = Array.isArray(decoded.path) ? decoded.path : [];
@@ -586,30 +601,154 @@ const client = mqtt.connect(mqttUrl, {
 client.on("connect", () => {
   console.log(`(mqtt-ingest) connected ${mqttUrl}`);
   logIngest("INFO", `connected ${mqttUrl}`);
-  client.subscribe(mqttTopic, { qos: 0 }, (err) => {
+  client.subscribe([mqttSessionTopic, mqttTopic], { qos: 0 }, (err) => {
     if (err) {
       console.error("(mqtt-ingest) subscribe failed", err.message);
       logIngest("ERROR", `subscribe failed ${err.message}`);
       return;
     }
-    console.log(`(mqtt-ingest) subscribed ${mqttTopic}`);
-    logIngest("INFO", `subscribed ${mqttTopic}`);
+    console.log(`(mqtt-ingest) subscribed ${mqttSessionTopic} ${mqttTopic}`);
+    logIngest("INFO", `subscribed ${mqttSessionTopic} ${mqttTopic}`);
   });
 });
 
-client.on("message", (topic, payload) => {
-  let msg;
+// Observers may batch several records into one publish, either as a JSON
+// array or as newline-delimited JSON.
+function parseRecords(payload) {
+  const text = String(payload || "").trim();
+  if (!text) return [];
   try {
-    msg = JSON.parse(String(payload || ""));
+    const parsed = JSON.parse(text);
+    return Array.isArray(parsed) ? parsed : [parsed];
   } catch {
+    const records = [];
+    for (const line of text.split("\n")) {
+      if (!line.trim()) continue;
+      try {
+        records.push(JSON.parse(line));
+      } catch {}
+    }
+    return records;
+  }
+}
+
+// Observers publish their metadata (name, gps, firmware) as a retained
+// session message and may then send packet records carrying only
+// {sid, seq}. Sessions are kept by observer and sid so records spooled
+// under an earlier session still resolve after the metadata changed, and
+// saved to sessions.json so they survive an ingest restart (the broker
+// only retains an observer's latest session).
+const sessions = new Map();
+
+// Records whose session has not arrived yet, by observer/sid, held for up
+// to PENDING_WAIT_MS and then stored without the metadata.
+const pending = new Map();
+let pendingCount = 0;
+
+function loadSessions() {
+  const data = readJsonSafe(sessionsPath, { byKey: {} });
+  for (const [key, meta] of Object.entries(data.byKey || {})) {
+    if (meta && typeof meta === "object") sessions.set(key, meta);
+  }
+  while (sessions.size > SESSION_MAX) sessions.delete(sessions.keys().next().value);
+  if (sessions.size) logIngest("INFO", `loaded ${sessions.size} sessions`);
+}
+
+function saveSessions() {
+  writeJsonSafe(sessionsPath, { byKey: Object.fromEntries(sessions) });
+}
+
+function topicObserverId(topic) {
+  const m = String(topic || "").match(/observers\/([^/]+)\//i);
+  return m ? m[1] : null;
+}
+
+function rememberSession(topic, payload) {
+  let meta;
+  try {
+    meta = JSON.parse(String(payload || ""));
+  } catch {
+    return;
+  }
+  if (!meta || typeof meta !== "object" || meta.sid === undefined) return;
+  const observerId = String(meta.observerId || topicObserverId(topic) || "").trim();
+  if (!observerId) return;
+  const key = `${observerId}/${meta.sid}`;
+  sessions.delete(key);
+  sessions.set(key, meta);
+  if (sessions.size > SESSION_MAX) sessions.delete(sessions.keys().next().value);
+  saveSessions();
+  logIngest("SESSION", `observer=${observerId} sid=${meta.sid} name=${meta.observerName || "-"}`);
+  releasePending(key);
+}
+
+function sessionKey(topic, msg) {
+  const observerId = String(msg.observerId || topicObserverId(topic) || "").trim();
+  return `${observerId}/${msg.sid}`;
+}
+
+// Fills in what a session-referencing record leaves out.
+function applySession(topic, msg) {
+  if (msg.sid === undefined) return msg;
+  const observerId = String(msg.observerId || topicObserverId(topic) || "").trim();
+  const meta = sessions.get(sessionKey(topic, msg));
+  const merged = { ...msg, observerId };
+  if (meta) {
+    if (!merged.observerName && meta.observerName) merged.observerName = meta.observerName;
+    if (!merged.gps && meta.gps) merged.gps = meta.gps;
+  } else {
+    logIngest("WARN", `observer=${observerId} unknown sid=${msg.sid}`);
+  }
+  return merged;
+}
+
+function holdRecord(topic, msg) {
+  const key = sessionKey(topic, msg);
+  if (!pending.has(key)) pending.set(key, []);
+  pending.get(key).push({ topic, msg, at: Date.now() });
+  pendingCount++;
+  // Over the limit: give up waiting on the oldest session first.
+  while (pendingCount > PENDING_MAX) releasePending(pending.keys().next().value);
+}
+
+function releasePending(key) {
+  const held = pending.get(key);
+  if (!held) return;
+  pending.delete(key);
+  pendingCount -= held.length;
+  for (const { topic, msg } of held) ingestRecord(topic, applySession(topic, msg));
+}
+
+setInterval(() => {
+  const now = Date.now();
+  for (const [key, held] of pending) {
+    if (now - held[0].at >= PENDING_WAIT_MS) releasePending(key);
+  }
+}, 5000);
+
+loadSessions();
+
+client.on("message", (topic, payload) => {
+  if (String(topic).endsWith("/session")) {
+    rememberSession(topic, payload);
     return;
   }
+  for (const msg of parseRecords(payload)) {
+    if (!msg || typeof msg !== "object") continue;
+    if (msg.sid !== undefined && !sessions.has(sessionKey(topic, msg))) {
+      holdRecord(topic, msg);
+      continue;
+    }
+    ingestRecord(topic, applySession(topic, msg));
+  }
+});
 
+function ingestRecord(topic, msg) {
   const rawHex = String(msg.payloadHex || msg.raw || "").trim();
   if (!rawHex) return;
 
   const topicInfo = parseTopicInfo(topic);
-  const frameHash = String(msg.frameHash || msg.hash || "").trim() || sha256Hex(rawHex);
+  const frameHash = normalizeFrameHash(msg.frameHash || msg.hash) || normalizeFrameHash(sha256Hex(rawHex));
   const record = {
     archivedAt: new Date().toISOString(),
     type: "observer",
@@ -617,6 +756,9 @@ client.on("message", (topic, payload) => {
     observerId: String(msg.observerId || msg.origin || topicInfo.iata || "observer").trim(),
     observerName: String(msg.observerName || "").trim() || null,
     observerPub: String(msg.observerPub || topicInfo.pub || msg.origin_id || "").trim(),
+    rxUs: toNumber(msg.rxUs),
+    sid: toNumber(msg.sid),
+    seq: toNumber(msg.seq),
     rssi: toNumber(msg.rssi ?? msg.RSSI),
     snr: toNumber(msg.snr ?? msg.SNR),
     crc: msg.crc !== undefined ? !!msg.crc : true,
@@ -640,7 +782,7 @@ client.on("message", (topic, payload) => {
     "MSG",
     `observer=${record.observerId} rssi=${record.rssi ?? "?"} len=${record.len ?? "?"}`
   );
-});
+}
 
 client.on("error", (err) => {
   console.error("(mqtt-ingest) error", err.message);
@@ -0,0 +1,140 @@
+// tools/rf_capture/rf_capture_read.cpp
+//
+// Reads the sniffer's binary capture stream (mode bin) and prints the same
+// "rf" JSON lines the sniffer prints in JSON mode, one per line, so
+// existing consumers of rf.ndjson keep working.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/crc32 -I lib/cobs_frame -I lib/rf_record -I lib/obs_record -I lib/json_writer -I lib/hex_codec tools/rf_capture/rf_capture_read.cpp -o rf_capture_read
+//
+// Usage:
+//   stty -F /dev/ttyUSB0 921600 raw -echo
+//   rf_capture_read /dev/ttyUSB0 > rf.ndjson
+//   rf_capture_read capture.bin > rf.ndjson
+//
+// Link health goes to stderr on every stats frame and at the end:
+// framing errors by kind, records the sniffer wrote that never arrived,
+// records dropped on the device, and serial link utilization.
+#include <stdio.h>
+#include <string.h>
+#include "cobs_frame.h"
+#include "rf_record.h"
+
+#define FRAME_MAX COBS_FRAME_MAX(RF_RECORD_MAX)
+
+struct LinkCounters {
+  unsigned long bytes = 0;
+  unsigned long frames = 0;
+  unsigned long records = 0;
+  unsigned long badEncoding = 0;
+  unsigned long badCrc = 0;
+  unsigned long tooLong = 0;
+  unsigned long unknownType = 0;
+  unsigned long textLines = 0;
+};
+
+static LinkCounters counters;
+static RfStats lastStats;
+static unsigned long lastStatsRecords = 0;
+static bool haveStats = false;
+static double lastUtil = -1.0;  // needs two stats frames
+static unsigned long lost = 0;
+
+static void report(const RfStats *st) {
+  fprintf(stderr,
+          "[rf_capture] records=%lu frames=%lu badCobs=%lu badCrc=%lu tooLong=%lu unknown=%lu lost=%lu",
+          counters.records, counters.frames, counters.badEncoding, counters.badCrc, counters.tooLong, counters.unknownType, lost);
+  if (st) {
+    fprintf(stderr, " uptimeS=%u deviceDrops=%u baud=%u", (unsigned)(st->uptimeMs / 1000),
+            (unsigned)st->queueDrops, (unsigned)st->baud);
+    if (lastUtil >= 0.0) fprintf(stderr, " util=%.1f%%", lastUtil * 100.0);
+  }
+  fputc('\n', stderr);
+}
+
+// Utilization is what the sniffer wrote between two stats frames over what
+// the UART could carry in that time (10 bits per byte).
+static void onStats(const RfStats &st) {
+  if (haveStats && st.uptimeMs > lastStats.uptimeMs && st.baud) {
+    double seconds = (st.uptimeMs - lastStats.uptimeMs) / 1000.0;
+    lastUtil = (double)(uint32_t)(st.txBytes - lastStats.txBytes) * 10.0 / (seconds * st.baud);
+    uint32_t sent = st.records - lastStats.records;
+    unsigned long got = counters.records - lastStatsRecords;
+    if (sent > got) lost += sent - got;
+  }
+  lastStats = st;
+  lastStatsRecords = counters.records;
+  haveStats = true;
+  report(&st);
+}
+
+static bool isText(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if ((data[i] < 0x20 || data[i] > 0x7E) && data[i] != '\r' && data[i] != '\n') return false;
+  }
+  return len > 0;
+}
+
+static void onFrame(const uint8_t *data, size_t len) {
+  static uint8_t rec[FRAME_MAX];
+  static char json[1024];
+  if (len == 0) return;
+  size_t recLen = 0;
+  switch (cobsFrameDecode(data, len, rec, sizeof(rec), recLen)) {
+    case COBS_FRAME_BAD_ENCODING: counters.badEncoding++; return;
+    case COBS_FRAME_TOO_LONG: counters.tooLong++; return;
+    case COBS_FRAME_BAD_CRC: counters.badCrc++; return;
+    case COBS_FRAME_OK: break;
+  }
+  counters.frames++;
+  RfRecord r;
+  RfStats st;
+  if (rfRecordDecode(rec, recLen, r)) {
+    size_t n = rfRecordJson(r, json, sizeof(json));
+    if (n >= 2) {
+      fwrite(json, 1, n - 2, stdout);  // CR LF -> LF
+      fputc('\n', stdout);
+      counters.records++;
+    }
+  } else if (rfStatsDecode(rec, recLen, st)) {
+    onStats(st);
+  } else {
+    counters.unknownType++;
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : nullptr;
+  FILE *in = path ? fopen(path, "rb") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  static uint8_t frame[FRAME_MAX];
+  size_t len = 0;
+  bool overflow = false;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    counters.bytes++;
+    if (c == COBS_FRAME_DELIM) {
+      if (overflow) counters.tooLong++;
+      else onFrame(frame, len);
+      len = 0;
+      overflow = false;
+      continue;
+    }
+    // Command replies the sniffer prints around a mode switch.
+    if (c == '\n' && len && frame[0] == '[' && isText(frame, len)) {
+      fprintf(stderr, "%.*s\n", (int)(len && frame[len - 1] == '\r' ? len - 1 : len), (const char *)frame);
+      counters.textLines++;
+      len = 0;
+      continue;
+    }
+    if (len < sizeof(frame)) frame[len++] = (uint8_t)c;
+    else overflow = true;
+  }
+  if (in != stdin) fclose(in);
+  report(haveStats ? &lastStats : nullptr);
+  return 0;
+}
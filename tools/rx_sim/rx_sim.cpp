@@ -0,0 +1,282 @@
+// tools/rx_sim/rx_sim.cpp
+//
+// Feeds back-to-back LoRa frames, each starting the moment the previous one
+// ends, to a simulated SX1262 and the observer's receive path, and counts
+// the frames that are lost. Two orderings are compared:
+//
+//   rearm-first   the observer: the RX task runs rxCapture() from
+//                 lib/rx_capture, which reads the FIFO into a lib/frame_ring
+//                 slot, calls startReceive(), then hashes; the proc task
+//                 serializes and queues from the ring.
+//   process-first the baseline loop(): read, hash, build the JSON String,
+//                 print it, publish, and only then startReceive().
+//
+// The radio model: after RxDone the SX1262 receives nothing until
+// startReceive(), and it locks onto a frame only if it is listening before
+// PREAMBLE_DETECT_SYMBOLS of the preamble are left. Airtime follows the
+// Semtech formula for the observer's SF, bandwidth and coding rate.
+// Timing is simulated, so runs are exact and repeatable. The rearm-first
+// side is the firmware's own capture step: rxCapture() and the real
+// FrameRing, driven through a fake radio that advances the clock on each
+// call and logs it, so every capture is also checked to call startReceive()
+// after readData() and before the hash, and to commit the slot only after
+// hashing. Every slot carries its frame number so the consumer checks
+// order, and a full ring must still empty the FIFO and re-arm.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/frame_ring -I lib/rx_capture tools/rx_sim/rx_sim.cpp -o rx_sim
+//
+// Usage:
+//   rx_sim [--len B] [--frames N] [--proc-ms M] [--stall-ms M] [--stall-every N] [--publish-ms M]
+//
+// --proc-ms is the proc task's time per frame, --stall-ms a stall of the
+// proc task (a blocking spool write) every --stall-every frames, and
+// --publish-ms the baseline's inline MQTT publish. Without --len it runs
+// 16, 100 and 255-byte frames. Exits 1 if rearm-first loses a frame or a
+// capture runs out of order, or if process-first loses none (the model
+// would not be exercising the gap).
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include "frame_ring.h"
+#include "rx_capture.h"
+
+// Observer radio settings (src/observer_main.cpp RF PARAMETERS).
+#define SIM_SF         8
+#define SIM_BW_HZ      62500.0
+#define SIM_CR         4  // 4/8
+#define SIM_PREAMBLE   8  // RadioLib default
+#define PREAMBLE_DETECT_SYMBOLS 5
+#define RX_RING_SLOTS  16
+
+// Costs in microseconds, from the observer's own status counters and
+// datasheet figures: SPI at 8 MHz, the SHA peripheral, a 450-byte JSON
+// line at 115200 baud.
+#define WAKE_US        40     // DIO1 to RX task running (status wakeMaxUs)
+#define READ_US(len)   (120 + (len))  // getPacketLength, RSSI, SNR, readData
+#define REARM_US       150    // startReceive
+#define SHA_HW_US      60
+#define SHA_SOFT_US    900
+#define JSON_STRING_US 1500
+#define SERIAL_LINE_US 39000
+
+struct Options {
+  int len = 0;
+  unsigned frames = 2000;
+  double procMs = 2;
+  double stallMs = 400;
+  unsigned stallEvery = 25;
+  double publishMs = 20;
+};
+
+struct Result {
+  unsigned received = 0;
+  unsigned missed = 0;
+  unsigned overflow = 0;
+  unsigned hwm = 0;
+  unsigned badCaptures = 0;  // calls out of order, or a slot committed before its hash
+  double rearmMaxUs = 0;
+  bool ordered = true;
+};
+
+// The RadioLib calls rxCapture() makes, on a simulated clock. Each call is
+// logged by its first letter: l(ength), r(ssi), s(nr), d(ata read),
+// a(rm); the hash adds h.
+struct SimRadio {
+  double now = 0;
+  double armedAt = 0;
+  uint32_t seq = 0;
+  int len = 0;
+  std::string calls;
+
+  int getPacketLength() {
+    calls += 'l';
+    return len;
+  }
+  float getRSSI() {
+    calls += 'r';
+    return -100;
+  }
+  float getSNR() {
+    calls += 's';
+    return 5;
+  }
+  int readData(uint8_t *data, size_t n) {
+    calls += 'd';
+    memset(data, 0, n);
+    memcpy(data, &seq, sizeof(seq));
+    now += READ_US(len);
+    return 0;
+  }
+  int startReceive() {
+    calls += 'a';
+    now += REARM_US;
+    armedAt = now;
+    return 0;
+  }
+};
+
+// Runs one capture of frame `seq` at time t; false if it went out of order.
+template <size_t N>
+static bool simCapture(SimRadio &radio, FrameRing<N> &ring, RxFrame &scratch, uint32_t seq, int len, double t,
+                       bool &committed) {
+  radio.now = t;
+  radio.seq = seq;
+  radio.len = len;
+  radio.calls.clear();
+  size_t depth = ring.size();
+  bool hashedFirst = true;
+  const RxFrame &f = rxCapture(radio, ring, scratch, (int64_t)t, [&](const uint8_t *, size_t, uint8_t *) {
+    radio.calls += 'h';
+    if (ring.size() != depth) hashedFirst = false;
+    radio.now += SHA_HW_US;
+  });
+  committed = &f != &scratch;
+  return radio.calls == (committed ? "lrsdah" : "lrsda") && hashedFirst && ring.size() == depth + committed;
+}
+
+static double airtimeUs(int len) {
+  double sym = (1 << SIM_SF) / SIM_BW_HZ * 1e6;
+  int de = sym > 16000 ? 1 : 0;
+  double n = ceil((8.0 * len - 4 * SIM_SF + 28 + 16) / (4.0 * (SIM_SF - 2 * de)));
+  if (n < 0) n = 0;
+  return (SIM_PREAMBLE + 4.25) * sym + (8 + n * (SIM_CR + 4)) * sym;
+}
+
+static double lockSlackUs() {
+  return (SIM_PREAMBLE - PREAMBLE_DETECT_SYMBOLS) * (1 << SIM_SF) / SIM_BW_HZ * 1e6;
+}
+
+static Result simulate(const Options &o, int len, bool rearmFirst) {
+  std::unique_ptr<FrameRing<RX_RING_SLOTS>> owner(new FrameRing<RX_RING_SLOTS>());
+  FrameRing<RX_RING_SLOTS> &ring = *owner;
+  static RxFrame scratch;
+  SimRadio radio;
+  Result r;
+  double air = airtimeUs(len), slack = lockSlackUs();
+  double armedAt = 0, rxFree = 0, procFree = 0;
+  std::deque<double> procDone;  // when the proc task releases each slot
+  uint32_t expect = 0;
+  auto releaseUntil = [&](double t) {
+    while (!procDone.empty() && procDone.front() <= t) {
+      const RxFrame *f = ring.peek();
+      uint32_t seq;
+      memcpy(&seq, f->data, sizeof(seq));
+      if (seq < expect) r.ordered = false;
+      expect = seq + 1;
+      ring.release();
+      procDone.pop_front();
+    }
+  };
+  for (uint32_t k = 0; k < o.frames; k++) {
+    double start = k * air, end = start + air;
+    if (armedAt > start + slack) {
+      r.missed++;
+      continue;
+    }
+    r.received++;
+    // DIO1 at RxDone; the radio stays deaf until startReceive().
+    double t = std::max(end + WAKE_US, rxFree);
+    double procUs = o.procMs * 1000 + (o.stallEvery && k % o.stallEvery == 0 ? o.stallMs * 1000 : 0);
+    if (rearmFirst) {
+      releaseUntil(t);
+      bool committed;
+      if (!simCapture(radio, ring, scratch, k, len, t, committed)) r.badCaptures++;
+      armedAt = radio.armedAt;
+      rxFree = radio.now;
+      if (committed) {
+        procFree = std::max(procFree, rxFree) + procUs;
+        procDone.push_back(procFree);
+      } else {
+        r.overflow++;
+      }
+    } else {
+      armedAt = t + READ_US(len) + SHA_SOFT_US + JSON_STRING_US + SERIAL_LINE_US + o.publishMs * 1000 +
+                (procUs - o.procMs * 1000);
+      rxFree = armedAt + REARM_US;
+      armedAt = rxFree;
+    }
+    r.rearmMaxUs = std::max(r.rearmMaxUs, armedAt - end);
+  }
+  releaseUntil(1e300);
+  r.hwm = ring.highWater();
+  return r;
+}
+
+static bool run(const Options &o, int len) {
+  Result a = simulate(o, len, true), b = simulate(o, len, false);
+  bool ok = true;
+  if (a.missed || a.overflow || !a.ordered || a.badCaptures) {
+    fprintf(stderr, "  rearm-first lost %u frames (%u on overflow)%s, %u captures out of order\n",
+            a.missed + a.overflow, a.overflow, a.ordered ? "" : ", out of order", a.badCaptures);
+    ok = false;
+  }
+  if (!b.missed) {
+    fprintf(stderr, "  process-first lost nothing; the model is not exercising the gap\n");
+    ok = false;
+  }
+  const Result *rs[] = {&a, &b};
+  const char *names[] = {"rearm-first", "process-first"};
+  for (int i = 0; i < 2; i++) {
+    printf("%5d %9.1f %-14s %7u %9u %7u %9u %4u %10.0f  %s\n", len, airtimeUs(len) / 1000, names[i], o.frames,
+           rs[i]->received, rs[i]->missed, rs[i]->overflow, rs[i]->hwm, rs[i]->rearmMaxUs, ok ? "ok" : "FAIL");
+  }
+  return ok;
+}
+
+// With the ring full, a capture must still read the FIFO and re-arm the
+// radio, skip the hash and count an overflow.
+static bool checkFullRing() {
+  FrameRing<2> ring;
+  static RxFrame scratch;
+  SimRadio radio;
+  bool committed, ok = true;
+  for (uint32_t k = 0; k < 3; k++) {
+    ok = simCapture(radio, ring, scratch, k, 16, k * 1000.0, committed) && committed == (k < 2) && ok;
+  }
+  ok = ok && ring.overflows() == 1 && ring.size() == 2 && radio.calls == "lrsda";
+  if (!ok) fprintf(stderr, "full ring: calls=%s overflows=%u\n", radio.calls.c_str(), (unsigned)ring.overflows());
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--len") && more) o.len = atoi(argv[++i]);
+    else if (!strcmp(a, "--frames") && more) o.frames = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--proc-ms") && more) o.procMs = atof(argv[++i]);
+    else if (!strcmp(a, "--stall-ms") && more) o.stallMs = atof(argv[++i]);
+    else if (!strcmp(a, "--stall-every") && more) o.stallEvery = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--publish-ms") && more) o.publishMs = atof(argv[++i]);
+    else {
+      fprintf(stderr,
+              "usage: rx_sim [--len B] [--frames N] [--proc-ms M] [--stall-ms M] [--stall-every N] "
+              "[--publish-ms M]\n");
+      return 2;
+    }
+  }
+  if (o.len < 0 || o.len > 255) {
+    fprintf(stderr, "--len must be 0..255\n");
+    return 2;
+  }
+  printf("SF%d BW%.1fkHz CR4/%d preamble=%d lock slack=%.1fms ring=%d proc=%.1fms stall=%.0fms/%u publish=%.0fms\n",
+         SIM_SF, SIM_BW_HZ / 1000, SIM_CR + 4, SIM_PREAMBLE, lockSlackUs() / 1000, RX_RING_SLOTS, o.procMs,
+         o.stallMs, o.stallEvery, o.publishMs);
+  printf("%5s %9s %-14s %7s %9s %7s %9s %4s %10s\n", "len", "airMs", "ordering", "frames", "received", "missed",
+         "overflow", "hwm", "rearmMaxUs");
+  bool ok = checkFullRing();
+  if (o.len) {
+    ok = run(o, o.len);
+  } else {
+    const int lens[] = {16, 100, 255};
+    for (int len : lens) ok = run(o, len) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,657 @@
+// tools/spool_sim/spool_sim.cpp
+//
+// Replays uplink outages against the observer's two spool tiers, a
+// lib/ram_ring in front of lib/spool on a RAM-backed filesystem with the
+// observer's partition size, then drains both as a reconnect would. Checks
+// that flash use stays within the configured capacity, that only the
+// oldest records are lost, that a reboot in the middle of an outage of an
+// hour or more picks up head and tail from the meta file, and that an
+// outage shorter than the RAM tier's age limit never commits to flash.
+// That reboot tears the last write: the tail segment loses its last few
+// bytes (outages under 12 hours) or has its last byte flipped (longer
+// ones), and begin() must cut off exactly that record and carry on with
+// the next seq.
+//
+// The drain acks records the way a QoS 1 flush does (a window of
+// DRAIN_WINDOW in flight, acked in order), drops the link every
+// DRAIN_DROP_EVERY steps, losing whatever is in flight, and reboots once
+// part way through the flash replay, losing the RAM tier. Records may only
+// be delivered twice across that reboot, at most SPOOL_CHECKPOINT_RECORDS
+// of them.
+//
+// Before the outages, a /spool.ndjson as the firmware before the segment
+// ring left it (JSON lines, hex lines for binary records, a few lines that
+// are not records and a torn last line) is imported into an empty ring and
+// must drain back record for record, with the bad lines counted as
+// discarded and the file gone. Likewise a text-line ring as the firmware
+// before binary records left it (SPL2 meta, part of the head segment
+// acked) must be converted by begin() with nothing evicted, drain back
+// from the acked record on, and leave no text segment behind, also when
+// an earlier conversion was cut short and left a torn binary segment. A ring
+// whose newest meta slot is torn, or that has no meta at all, must come
+// back whole, and a stray segment file past its tail must be removed;
+// no segment may outgrow the segment size when the tail is closed
+// between commits.
+//
+// Build:
+//   g++ -O2 -std=c++17 -I lib/spool -I lib/ram_ring -I lib/crc32 tools/spool_sim/spool_sim.cpp -o spool_sim
+//
+// Usage:
+//   spool_sim [--hours H] [--rate N] [--size B] [--partition KB] [--fill PCT] [--segment KB] [--drain-bps N]
+//             [--ram KB] [--ram-fill PCT] [--ram-age S]
+//
+// --rate is records per minute, --size the record size in bytes (default
+// a typical 450-byte JSON record), --fill the share of free flash the
+// spool may use, --drain-bps the observer's catch-up bandwidth target
+// (spool.drain.bps), used to report how long the replay takes. --ram,
+// --ram-fill and --ram-age set the RAM tier (size, spill threshold, age
+// limit; --ram 0 spools straight to flash). Without --hours it runs an 18
+// second blip and 1, 4, 12 and 48 hour outages.
+// Exits 1 if any check fails.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "ram_ring.h"
+#include "spool.h"
+
+#define PAGE 256
+#define DRAIN_WINDOW 16
+#define DRAIN_DROP_EVERY 701
+#define DRAIN_REBOOT_AT 1500
+
+// Files are strings; space is charged per started page plus one header
+// page per file, roughly how SPIFFS allocates.
+class RamFs;
+
+class RamFile {
+ public:
+  RamFile() {}
+  RamFile(RamFs *fs, std::shared_ptr<std::string> data, bool append) : fs_(fs), data_(data), append_(append) {}
+  // A directory listing, as open("/") returns on SPIFFS.
+  RamFile(RamFs *fs, std::vector<std::string> entries) : fs_(fs), entries_(entries), dir_(true) {}
+  explicit operator bool() const { return data_ || dir_; }
+  RamFile openNextFile();
+  // The base name, as arduino-esp32 2.x returns it.
+  const char *name() const { return name_.c_str(); }
+  size_t write(const uint8_t *buf, size_t len);
+  int read(uint8_t *buf, size_t len) {
+    if (!data_ || pos_ >= data_->size()) return 0;
+    size_t n = std::min(len, data_->size() - pos_);
+    memcpy(buf, data_->data() + pos_, n);
+    pos_ += n;
+    return (int)n;
+  }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  bool seek(uint32_t pos) {
+    pos_ = pos;
+    return data_ && pos <= data_->size();
+  }
+  void flush() {}
+  void close() {
+    data_.reset();
+    dir_ = false;
+  }
+
+ private:
+  RamFs *fs_ = nullptr;
+  std::shared_ptr<std::string> data_;
+  bool append_ = false;
+  size_t pos_ = 0;
+  std::vector<std::string> entries_;
+  size_t nextEntry_ = 0;
+  bool dir_ = false;
+  std::string name_;
+};
+
+class RamFs {
+ public:
+  explicit RamFs(size_t total) : total_(total) {}
+
+  RamFile open(const char *path, const char *mode) {
+    auto it = files_.find(path);
+    if (mode[0] == 'r' && !strcmp(path, "/")) {
+      std::vector<std::string> names;
+      for (const auto &f : files_) names.push_back(f.first);
+      return RamFile(this, names);
+    }
+    if (mode[0] == 'r') {
+      return it == files_.end() ? RamFile() : RamFile(this, it->second, false);
+    }
+    if (it == files_.end() || mode[0] == 'w') {
+      files_[path] = std::make_shared<std::string>();
+      it = files_.find(path);
+    }
+    return RamFile(this, it->second, true);
+  }
+  bool exists(const char *path) { return files_.count(path) != 0; }
+  bool remove(const char *path) { return files_.erase(path) != 0; }
+
+  size_t usedBytes() const {
+    size_t used = 0;
+    for (const auto &f : files_) used += (f.second->size() + PAGE - 1) / PAGE * PAGE + PAGE;
+    return used;
+  }
+  size_t totalBytes() const { return total_; }
+
+  // A power cut in the middle of a write to the newest <prefix>.<n>: drops
+  // its last chop bytes, or flips its last byte. False if there is none.
+  bool tear(const char *prefix, size_t chop, bool flip) {
+    std::string *newest = nullptr;
+    unsigned long top = 0;
+    size_t plen = strlen(prefix);
+    for (auto &f : files_) {
+      const char *name = f.first.c_str();
+      char *endp;
+      if (strncmp(name, prefix, plen) || name[plen] != '.') continue;
+      unsigned long n = strtoul(name + plen + 1, &endp, 10);
+      if (*endp || endp == name + plen + 1 || (newest && n < top)) continue;
+      newest = f.second.get();
+      top = n;
+    }
+    if (!newest || newest->size() <= chop) return false;
+    if (flip) newest->back() ^= 0x5A;
+    else newest->resize(newest->size() - chop);
+    return true;
+  }
+
+ private:
+  size_t total_;
+  std::map<std::string, std::shared_ptr<std::string>> files_;
+};
+
+RamFile RamFile::openNextFile() {
+  while (dir_ && nextEntry_ < entries_.size()) {
+    const std::string &path = entries_[nextEntry_++];
+    RamFile f = fs_->open(path.c_str(), "r");
+    if (!f) continue;  // removed since the listing
+    f.name_ = path.substr(path.rfind('/') + 1);
+    return f;
+  }
+  return RamFile();
+}
+
+size_t RamFile::write(const uint8_t *buf, size_t len) {
+  if (!data_ || !append_) return 0;
+  size_t room = fs_->totalBytes() > fs_->usedBytes() ? fs_->totalBytes() - fs_->usedBytes() : 0;
+  size_t n = std::min(len, room);
+  data_->append((const char *)buf, n);
+  return n;
+}
+
+typedef Spool<RamFs, RamFile, 4096> SimSpool;
+
+struct Options {
+  double hours = 0;
+  unsigned rate = 60;
+  size_t size = 450;
+  size_t partitionKb = 1408;  // default 4 MB flash layout
+  unsigned fillPct = 70;
+  size_t segmentKb = 16;
+  unsigned drainBps = 16384;
+  size_t ramKb = 24;
+  unsigned ramFillPct = 75;
+  unsigned ramAgeS = 30;
+};
+
+struct Inflight {
+  uint64_t seq;
+  SpoolPos end;
+  bool ram;
+};
+
+static std::string makeRecord(uint64_t seq, size_t size) {
+  char head[48];
+  snprintf(head, sizeof(head), "{\"seq\":%llu,\"pad\":\"", (unsigned long long)seq);
+  std::string rec = head;
+  if (rec.size() + 2 < size) rec.append(size - rec.size() - 2, 'x');
+  rec += "\"}";
+  return rec;
+}
+
+static uint64_t recordSeq(const uint8_t *data, size_t len) {
+  std::string s((const char *)data, len);
+  return strtoull(s.c_str() + 7, nullptr, 10);
+}
+
+#define LEGACY_RECORDS 1000
+#define TEXT_RING_HEAD 3
+#define TEXT_RING_ACKED 10  // records acked in the head segment
+#define META_RECORDS 300
+
+// Record i as the text spools wrote it: every fifth one binary, as hex.
+static std::string textLine(unsigned i, size_t size, std::string &rec) {
+  if (i % 5) {
+    rec = makeRecord(i, size);
+    return rec + (i % 7 ? "\n" : "\r\n");
+  }
+  rec = "\xB1" + std::to_string(i) + std::string(i % 64, '\0');
+  std::string line;
+  for (unsigned char c : rec) {
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02X", c);
+    line += hex;
+  }
+  return line + '\n';
+}
+
+// Drains the spool, acking as it goes; true if it hands back expect.
+static bool drainsTo(SimSpool &spool, const std::vector<std::string> &expect) {
+  uint8_t buf[2048];
+  size_t len, got = 0;
+  SpoolPos end;
+  bool ok = true;
+  while (ok && spool.next(buf, sizeof(buf), len, end)) {
+    ok = got < expect.size() && std::string((const char *)buf, len) == expect[got];
+    got++;
+    spool.ack(end);
+  }
+  return ok && got == expect.size();
+}
+
+static bool checkLegacyImport(const Options &o) {
+  RamFs fs(o.partitionKb * 1024);
+  std::vector<std::string> expect;
+  std::string text, rec;
+  for (unsigned i = 0; i < LEGACY_RECORDS; i++) {
+    text += textLine(i, o.size, rec);
+    expect.push_back(rec);
+    if (i == 500) text += "\nZZ12\nB1A\n";  // blank, not hex, odd length
+  }
+  text += "{\"seq\":99999,\"pad\":\"to";  // torn
+  RamFile f = fs.open("/spool.ndjson", "w");
+  f.write((const uint8_t *)text.data(), text.size());
+  f.close();
+
+  SimSpool spool(fs, "/spool", o.segmentKb * 1024);
+  spool.begin((fs.totalBytes() - fs.usedBytes()) * o.fillPct / 100);
+  size_t imported = spool.importText("/spool.ndjson");
+  spool.close();
+  bool ok = imported == expect.size() && !fs.exists("/spool.ndjson") && spool.stats().discarded == 3;
+  ok = ok && drainsTo(spool, expect);
+  printf("legacy import: %zu of %zu records, %u discarded  %s\n", imported, expect.size(),
+         (unsigned)spool.stats().discarded, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// With cut, a power cut ended an earlier conversion: the text segments and
+// meta are all still there, and so is a half-written binary segment after
+// them, torn in the middle of a record.
+static bool checkTextRing(const Options &o, bool cut) {
+  RamFs fs(o.partitionKb * 1024);
+  std::vector<std::string> expect;
+  std::string text, rec;
+  uint32_t seg = TEXT_RING_HEAD, ackOff = 0;
+  unsigned records = 0;
+  auto writeSegment = [&] {
+    char path[SPOOL_PATH_MAX];
+    snprintf(path, sizeof(path), "/spool.%u", (unsigned)seg++);
+    RamFile f = fs.open(path, "w");
+    f.write((const uint8_t *)text.data(), text.size());
+    f.close();
+    text.clear();
+  };
+  for (unsigned i = 0; i < LEGACY_RECORDS; i++) {
+    std::string line = textLine(i, o.size, rec);
+    if (text.size() + line.size() > o.segmentKb * 1024) writeSegment();
+    text += line;
+    if (seg == TEXT_RING_HEAD && i < TEXT_RING_ACKED) {
+      ackOff = (uint32_t)text.size();
+      continue;
+    }
+    expect.push_back(rec);
+    records++;
+    if (i == 500) text += "ZZ12\n";
+  }
+  text += "{\"seq\":99999,\"pad\":\"to";  // torn
+  writeSegment();
+  uint32_t meta[4] = {SPOOL_META_MAGIC_V2, TEXT_RING_HEAD, seg - 1, ackOff};
+  RamFile f = fs.open("/spool.meta", "w");
+  f.write((const uint8_t *)meta, sizeof(meta));
+  f.close();
+  char leftover[SPOOL_PATH_MAX];
+  snprintf(leftover, sizeof(leftover), "/spool.%u", (unsigned)seg);
+  if (cut) {
+    SimSpool partial(fs, "/spool.cut", o.segmentKb * 1024);
+    partial.begin(0);
+    for (unsigned i = 0; i < 20; i++) {
+      std::string r = makeRecord(100000 + i, o.size);
+      partial.append((const uint8_t *)r.data(), r.size(), 0);
+    }
+    partial.close();
+    RamFile from = fs.open("/spool.cut.0", "r");
+    std::string bytes(from.size() - 7, '\0');
+    from.read((uint8_t *)&bytes[0], bytes.size());
+    from.close();
+    RamFile to = fs.open(leftover, "w");
+    to.write((const uint8_t *)bytes.data(), bytes.size());
+    to.close();
+    fs.remove("/spool.cut.0");
+    fs.remove("/spool.cut.meta1");
+  }
+
+  // As the observer does: size the ring from what begin() found.
+  SimSpool spool(fs, "/spool", o.segmentKb * 1024);
+  size_t spooled = spool.begin(0);
+  spool.setCapacity((fs.totalBytes() - fs.usedBytes() + spooled) * o.fillPct / 100);
+  bool converted = true;
+  for (uint32_t s = TEXT_RING_HEAD; s < seg; s++) {
+    char path[SPOOL_PATH_MAX];
+    snprintf(path, sizeof(path), "/spool.%u", (unsigned)s);
+    converted = converted && !fs.exists(path);
+  }
+  // Both meta slots must hold the new ring.
+  for (const char *slot : {"/spool.meta", "/spool.meta1"}) {
+    f = fs.open(slot, "r");
+    converted = converted && f.read((uint8_t *)meta, sizeof(meta)) == (int)sizeof(meta) && meta[0] == SPOOL_META_MAGIC;
+    f.close();
+  }
+  const SpoolStats &st = spool.stats();
+  bool ok = converted && (!cut || !fs.exists(leftover)) && st.orphaned == cut && st.imported == records &&
+            st.discarded == 2 && !st.evicted && drainsTo(spool, expect);
+  printf("text ring%s: %u segments, %u of %u records after the ack, %u discarded  %s\n", cut ? " after a cut" : "",
+         (unsigned)(seg - TEXT_RING_HEAD), (unsigned)st.imported, records, (unsigned)st.discarded, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// Fills a ring with records, closing the tail every few of them as the
+// drain does, and checks that no segment outgrew the segment size.
+static bool fillRing(RamFs &fs, const Options &o, std::vector<std::string> &expect) {
+  SimSpool spool(fs, "/spool", o.segmentKb * 1024);
+  spool.begin((fs.totalBytes() - fs.usedBytes()) * o.fillPct / 100);
+  for (unsigned i = 0; i < META_RECORDS; i++) {
+    expect.push_back(makeRecord(i, o.size));
+    spool.append((const uint8_t *)expect.back().data(), expect.back().size(), 0);
+    if (i % 7 == 6) spool.close();
+  }
+  spool.close();
+  for (uint32_t s = 0; s <= spool.segmentCount(); s++) {
+    char path[SPOOL_PATH_MAX];
+    snprintf(path, sizeof(path), "/spool.%u", (unsigned)s);
+    RamFile f = fs.open(path, "r");
+    if (f && f.size() > o.segmentKb * 1024) {
+      fprintf(stderr, "  %s holds %zu bytes, over the segment size\n", path, f.size());
+      return false;
+    }
+  }
+  return true;
+}
+
+// Generation in a meta slot, -1 if it holds none.
+static int64_t metaGeneration(RamFs &fs, const char *path) {
+  uint32_t meta[SPOOL_META_WORDS];
+  RamFile f = fs.open(path, "r");
+  if (!f || f.read((uint8_t *)meta, sizeof(meta)) != (int)sizeof(meta) || meta[0] != SPOOL_META_MAGIC) return -1;
+  return meta[1];
+}
+
+// The ring must survive losing its meta: a torn newest slot falls back to
+// the other one, no valid slot rebuilds it from the segment files, and a
+// stray segment file past the tail is removed.
+static bool checkMetaLoss(const Options &o) {
+  bool ok = true;
+  const char *cases[] = {"torn slot", "no meta", "orphan"};
+  for (int c = 0; c < 3; c++) {
+    RamFs fs(o.partitionKb * 1024);
+    std::vector<std::string> expect;
+    bool good = fillRing(fs, o, expect);
+    if (c == 0) {
+      const char *newest = metaGeneration(fs, "/spool.meta1") > metaGeneration(fs, "/spool.meta") ? "/spool.meta1"
+                                                                                                 : "/spool.meta";
+      RamFile f = fs.open(newest, "w");
+      f.write((const uint8_t *)"SPL4\x01", 5);
+      f.close();
+    } else if (c == 1) {
+      fs.remove("/spool.meta");
+      fs.remove("/spool.meta1");
+    } else {
+      RamFile f = fs.open("/spool.999", "w");
+      f.write((const uint8_t *)"stray", 5);
+      f.close();
+    }
+    SimSpool spool(fs, "/spool", o.segmentKb * 1024);
+    spool.begin((fs.totalBytes() - fs.usedBytes()) * o.fillPct / 100);
+    const SpoolStats &st = spool.stats();
+    uint32_t segments = spool.segmentCount();
+    good = good && st.metaRebuilt == (c == 1) && st.orphaned == (c == 2) && !fs.exists("/spool.999");
+    good = good && drainsTo(spool, expect);
+    printf("meta loss, %s: %u segments, rebuilt %u, orphans %u  %s\n", cases[c], (unsigned)segments,
+           (unsigned)st.metaRebuilt, (unsigned)st.orphaned, good ? "ok" : "FAIL");
+    ok = ok && good;
+  }
+  return ok;
+}
+
+static bool simulate(const Options &o, double hours) {
+  RamFs fs(o.partitionKb * 1024);
+  size_t capacity = (fs.totalBytes() - fs.usedBytes()) * o.fillPct / 100;
+  std::unique_ptr<SimSpool> spool(new SimSpool(fs, "/spool", o.segmentKb * 1024));
+  spool->begin(capacity);
+  std::vector<uint8_t> ramBuf(o.ramKb * 1024);
+  RamRing ram;
+  ram.begin(ramBuf.data(), ramBuf.size());
+  uint8_t buf[2048];
+  size_t len;
+  unsigned spills = 0;
+  // The observer's spool job moves the whole ring to flash once it is
+  // spilling; at these record rates that takes a single run.
+  auto spill = [&](uint32_t now, size_t maxRecords) {
+    for (size_t i = 0; i < maxRecords && ram.front(buf, sizeof(buf), len); i++) {
+      spool->append(buf, len, now);
+      ram.pop();
+    }
+  };
+
+  uint64_t totalMs = (uint64_t)(hours * 3600 * 1000);
+  uint64_t stepMs = 60000 / (o.rate ? o.rate : 1);
+  uint64_t seq = 0;
+  size_t peak = 0;
+  bool rebooted = false, tore = false;
+  uint32_t flashOps = 0, evicted = 0;
+  uint64_t flashBytes = 0, recordBytes = 0;
+  for (uint64_t t = 0; t < totalMs; t += stepMs) {
+    std::string rec = makeRecord(seq++, o.size);
+    const uint8_t *data = (const uint8_t *)rec.data();
+    uint32_t now = (uint32_t)t;
+    bool ok = ram.push(data, rec.size(), now);
+    while (!ok && ram.records()) {
+      spill(now, 1);
+      ok = ram.push(data, rec.size(), now);
+    }
+    if (!ok) spool->append(data, rec.size(), now);
+    if (ram.records() && (ram.bytes() * 100 >= ram.capacity() * o.ramFillPct ||
+                          now - ram.oldestMs() >= o.ramAgeS * 1000)) {
+      spills++;
+      spill(now, SIZE_MAX);
+    }
+    spool->service(now);
+    peak = std::max(peak, fs.usedBytes());
+    if (!rebooted && hours >= 1 && t >= totalMs / 2) {
+      // Power cycle in the middle of a commit: the record written last is
+      // torn, the ones before it must survive.
+      spool->commit();
+      uint32_t nextSeq = spool->nextSeq();
+      tore = fs.tear("/spool", 7, hours >= 12);
+      const SpoolStats &s = spool->stats();
+      flashOps += s.flashOps;
+      evicted += s.evicted;
+      flashBytes += s.flashBytes;
+      recordBytes += s.recordBytes;
+      spool.reset(new SimSpool(fs, "/spool", o.segmentKb * 1024));
+      spool->begin(capacity);
+      if (tore && (spool->stats().torn != 1 || spool->nextSeq() != nextSeq - 1)) {
+        fprintf(stderr, "  torn tail not recovered: torn %u, next seq %u, expected %u\n",
+                (unsigned)spool->stats().torn, (unsigned)spool->nextSeq(), (unsigned)(nextSeq - 1));
+        return false;
+      }
+      ram.begin(ramBuf.data(), ramBuf.size());
+      rebooted = true;
+    }
+  }
+  spool->close();
+  uint32_t commits = spool->stats().commits;
+  const SpoolStats &s = spool->stats();
+  flashOps += s.flashOps;
+  evicted += s.evicted;
+  flashBytes += s.flashBytes;
+  recordBytes += s.recordBytes;
+
+  // Reconnect: drain flash, then the RAM tier. A record counts as
+  // delivered when its ack is applied; drained keeps first deliveries in
+  // order.
+  std::vector<uint64_t> drained;
+  std::set<uint64_t> seen, lost;
+  std::deque<Inflight> inflight;
+  size_t dups = 0, drops = 0;
+  uint64_t drainBytes = 0;
+  SpoolPos end = {};
+  bool more = true, flashEof = false, drainRebooted = false;
+  spool->rewind();
+  for (unsigned step = 1; more || !inflight.empty(); step++) {
+    if (step % DRAIN_DROP_EVERY == 0) {
+      inflight.clear();
+      spool->checkpoint();
+      spool->rewind();
+      ram.rewind();
+      more = true;
+      flashEof = false;
+      drops++;
+      continue;
+    }
+    if (!drainRebooted && step >= DRAIN_REBOOT_AT && !flashEof) {
+      // Acks since the last checkpoint are lost with the RAM state, and so
+      // is the RAM tier.
+      inflight.clear();
+      spool.reset(new SimSpool(fs, "/spool", o.segmentKb * 1024));
+      spool->begin(capacity);
+      ram.rewind();
+      while (ram.front(buf, sizeof(buf), len)) {
+        lost.insert(recordSeq(buf, len));
+        ram.pop();
+      }
+      more = true;
+      drainRebooted = true;
+      continue;
+    }
+    if (more && inflight.size() < DRAIN_WINDOW) {
+      bool fromRam = flashEof;
+      if (!fromRam && !spool->next(buf, sizeof(buf), len, end)) {
+        flashEof = true;
+        continue;
+      }
+      if (fromRam && !ram.next(buf, sizeof(buf), len)) {
+        more = false;
+        continue;
+      }
+      inflight.push_back(Inflight{recordSeq(buf, len), end, fromRam});
+      drainBytes += len;
+      continue;
+    }
+    if (inflight.front().ram) ram.ack();
+    else spool->ack(inflight.front().end);
+    if (seen.insert(inflight.front().seq).second) drained.push_back(inflight.front().seq);
+    else dups++;
+    inflight.pop_front();
+  }
+  spool->checkpoint();
+  // Everything acked: the next read finds the spool drained and clears it.
+  if (spool->next(buf, sizeof(buf), len, end)) {
+    fprintf(stderr, "  record left after the drain\n");
+    return false;
+  }
+
+  bool ok = true;
+  // Ring bound: the configured capacity plus the segment being filled and
+  // the two meta slots.
+  size_t bound = capacity + o.segmentKb * 1024 + 4 * PAGE;
+  if (peak > bound) {
+    fprintf(stderr, "  flash use %zu exceeds bound %zu\n", peak, bound);
+    ok = false;
+  }
+  for (size_t i = 1; i < drained.size(); i++) {
+    if (drained[i] <= drained[i - 1]) {
+      fprintf(stderr, "  record %llu drained after %llu\n", (unsigned long long)drained[i],
+              (unsigned long long)drained[i - 1]);
+      ok = false;
+      break;
+    }
+  }
+  uint64_t newest = seq - 1;
+  while (lost.count(newest)) newest--;
+  if (drained.empty() || drained.back() != newest) {
+    fprintf(stderr, "  newest record missing after drain\n");
+    ok = false;
+  }
+  // Gaps are allowed only where segments were evicted and at the reboot
+  // (its uncommitted window).
+  size_t gaps = 0;
+  for (size_t i = 1; i < drained.size(); i++) gaps += drained[i] != drained[i - 1] + 1;
+  if (gaps > 1) {
+    fprintf(stderr, "  %zu gaps in the surviving records\n", gaps);
+    ok = false;
+  }
+  if (dups > (drainRebooted ? SPOOL_CHECKPOINT_RECORDS : 0)) {
+    fprintf(stderr, "  %zu records delivered twice\n", dups);
+    ok = false;
+  }
+  if (hours * 3600 < o.ramAgeS && ramBuf.size() && commits) {
+    fprintf(stderr, "  %u flash commits during a %.0f s outage\n", commits, hours * 3600);
+    ok = false;
+  }
+  if (fs.usedBytes() > 4 * PAGE) {
+    fprintf(stderr, "  %zu bytes left on flash after the drain\n", fs.usedBytes());
+    ok = false;
+  }
+
+  printf("%7.3f %9llu %9zu %8u %6u %7u %5s %9zu %9zu %9.2f %6.2f %6zu %5zu %8.0f  %s\n", hours,
+         (unsigned long long)seq, drained.size(), evicted, spills, commits, tore ? "yes" : "no", peak / 1024,
+         capacity / 1024,
+         seq ? (double)flashOps / seq : 0.0,
+         recordBytes ? (double)flashBytes / recordBytes : 0.0, drops, dups,
+         o.drainBps ? (double)drainBytes / o.drainBps : 0.0, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--hours") && more) o.hours = atof(argv[++i]);
+    else if (!strcmp(a, "--rate") && more) o.rate = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--size") && more) o.size = (size_t)atoi(argv[++i]);
+    else if (!strcmp(a, "--partition") && more) o.partitionKb = (size_t)atoi(argv[++i]);
+    else if (!strcmp(a, "--fill") && more) o.fillPct = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--segment") && more) o.segmentKb = (size_t)atoi(argv[++i]);
+    else if (!strcmp(a, "--drain-bps") && more) o.drainBps = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--ram") && more) o.ramKb = (size_t)atoi(argv[++i]);
+    else if (!strcmp(a, "--ram-fill") && more) o.ramFillPct = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(a, "--ram-age") && more) o.ramAgeS = (unsigned)atoi(argv[++i]);
+    else {
+      fprintf(stderr,
+              "usage: spool_sim [--hours H] [--rate N] [--size B] [--partition KB] [--fill PCT] [--segment KB] "
+              "[--drain-bps N] [--ram KB] [--ram-fill PCT] [--ram-age S]\n");
+      return 2;
+    }
+  }
+  printf("rate=%u/min size=%zu partition=%zuKB fill=%u%% segment=%zuKB drain=%uB/s ram=%zuKB/%u%%/%us\n", o.rate,
+         o.size, o.partitionKb, o.fillPct, o.segmentKb, o.drainBps, o.ramKb, o.ramFillPct, o.ramAgeS);
+  bool ok = checkLegacyImport(o);
+  ok = checkTextRing(o, false) && ok;
+  ok = checkTextRing(o, true) && ok;
+  ok = checkMetaLoss(o) && ok;
+  printf("%7s %9s %9s %8s %6s %7s %5s %9s %9s %9s %6s %6s %5s %8s\n", "hours", "records", "kept", "evicted", "spills",
+         "commits", "torn", "peakKB", "capKB", "ops/rec", "wamp", "drops", "dups", "drainS");
+  if (o.hours > 0) {
+    ok = simulate(o, o.hours) && ok;
+  } else {
+    const double runs[] = {0.005, 1, 4, 12, 48};
+    for (double h : runs) ok = simulate(o, h) && ok;
+  }
+  return ok ? 0 : 1;
+}